@@ -40,7 +40,10 @@
 #include "accountlist.h"
 #include "audiooutput.h"
 #include "participantsmodel.h"
+#include "telephonylogging.h"
 
+#include <QDebug>
+#include <QElapsedTimer>
 #include <QQmlEngine>
 #include <qqml.h>
 #include <TelepathyQt/Debug>
@@ -51,6 +54,10 @@ void Components::initializeEngine(QQmlEngine *engine, const char *uri)
 
     Q_UNUSED(uri);
 
+    // startup trace: none of the singletons below should wait on the handler
+    QElapsedTimer startupTimer;
+    startupTimer.start();
+
     // if we allow config.h to look for stuff in uninstalled paths, applications
     // that use this plugin will try to look for protocol info in the wrong path
     // and fail to find them.
@@ -71,6 +78,7 @@ void Components::initializeEngine(QQmlEngine *engine, const char *uri)
     mRootContext->setContextProperty("callNotification", CallNotification::instance());
     mRootContext->setContextProperty("protocolManager", ProtocolManager::instance());
 
+    qCDebug(lcTelephony) << "Telephony plugin engine initialized in" << startupTimer.elapsed() << "ms";
 }
 
 void Components::registerTypes(const char *uri)
@@ -22,6 +22,7 @@
 
 #include "approver.h"
 #include "approverdbus.h"
+#include "calleridresolver.h"
 #include "applicationutils.h"
 #include "callnotification.h"
 #include "chatmanager.h"
@@ -29,6 +30,7 @@
 #include "contactutils.h"
 #include "contactwatcher.h"
 #include "greetercontacts.h"
+#include "latencytracer.h"
 #include "ringtone.h"
 #include "callmanager.h"
 #include "callentry.h"
@@ -37,10 +39,10 @@
 #include "tonegenerator.h"
 #include "telepathyhelper.h"
 #include "accountentry.h"
+#include "telephonylogging.h"
 
 #include <QContactAvatar>
 #include <QContactDisplayLabel>
-#include <QContactFetchRequest>
 #include <QContactPhoneNumber>
 #include <QDebug>
 #include <QFeedbackHapticsEffect>
@@ -50,6 +52,7 @@
 #include <TelepathyQt/ClientRegistrar>
 #include <TelepathyQt/CallChannel>
 #include <TelepathyQt/TextChannel>
+#include <memory>
 
 namespace C {
 #include <libintl.h>
@@ -60,7 +63,8 @@ namespace C {
 Approver::Approver()
 : Tp::AbstractClientApprover(channelFilters()),
   mPendingSnapDecision(NULL),
-  mSettleTimer(new QTimer(this))
+  mSettleTimer(new QTimer(this)),
+  mCallerIdResolver(0)
 {
     mDefaultTitle = C::gettext("Unknown caller");
     mDefaultIcon = QUrl(telephonyServiceDir() + "assets/avatar-default@18.png").toEncoded();
@@ -78,6 +82,8 @@ Approver::Approver()
     if (GreeterContacts::isGreeterMode()) {
         connect(GreeterContacts::instance(), SIGNAL(contactUpdated(QtContacts::QContact)),
                 this, SLOT(updateNotification(QtContacts::QContact)));
+    } else {
+        mCallerIdResolver = new CallerIdResolver(this);
     }
 
     QDBusConnection::systemBus().connect("com.canonical.Unity.Screen",
@@ -135,16 +141,66 @@ Tp::ChannelClassSpecList Approver::channelFilters() const
     return specList;
 }
 
-Tp::ChannelDispatchOperationPtr Approver::dispatchOperation(Tp::PendingOperation *op)
+Tp::ChannelDispatchOperationPtr Approver::dispatchOperation(Tp::PendingOperation *op) const
+{
+    Tp::ChannelPtr channel = mChannels.value(op);
+    if (!channel) {
+        return Tp::ChannelDispatchOperationPtr();
+    }
+    return mChannelDispatchOps.value(channel.data());
+}
+
+void Approver::registerDispatchOperation(const Tp::ChannelDispatchOperationPtr &dispatchOperation)
 {
-    Tp::ChannelPtr channel = mChannels[op];
-    QString accountId = channel->property("accountId").toString();
-    Q_FOREACH (Tp::ChannelDispatchOperationPtr dispatchOperation, mDispatchOps) {
-        if (dispatchOperation->account()->uniqueIdentifier() == accountId) {
-            return dispatchOperation;
+    mDispatchOps[dispatchOperation.data()] = dispatchOperation;
+
+    bool hasCallChannel = false;
+    Q_FOREACH(const Tp::ChannelPtr &channel, dispatchOperation->channels()) {
+        mChannelDispatchOps[channel.data()] = dispatchOperation;
+        hasCallChannel |= !Tp::CallChannelPtr::dynamicCast(channel).isNull();
+    }
+
+    if (hasCallChannel) {
+        mCallDispatchOps << dispatchOperation;
+    }
+}
+
+void Approver::unregisterDispatchOperation(const Tp::ChannelDispatchOperationPtr &dispatchOperation)
+{
+    if (!mDispatchOps.remove(dispatchOperation.data())) {
+        return;
+    }
+
+    // drop the channels and whatever was still pending on them
+    Q_FOREACH(const Tp::ChannelPtr &channel, dispatchOperation->channels()) {
+        mChannelDispatchOps.remove(channel.data());
+        Q_FOREACH(Tp::PendingOperation *op, mChannelOperations.values(channel.data())) {
+            mChannels.remove(op);
         }
+        mChannelOperations.remove(channel.data());
     }
-    return Tp::ChannelDispatchOperationPtr();
+
+    mCallDispatchOps.removeOne(dispatchOperation);
+}
+
+bool Approver::hasDispatchOperation(const Tp::ChannelDispatchOperationPtr &dispatchOperation) const
+{
+    return mDispatchOps.contains(dispatchOperation.data());
+}
+
+void Approver::trackOperation(Tp::PendingOperation *op, const Tp::ChannelPtr &channel)
+{
+    mChannels[op] = channel;
+    mChannelOperations.insert(channel.data(), op);
+}
+
+Tp::ChannelPtr Approver::takeOperation(Tp::PendingOperation *op)
+{
+    Tp::ChannelPtr channel = mChannels.take(op);
+    if (channel) {
+        mChannelOperations.remove(channel.data(), op);
+    }
+    return channel;
 }
 
 void Approver::addDispatchOperation(const Tp::MethodInvocationContextPtr<> &context,
@@ -163,14 +219,22 @@ void Approver::addDispatchOperation(const Tp::MethodInvocationContextPtr<> &cont
         // Call Channel
         Tp::CallChannelPtr callChannel = Tp::CallChannelPtr::dynamicCast(channel);
         if (!callChannel.isNull()) {
+            LatencyTracer::instance()->trace(callChannel->objectPath(), "dispatch");
+
+            // look the caller up while the channel gets ready, so the snap
+            // decision does not need to wait for it
+            QString id = callerId(callChannel);
+            if (mCallerIdResolver && !id.isEmpty()) {
+                mCallerIdResolver->resolve(id);
+            }
+
             Tp::PendingReady *pr = callChannel->becomeReady(Tp::Features()
                                   << Tp::CallChannel::FeatureCore
                                   << Tp::CallChannel::FeatureCallState);
-            mChannels[pr] = callChannel;
+            trackOperation(pr, callChannel);
 
             connect(pr, SIGNAL(finished(Tp::PendingOperation*)),
                     SLOT(onChannelReady(Tp::PendingOperation*)));
-            callChannel->setProperty("accountId", QVariant(dispatchOperation->account()->uniqueIdentifier()));
             willHandle = true;
             continue;
         }
@@ -184,14 +248,16 @@ void Approver::addDispatchOperation(const Tp::MethodInvocationContextPtr<> &cont
         }
     }
 
-    if (willHandle) {
-        mDispatchOps.append(dispatchOperation);
+    if (!willHandle) {
+        context->setFinished();
+        return;
     }
 
+    registerDispatchOperation(dispatchOperation);
     context->setFinished();
 
     // check if we need to approve channels already or if we should wait.
-    processChannels();
+    processChannels(dispatchOperation);
 }
 
 class EventData {
@@ -278,7 +344,7 @@ void Approver::updateNotification(const QContact &contact)
     GError *error = NULL;
     if (!notify_notification_show(mPendingSnapDecision, &error)) {
         closeSnapDecision();
-        qWarning() << "Failed to show snap decision:" << error->message;
+        qCWarning(lcApprover) << "Failed to show snap decision:" << error->message;
         g_error_free (error);
     }
 }
@@ -286,16 +352,15 @@ void Approver::updateNotification(const QContact &contact)
 void Approver::onChannelReady(Tp::PendingOperation *op)
 {
     Tp::PendingReady *pr = qobject_cast<Tp::PendingReady*>(op);
-    if (!pr || !mChannels.contains(pr)) {
-        qWarning() << "PendingOperation is not a PendingReady:" << op;
+    if (!pr) {
+        qCWarning(lcApprover) << "PendingOperation is not a PendingReady:" << op;
         return;
     }
 
-    Tp::ChannelPtr channel = mChannels[pr];
-    Tp::ContactPtr contact = channel->initiatorContact();
+    // the dispatch operation might be gone already
     Tp::ChannelDispatchOperationPtr dispatchOp = dispatchOperation(op);
-
-    if (!dispatchOp) {
+    Tp::ChannelPtr channel = takeOperation(pr);
+    if (!channel || !dispatchOp) {
         return;
     }
 
@@ -305,6 +370,7 @@ void Approver::onChannelReady(Tp::PendingOperation *op)
     }
 
     if (isIncoming(channel) && !callChannel->isRequested() && callChannel->callState() == Tp::CallStateInitialised) {
+        LatencyTracer::instance()->trace(channel->objectPath(), "channel-ready");
         callChannel->setRinging();
     } else {
         onApproved(dispatchOp);
@@ -315,9 +381,8 @@ void Approver::onChannelReady(Tp::PendingOperation *op)
             SIGNAL(callStateChanged(Tp::CallState)),
             SLOT(onCallStateChanged(Tp::CallState)));
 
-    mChannels.remove(pr);
-
-    QString id = ContactWatcher::normalizeIdentifier(contact->id(), true);
+    // the same id the lookup was started with when the call was dispatched
+    QString id = callerId(channel);
 
     // and now set up the contact matching for either greeter mode or regular mode
     if (GreeterContacts::isGreeterMode()) {
@@ -327,42 +392,55 @@ void Approver::onChannelReady(Tp::PendingOperation *op)
     } else {
         AccountEntry *account = TelepathyHelper::instance()->accountForConnection(callChannel->connection());
         if (!account) {
-            qCritical() << "Call exists with no account for connection";
+            qCCritical(lcApprover) << "Call exists with no account for connection";
             return;
         }
 
-        // try to match the contact info
-        QContactFetchRequest *request = new QContactFetchRequest(this);
-        request->setFilter(QContactPhoneNumber::match(id));
-
-        // lambda function to update the notification
-        QObject::connect(request, &QContactAbstractRequest::stateChanged, [this, request, dispatchOp, channel](QContactAbstractRequest::State state) {
-            if (!request || state != QContactAbstractRequest::FinishedState) {
-                return;
-            }
-
-            QContact contact;
+        // FIXME: For accounts not based on phone numbers, check what to do
+        showSnapDecisionWhenResolved(dispatchOp, channel, id);
+    }
+}
 
-            // create the snap decision only after the contact match finishes
-            if (request->contacts().size() > 0) {
-                // use the first match
-                contact = request->contacts().at(0);
+void Approver::showSnapDecisionWhenResolved(const Tp::ChannelDispatchOperationPtr dispatchOp,
+                                            const Tp::ChannelPtr channel,
+                                            const QString &id)
+{
+    // create the snap decision only after the contact match finishes, which
+    // most of the time already happened while the channel was getting ready
+    auto show = [this, dispatchOp, channel](const QContact &contact) {
+        LatencyTracer::instance()->trace(channel->objectPath(), "contact");
+        if (!hasDispatchOperation(dispatchOp)) {
+            // the call is already gone
+            return;
+        }
 
-                // Also notify greeter via AccountsService
-                GreeterContacts::emitContact(contact);
-            }
-            showSnapDecision(dispatchOp, channel, contact);
-        });
+        if (!contact.isEmpty()) {
+            // Also notify greeter via AccountsService
+            GreeterContacts::emitContact(contact);
+        }
+        showSnapDecision(dispatchOp, channel, contact);
+    };
 
-        // FIXME: For accounts not based on phone numbers, check what to do
-        request->setManager(ContactUtils::sharedManager());
-        request->start();
+    if (mCallerIdResolver->isResolved(id)) {
+        show(mCallerIdResolver->contact(id));
+        return;
     }
+
+    auto conn = std::make_shared<QMetaObject::Connection>();
+    *conn = connect(mCallerIdResolver, &CallerIdResolver::resolved, [=](const QString &resolvedId, const QContact &contact) {
+        if (resolvedId != id) {
+            return;
+        }
+        QObject::disconnect(*conn);
+        show(contact);
+    });
+    mCallerIdResolver->resolve(id);
 }
 
 void Approver::onApproved(Tp::ChannelDispatchOperationPtr dispatchOp)
 {
     closeSnapDecision();
+    finishTraces(dispatchOp);
 
     acceptCallChannels(dispatchOp);
 
@@ -372,12 +450,13 @@ void Approver::onApproved(Tp::ChannelDispatchOperationPtr dispatchOp)
     // and then launch the dialer-app
     ApplicationUtils::openUrl(QUrl("dialer:///?view=liveCall"));
 
-    mDispatchOps.removeAll(dispatchOp);
+    unregisterDispatchOperation(dispatchOp);
 }
 
 void Approver::onHangUpAndApproved(Tp::ChannelDispatchOperationPtr dispatchOp)
 {
     closeSnapDecision();
+    finishTraces(dispatchOp);
 
     // hangup existing calls
     if (CallManager::instance()->foregroundCall()) {
@@ -392,16 +471,17 @@ void Approver::onHangUpAndApproved(Tp::ChannelDispatchOperationPtr dispatchOp)
     // and then launch the dialer-app
     ApplicationUtils::openUrl(QUrl("application:///dialer-app.desktop"));
 
-    mDispatchOps.removeAll(dispatchOp);
+    unregisterDispatchOperation(dispatchOp);
 }
 
 void Approver::onRejected(Tp::ChannelDispatchOperationPtr dispatchOp)
 {
     closeSnapDecision();
+    finishTraces(dispatchOp);
 
     Tp::PendingOperation *claimop = dispatchOp->claim();
     // assume there is just one channel in the dispatchOp for calls
-    mChannels[claimop] = dispatchOp->channels().first();
+    trackOperation(claimop, dispatchOp->channels().first());
     connect(claimop, SIGNAL(finished(Tp::PendingOperation*)),
             this, SLOT(onClaimFinished(Tp::PendingOperation*)));
 
@@ -443,7 +523,7 @@ bool Approver::showSnapDecision(const Tp::ChannelDispatchOperationPtr dispatchOp
 
     AccountEntry *account = TelepathyHelper::instance()->accountForConnection(channel->connection());
     if (!account) {
-        qCritical() << "Call exists with no account for connection";
+        qCCritical(lcApprover) << "Call exists with no account for connection";
         return false;
     }
 
@@ -567,20 +647,22 @@ bool Approver::showSnapDecision(const Tp::ChannelDispatchOperationPtr dispatchOp
     }
 
     mPendingSnapDecision = notification;
+    mSnapDecisionDispatchOp = dispatchOperation;
 
     GError *error = NULL;
     if (!notify_notification_show(notification, &error)) {
         closeSnapDecision();
-        qWarning() << "Failed to show snap decision:" << error->message;
+        qCWarning(lcApprover) << "Failed to show snap decision:" << error->message;
         g_error_free (error);
         return false;
     }
+    LatencyTracer::instance()->trace(channel->objectPath(), "snap-decision");
 
     if (hasCalls) {
         ToneGenerator::instance()->playWaitingTone();
     } else {
         // play a ringtone
-        Ringtone::instance()->playIncomingCallSound();
+        Ringtone::instance()->playIncomingCallSound(channel->objectPath());
     }
 
     if (!hasCalls && GreeterContacts::instance()->incomingCallVibrate()) {
@@ -603,27 +685,25 @@ void Approver::acceptCallChannels(const Tp::ChannelDispatchOperationPtr dispatch
     }
 }
 
-Tp::ChannelDispatchOperationPtr Approver::dispatchOperationForIncomingCall()
+void Approver::finishTraces(const Tp::ChannelDispatchOperationPtr dispatchOp)
 {
-    Tp::ChannelDispatchOperationPtr callDispatchOp;
-
-    // find the call channel in the dispatch operations
-    Q_FOREACH(Tp::ChannelDispatchOperationPtr dispatchOp, mDispatchOps) {
-        Q_FOREACH(Tp::ChannelPtr channel, dispatchOp->channels()) {
-            Tp::CallChannelPtr callChannel = Tp::CallChannelPtr::dynamicCast(channel);
-            // FIXME: maybe we need to check the call state too?
-            if (!callChannel.isNull()) {
-                callDispatchOp = dispatchOp;
-                break;
-            }
-        }
+    Q_FOREACH(Tp::ChannelPtr channel, dispatchOp->channels()) {
+        LatencyTracer::instance()->finish(channel->objectPath());
+    }
+}
 
-        if (!callDispatchOp.isNull()) {
-            break;
-        }
+Tp::ChannelDispatchOperationPtr Approver::dispatchOperationForIncomingCall()
+{
+    // with more than one call ringing, act on the one the user is looking at
+    if (hasDispatchOperation(mSnapDecisionDispatchOp)) {
+        return mSnapDecisionDispatchOp;
     }
 
-    return callDispatchOp;
+    // FIXME: maybe we need to check the call state too?
+    if (mCallDispatchOps.isEmpty()) {
+        return Tp::ChannelDispatchOperationPtr();
+    }
+    return mCallDispatchOps.first();
 }
 
 bool Approver::isIncoming(const Tp::ChannelPtr &channel)
@@ -631,40 +711,48 @@ bool Approver::isIncoming(const Tp::ChannelPtr &channel)
    return channel->initiatorContact() != channel->connection()->selfContact();
 }
 
-void Approver::processChannels()
+QString Approver::callerId(const Tp::ChannelPtr &channel)
 {
-    Q_FOREACH (Tp::ChannelDispatchOperationPtr dispatchOperation, mDispatchOps) {
-        QList<Tp::ChannelPtr> channels = dispatchOperation->channels();
-        Q_FOREACH (Tp::ChannelPtr channel, channels) {
-            // approve only text channels
-            Tp::TextChannelPtr textChannel = Tp::TextChannelPtr::dynamicCast(channel);
-            if (textChannel.isNull()) {
-                continue;
-            }
+    QString id = channel->immutableProperties()[TP_QT_IFACE_CHANNEL + ".TargetID"].toString();
+    if (id.isEmpty() && channel->initiatorContact()) {
+        id = channel->initiatorContact()->id();
+    }
+    return ContactWatcher::normalizeIdentifier(id, true);
+}
 
-            if (dispatchOperation->possibleHandlers().contains(TELEPHONY_SERVICE_HANDLER)) {
-                dispatchOperation->handleWith(TELEPHONY_SERVICE_HANDLER);
-                mDispatchOps.removeAll(dispatchOperation);
-            }
-            // FIXME: this shouldn't happen, but in any case, we need to check what to do when
-            // the phone app client is not available
+void Approver::processChannels(const Tp::ChannelDispatchOperationPtr &dispatchOperation)
+{
+    Q_FOREACH (Tp::ChannelPtr channel, dispatchOperation->channels()) {
+        // approve only text channels
+        Tp::TextChannelPtr textChannel = Tp::TextChannelPtr::dynamicCast(channel);
+        if (textChannel.isNull()) {
+            continue;
+        }
+
+        if (dispatchOperation->possibleHandlers().contains(TELEPHONY_SERVICE_HANDLER)) {
+            dispatchOperation->handleWith(TELEPHONY_SERVICE_HANDLER);
+            unregisterDispatchOperation(dispatchOperation);
+            return;
         }
+        // FIXME: this shouldn't happen, but in any case, we need to check what to do when
+        // the phone app client is not available
     }
 }
 
 void Approver::onClaimFinished(Tp::PendingOperation* op)
 {
+    Tp::ChannelPtr channel = takeOperation(op);
     if(!op || op->isError()) {
-        qDebug() << "onClaimFinished() error";
+        qCDebug(lcApprover) << "onClaimFinished() error";
         // TODO do something
         return;
     }
 
-    Tp::CallChannelPtr callChannel = Tp::CallChannelPtr::dynamicCast(mChannels[op]);
+    Tp::CallChannelPtr callChannel = Tp::CallChannelPtr::dynamicCast(channel);
     if (callChannel) {
         Tp::PendingOperation *hangupop = callChannel->hangup(Tp::CallStateChangeReasonUserRequested, TP_QT_ERROR_REJECTED, QString());
         CallNotification::instance()->showNotificationForCall(QStringList() << callChannel->targetContact()->id(), CallNotification::CallRejected);
-        mChannels[hangupop] = callChannel;
+        trackOperation(hangupop, callChannel);
         connect(hangupop, SIGNAL(finished(Tp::PendingOperation*)),
                 this, SLOT(onHangupFinished(Tp::PendingOperation*)));
     }
@@ -672,8 +760,10 @@ void Approver::onClaimFinished(Tp::PendingOperation* op)
 
 void Approver::onHangupFinished(Tp::PendingOperation* op)
 {
+    Tp::ChannelDispatchOperationPtr dispatchOp = dispatchOperation(op);
+    takeOperation(op);
     if(!op || op->isError()) {
-        qDebug() << "onHangupFinished() error";
+        qCDebug(lcApprover) << "onHangupFinished() error";
         // TODO do something
         return;
     }
@@ -684,8 +774,9 @@ void Approver::onHangupFinished(Tp::PendingOperation* op)
     // not to register call events as it would never receive the
     // "ended" state. Better to check how other connection
     // managers deal with this case.
-    mDispatchOps.removeAll(dispatchOperation(op));
-    mChannels.remove(op);
+    if (dispatchOp) {
+        unregisterDispatchOperation(dispatchOp);
+    }
 }
 
 void Approver::onCallStateChanged(Tp::CallState state)
@@ -695,30 +786,16 @@ void Approver::onCallStateChanged(Tp::CallState state)
         return;
     }
 
-    Tp::ChannelDispatchOperationPtr dispatchOperation;
-    Q_FOREACH(const Tp::ChannelDispatchOperationPtr &otherDispatchOperation, mDispatchOps) {
-        Q_FOREACH(const Tp::ChannelPtr &otherChannel, otherDispatchOperation->channels()) {
-            if (otherChannel.data() == channel) {
-                dispatchOperation = otherDispatchOperation;
-            }
-        }
-    }
-
+    Tp::ChannelDispatchOperationPtr dispatchOperation = mChannelDispatchOps.value(channel);
     if(dispatchOperation.isNull()) {
         return;
     }
 
     if (state == Tp::CallStateEnded) {
-        mDispatchOps.removeAll(dispatchOperation);
         // remove all channels and pending operations
-        Q_FOREACH(const Tp::ChannelPtr &otherChannel, dispatchOperation->channels()) {
-            Tp::PendingOperation* op = mChannels.key(otherChannel);
-            if(op) {
-                mChannels.remove(op);
-            }
-        }
-
+        unregisterDispatchOperation(dispatchOperation);
         closeSnapDecision();
+        finishTraces(dispatchOperation);
     } else if (state == Tp::CallStateActive) {
         onApproved(dispatchOperation);
     }
@@ -730,6 +807,7 @@ void Approver::closeSnapDecision()
         notify_notification_close(mPendingSnapDecision, NULL);
         mPendingSnapDecision = NULL;
     }
+    mSnapDecisionDispatchOp.reset();
 
     Ringtone::instance()->stopIncomingCallSound();
     ToneGenerator::instance()->stopWaitingTone();
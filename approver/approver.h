@@ -28,6 +28,7 @@
 #include <libnotify/notify.h>
 
 #include <QContact>
+#include <QHash>
 #include <QMap>
 #include <TelepathyQt/AbstractClientApprover>
 #include <TelepathyQt/PendingReady>
@@ -36,6 +37,8 @@
 
 QTCONTACTS_USE_NAMESPACE
 
+class CallerIdResolver;
+
 class Approver : public QObject, public Tp::AbstractClientApprover
 {
     Q_OBJECT
@@ -48,7 +51,7 @@ public:
 
     void addDispatchOperation(const Tp::MethodInvocationContextPtr<> &context,
                               const Tp::ChannelDispatchOperationPtr &dispatchOperation);
-    Tp::ChannelDispatchOperationPtr dispatchOperation(Tp::PendingOperation *op);
+    Tp::ChannelDispatchOperationPtr dispatchOperation(Tp::PendingOperation *op) const;
     void onApproved(Tp::ChannelDispatchOperationPtr dispatchOp);
     void onHangUpAndApproved(Tp::ChannelDispatchOperationPtr dispatchOp);
     void onRejected(Tp::ChannelDispatchOperationPtr dispatchOp);
@@ -57,14 +60,17 @@ public:
                           const Tp::ChannelPtr channel,
                           const QContact &contact = QContact());
     void acceptCallChannels(const Tp::ChannelDispatchOperationPtr dispatchOp);
+    void finishTraces(const Tp::ChannelDispatchOperationPtr dispatchOp);
     bool handleMediaKey(bool doubleClick);
 
 protected:
     Tp::ChannelDispatchOperationPtr dispatchOperationForIncomingCall();
     bool isIncoming(const Tp::ChannelPtr &channel);
+    void showSnapDecisionWhenResolved(const Tp::ChannelDispatchOperationPtr dispatchOp,
+                                      const Tp::ChannelPtr channel,
+                                      const QString &id);
 
 private Q_SLOTS:
-    void processChannels();
     void onChannelReady(Tp::PendingOperation *op);
     void onClaimFinished(Tp::PendingOperation* op);
     void onHangupFinished(Tp::PendingOperation* op);
@@ -79,9 +85,27 @@ private Q_SLOTS:
     void processHandleMediaKey(bool doubleClick);
 
 private:
-    QList<Tp::ChannelDispatchOperationPtr> mDispatchOps;
-    QMap<Tp::PendingOperation*,Tp::ChannelPtr> mChannels;
+    void processChannels(const Tp::ChannelDispatchOperationPtr &dispatchOperation);
+    void registerDispatchOperation(const Tp::ChannelDispatchOperationPtr &dispatchOperation);
+    void unregisterDispatchOperation(const Tp::ChannelDispatchOperationPtr &dispatchOperation);
+    bool hasDispatchOperation(const Tp::ChannelDispatchOperationPtr &dispatchOperation) const;
+    void trackOperation(Tp::PendingOperation *op, const Tp::ChannelPtr &channel);
+    Tp::ChannelPtr takeOperation(Tp::PendingOperation *op);
+    // the caller id the contact lookup is keyed on, available before the
+    // channel is ready
+    static QString callerId(const Tp::ChannelPtr &channel);
+
+    // dispatch operations being approved, by pointer and by each of their channels
+    QHash<Tp::ChannelDispatchOperation*, Tp::ChannelDispatchOperationPtr> mDispatchOps;
+    QHash<Tp::Channel*, Tp::ChannelDispatchOperationPtr> mChannelDispatchOps;
+    // the ones with call channels, in the order they arrived
+    QList<Tp::ChannelDispatchOperationPtr> mCallDispatchOps;
+    // pending operations on the channels, and the other way around
+    QHash<Tp::PendingOperation*, Tp::ChannelPtr> mChannels;
+    QMultiHash<Tp::Channel*, Tp::PendingOperation*> mChannelOperations;
     NotifyNotification* mPendingSnapDecision;
+    // the call the snap decision is about
+    Tp::ChannelDispatchOperationPtr mSnapDecisionDispatchOp;
     QString mDefaultTitle;
     QString mDefaultIcon;
     QString mCachedBody;
@@ -89,6 +113,7 @@ private:
     QTimer mVibrateTimer;
     QTimer *mSettleTimer;
     QMap<QString,QString> mRejectActions;
+    CallerIdResolver *mCallerIdResolver;
 };
 
 #endif // APPROVER_H
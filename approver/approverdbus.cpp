@@ -23,6 +23,7 @@
 
 #include "approverdbus.h"
 #include "approveradaptor.h"
+#include "latencytracer.h"
 
 // Qt
 #include <QtDBus/QDBusConnection>
@@ -65,3 +66,13 @@ bool ApproverDBus::HandleMediaKey(bool doubleClick)
 {
     return mApprover->handleMediaKey(doubleClick);
 }
+
+QVariantMap ApproverDBus::GetIncomingCallLatencies()
+{
+    return LatencyTracer::instance()->histograms();
+}
+
+void ApproverDBus::ResetIncomingCallLatencies()
+{
+    LatencyTracer::instance()->reset();
+}
@@ -46,6 +46,8 @@ public Q_SLOTS:
     Q_NOREPLY void AcceptCall();
     Q_NOREPLY void RejectCall();
     bool HandleMediaKey(bool doubleClick);
+    QVariantMap GetIncomingCallLatencies();
+    void ResetIncomingCallLatencies();
 
 Q_SIGNALS:
     void hangUpAndAcceptCallRequested();
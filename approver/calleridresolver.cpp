@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "calleridresolver.h"
+#include "contactutils.h"
+#include "phoneutils.h"
+#include "telephonylogging.h"
+
+#include <QContactAvatar>
+#include <QContactDetailFilter>
+#include <QContactDisplayLabel>
+#include <QContactFetchHint>
+#include <QContactFetchRequest>
+#include <QContactManager>
+#include <QContactName>
+#include <QContactPhoneNumber>
+#include <QDebug>
+
+// numbers are indexed by their last digits, candidates are then compared
+// with libphonenumber
+#define INDEX_KEY_DIGITS 7
+// wait for bursts of contact changes (like a sync) to settle before reindexing
+#define REBUILD_DELAY 2000
+// results are only needed while the call is ringing
+#define MAX_RESULTS 32
+
+CallerIdResolver::CallerIdResolver(QObject *parent) :
+    QObject(parent), mIndexReady(false), mIndexRequest(0)
+{
+    mRebuildTimer.setSingleShot(true);
+    mRebuildTimer.setInterval(REBUILD_DELAY);
+    connect(&mRebuildTimer, SIGNAL(timeout()), SLOT(buildIndex()));
+
+    QContactManager *manager = ContactUtils::sharedManager();
+    connect(manager, &QContactManager::contactsAdded, this, &CallerIdResolver::onContactsChanged);
+    connect(manager, &QContactManager::contactsChanged, this, &CallerIdResolver::onContactsChanged);
+    connect(manager, &QContactManager::contactsRemoved, this, &CallerIdResolver::onContactsChanged);
+    connect(manager, &QContactManager::dataChanged, this, &CallerIdResolver::onContactsChanged);
+
+    buildIndex();
+}
+
+void CallerIdResolver::resolve(const QString &id)
+{
+    if (mResults.contains(id) || mPending.contains(id)) {
+        return;
+    }
+
+    QContact contact;
+    if (lookupIndex(id, contact)) {
+        setResult(id, contact);
+        return;
+    }
+
+    // the index is either not loaded yet or it does not know the number, so
+    // let the backend do its own (looser) matching
+    fetchContact(id);
+}
+
+bool CallerIdResolver::isResolved(const QString &id) const
+{
+    return mResults.contains(id);
+}
+
+QContact CallerIdResolver::contact(const QString &id) const
+{
+    return mResults.value(id);
+}
+
+void CallerIdResolver::buildIndex()
+{
+    if (mIndexRequest) {
+        mIndexRequest->cancel();
+        mIndexRequest->deleteLater();
+    }
+
+    // only what the snap decision and the greeter need
+    QContactFetchHint hint;
+    hint.setDetailTypesHint(QList<QContactDetail::DetailType>() << QContactDetail::TypeDisplayLabel
+                                                                << QContactDetail::TypeName
+                                                                << QContactDetail::TypeAvatar
+                                                                << QContactDetail::TypePhoneNumber);
+    hint.setOptimizationHints(QContactFetchHint::NoRelationships | QContactFetchHint::NoActionPreferences |
+                              QContactFetchHint::NoBinaryBlobs);
+
+    QContactDetailFilter filter;
+    filter.setDetailType(QContactPhoneNumber::Type);
+
+    QContactFetchRequest *request = new QContactFetchRequest(this);
+    request->setManager(ContactUtils::sharedManager());
+    request->setFilter(filter);
+    request->setFetchHint(hint);
+    connect(request, &QContactAbstractRequest::stateChanged, this, &CallerIdResolver::onIndexRequestStateChanged);
+    mIndexRequest = request;
+    request->start();
+}
+
+void CallerIdResolver::onIndexRequestStateChanged(QContactAbstractRequest::State state)
+{
+    QContactFetchRequest *request = qobject_cast<QContactFetchRequest*>(sender());
+    if (!request || request != mIndexRequest || state != QContactAbstractRequest::FinishedState) {
+        return;
+    }
+
+    mIndex.clear();
+    Q_FOREACH(const QContact &contact, request->contacts()) {
+        Q_FOREACH(const QContactPhoneNumber &number, contact.details<QContactPhoneNumber>()) {
+            QString key = indexKey(number.number());
+            if (!key.isEmpty() && !mIndex[key].contains(contact)) {
+                mIndex[key] << contact;
+            }
+        }
+    }
+    mIndexReady = true;
+    qCDebug(lcApprover) << "Caller id index loaded with" << mIndex.count() << "numbers";
+
+    mIndexRequest = 0;
+    request->deleteLater();
+}
+
+void CallerIdResolver::onContactsChanged()
+{
+    // whatever was resolved might be stale now
+    mResults.clear();
+    mRebuildTimer.start();
+}
+
+bool CallerIdResolver::lookupIndex(const QString &id, QContact &contact) const
+{
+    if (!mIndexReady) {
+        return false;
+    }
+
+    PhoneUtils::PhoneNumberMatchType bestMatch = PhoneUtils::NO_MATCH;
+    Q_FOREACH(const QContact &candidate, mIndex.value(indexKey(id))) {
+        Q_FOREACH(const QContactPhoneNumber &number, candidate.details<QContactPhoneNumber>()) {
+            PhoneUtils::PhoneNumberMatchType match = PhoneUtils::comparePhoneNumbers(id, number.number());
+            if (match > bestMatch) {
+                bestMatch = match;
+                contact = candidate;
+            }
+        }
+    }
+
+    return bestMatch > PhoneUtils::NO_MATCH;
+}
+
+void CallerIdResolver::fetchContact(const QString &id)
+{
+    mPending << id;
+
+    QContactFetchRequest *request = new QContactFetchRequest(this);
+    request->setFilter(QContactPhoneNumber::match(id));
+    connect(request, &QContactAbstractRequest::stateChanged, [this, request, id](QContactAbstractRequest::State state) {
+        if (state != QContactAbstractRequest::FinishedState) {
+            return;
+        }
+
+        // use the first match
+        QContact contact;
+        if (request->contacts().size() > 0) {
+            contact = request->contacts().at(0);
+        }
+        mPending.remove(id);
+        setResult(id, contact);
+        request->deleteLater();
+    });
+    request->setManager(ContactUtils::sharedManager());
+    request->start();
+}
+
+void CallerIdResolver::setResult(const QString &id, const QContact &contact)
+{
+    if (mResults.count() >= MAX_RESULTS) {
+        mResults.clear();
+    }
+    mResults[id] = contact;
+    Q_EMIT resolved(id, contact);
+}
+
+QString CallerIdResolver::indexKey(const QString &number)
+{
+    QString digits;
+    Q_FOREACH(const QChar &c, number) {
+        if (c.isDigit()) {
+            digits += c;
+        }
+    }
+    return digits.right(INDEX_KEY_DIGITS);
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CALLERIDRESOLVER_H
+#define CALLERIDRESOLVER_H
+
+#include <QContact>
+#include <QContactAbstractRequest>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QTimer>
+
+QTCONTACTS_USE_NAMESPACE
+
+/* Finds the contact matching a caller id ahead of the snap decision.
+ * Lookups are answered from an in memory index of the contacts' phone
+ * numbers whenever it is loaded, and go to the contacts backend otherwise
+ * (or when the index does not know the number). */
+class CallerIdResolver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CallerIdResolver(QObject *parent = 0);
+
+    // starts resolving the given id, resolved() is emitted once it is known
+    void resolve(const QString &id);
+    bool isResolved(const QString &id) const;
+    // the contact found for the id, empty if there is none
+    QContact contact(const QString &id) const;
+
+Q_SIGNALS:
+    void resolved(const QString &id, const QtContacts::QContact &contact);
+
+private Q_SLOTS:
+    void buildIndex();
+    void onIndexRequestStateChanged(QContactAbstractRequest::State state);
+    void onContactsChanged();
+
+private:
+    bool lookupIndex(const QString &id, QContact &contact) const;
+    void fetchContact(const QString &id);
+    void setResult(const QString &id, const QContact &contact);
+    static QString indexKey(const QString &number);
+
+    QHash<QString, QList<QContact> > mIndex;
+    bool mIndexReady;
+    QContactAbstractRequest *mIndexRequest;
+    QTimer mRebuildTimer;
+    QHash<QString, QContact> mResults;
+    QSet<QString> mPending;
+};
+
+#endif // CALLERIDRESOLVER_H
@@ -25,6 +25,7 @@
 #include "applicationutils.h"
 #include "approver.h"
 #include "telepathyhelper.h"
+#include "telephonylogging.h"
 #include <QCoreApplication>
 #include <TelepathyQt/ClientRegistrar>
 #include <TelepathyQt/AbstractClient>
@@ -49,7 +50,7 @@ int main(int argc, char **argv)
 
     // check if there is already an instance of the approver running
     if (ApplicationUtils::checkApplicationRunning(TP_QT_IFACE_CLIENT + ".TelephonyServiceApprover")) {
-        qDebug() << "Found another instance of the approver. Quitting.";
+        qCInfo(lcApprover) << "Found another instance of the approver. Quitting.";
         return 1;
     }
 
@@ -108,7 +108,8 @@ function(generate_test TESTNAME)
 endfunction(generate_test)
 
 function(generate_telepathy_test TESTNAME)
-    set(options "")
+    # NO_HANDLER is for tests that run the handler code in their own process
+    set(options NO_HANDLER)
     set(oneValueArgs WAIT_FOR)
     set(multiValueArgs TASKS LIBRARIES QT5_MODULES)
     cmake_parse_arguments(ARG "${options}" "${oneValueArgs}" "${multiValueArgs}" ${ARGN} )
@@ -118,10 +119,13 @@ function(generate_telepathy_test TESTNAME)
               --task /usr/lib/dconf/dconf-service --task-name dconf-service --ignore-return
               --task dconf -p write -p /org/gnome/empathy/use-conn -p false --task-name dconf-write --wait-for ca.desrt.dconf --ignore-return
               --task /usr/lib/telepathy/mission-control-5 --task-name mission-control --wait-for ca.desrt.dconf --ignore-return
-              --task ${CMAKE_BINARY_DIR}/tests/common/mock/telepathy-mock --task-name telepathy-mock --wait-for org.freedesktop.Telepathy.MissionControl5 --ignore-return
-              # FIXME: maybe it would be better to decide whether to run the handler in a per-test basis?
-              --task ${CMAKE_BINARY_DIR}/handler/telephony-service-handler --task-name telephony-service-handler --wait-for org.freedesktop.Telepathy.ConnectionManager.mock --ignore-return
-              ${ARG_TASKS})
+              --task ${CMAKE_BINARY_DIR}/tests/common/mock/telepathy-mock --task-name telepathy-mock --wait-for org.freedesktop.Telepathy.MissionControl5 --ignore-return)
+
+    if (NOT ${ARG_NO_HANDLER})
+        set(TASKS ${TASKS}
+                  --task ${CMAKE_BINARY_DIR}/handler/telephony-service-handler --task-name telephony-service-handler --wait-for org.freedesktop.Telepathy.ConnectionManager.mock --ignore-return)
+    endif ()
+    set(TASKS ${TASKS} ${ARG_TASKS})
 
     if (NOT DEFINED ARG_LIBRARIES)
         set(ARG_LIBRARIES ${TP_QT5_LIBRARIES} telephonyservice mockcontroller telepathytest)
@@ -131,7 +135,11 @@ function(generate_telepathy_test TESTNAME)
         set(ARG_QT5_MODULES Core DBus Test Qml)
     endif (NOT DEFINED ARG_QT5_MODULES)
     if (NOT DEFINED ARG_WAIT_FOR)
-        set(ARG_WAIT_FOR org.freedesktop.Telepathy.Client.TelephonyServiceHandler)
+        if (${ARG_NO_HANDLER})
+            set(ARG_WAIT_FOR org.freedesktop.Telepathy.ConnectionManager.mock)
+        else ()
+            set(ARG_WAIT_FOR org.freedesktop.Telepathy.Client.TelephonyServiceHandler)
+        endif ()
     endif (NOT DEFINED ARG_WAIT_FOR)
     generate_test(${TESTNAME} ${ARG_UNPARSED_ARGUMENTS}
                   TASKS ${TASKS}
@@ -21,9 +21,13 @@
 
 #include "accountproperties.h"
 #include "telepathyhelper.h"
+#include <QCoreApplication>
 #include <QSettings>
+#include <QUrl>
 
 #define SETTINGS_DOMAIN "com.canonical.TelephonyServiceHandler"
+// changes usually come in bursts (one call per property from the settings UI)
+#define FLUSH_DELAY 500
 
 AccountProperties *AccountProperties::instance()
 {
@@ -31,32 +35,57 @@ AccountProperties *AccountProperties::instance()
     return self;
 }
 
-QMap<QString, QVariantMap> AccountProperties::allProperties()
+QMap<QString, QVariantMap> AccountProperties::allProperties() const
 {
     QMap<QString,QVariantMap> props;
     for (auto accountId : TelepathyHelper::instance()->accountIds()) {
         props[accountId] = accountProperties(accountId);
     }
+    return props;
 }
 
-QVariantMap AccountProperties::accountProperties(const QString &accountId)
+QVariantMap AccountProperties::accountProperties(const QString &accountId) const
 {
-    QVariantMap props;
-    mSettings->beginGroup(formatAccountId(accountId));
-    for (auto key : mSettings->allKeys()) {
-        props[key] = mSettings->value(key);
-    }
-    mSettings->endGroup();
-    return props;
+    return mProperties.value(accountId);
 }
 
 void AccountProperties::setAccountProperties(const QString &accountId, const QVariantMap &properties)
 {
-    mSettings->beginGroup(formatAccountId(accountId));
+    QVariantMap &props = mProperties[accountId];
+    QVariantMap changed;
     for (auto key : properties.keys()) {
-        mSettings->setValue(key, properties[key]);
+        if (!props.contains(key) || props[key] != properties[key]) {
+            props[key] = properties[key];
+            changed[key] = properties[key];
+        }
+    }
+
+    if (changed.isEmpty()) {
+        return;
     }
-    mSettings->endGroup();
+
+    mDirtyAccounts << accountId;
+    mFlushTimer.start();
+    Q_EMIT accountPropertiesChanged(accountId, changed);
+}
+
+void AccountProperties::flush()
+{
+    mFlushTimer.stop();
+    if (mDirtyAccounts.isEmpty()) {
+        return;
+    }
+
+    for (auto accountId : mDirtyAccounts) {
+        const QVariantMap &props = mProperties[accountId];
+        mSettings->beginGroup(formatAccountId(accountId));
+        for (auto key : props.keys()) {
+            mSettings->setValue(key, props[key]);
+        }
+        mSettings->endGroup();
+    }
+    mDirtyAccounts.clear();
+    mSettings->sync();
 }
 
 QString AccountProperties::formatAccountId(const QString &accountId)
@@ -66,6 +95,26 @@ QString AccountProperties::formatAccountId(const QString &accountId)
 
 AccountProperties::AccountProperties(QObject *parent)
 : QObject(parent),
-  mSettings(new QSettings(SETTINGS_DOMAIN, QString(), parent))
+  mSettings(new QSettings(SETTINGS_DOMAIN, QString(), this))
+{
+    mFlushTimer.setSingleShot(true);
+    mFlushTimer.setInterval(FLUSH_DELAY);
+    connect(&mFlushTimer, SIGNAL(timeout()), SLOT(flush()));
+    // do not lose the last changes when the handler exits
+    connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), SLOT(flush()));
+
+    load();
+}
+
+void AccountProperties::load()
 {
+    for (auto group : mSettings->childGroups()) {
+        QString accountId = QUrl::fromPercentEncoding(group.toUtf8());
+        QVariantMap &props = mProperties[accountId];
+        mSettings->beginGroup(group);
+        for (auto key : mSettings->allKeys()) {
+            props[key] = mSettings->value(key);
+        }
+        mSettings->endGroup();
+    }
 }
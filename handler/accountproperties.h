@@ -22,26 +22,46 @@
 #ifndef ACCOUNTPROPERTIES_H
 #define ACCOUNTPROPERTIES_H
 
+#include <QMap>
 #include <QObject>
+#include <QSet>
+#include <QTimer>
+#include <QVariantMap>
 
 class QSettings;
 
+/* The account properties are loaded from the settings once and served from
+ * memory afterwards. Changes are applied to memory right away and written
+ * back to disk in batches. */
 class AccountProperties : public QObject
 {
     Q_OBJECT
 public:
     static AccountProperties *instance();
 
-    QMap<QString,QVariantMap> allProperties();
-    QVariantMap accountProperties(const QString &accountId);
+    QMap<QString,QVariantMap> allProperties() const;
+    QVariantMap accountProperties(const QString &accountId) const;
     void setAccountProperties(const QString &accountId, const QVariantMap &properties);
     QString formatAccountId(const QString &accountId);
 
+public Q_SLOTS:
+    // writes the pending changes to disk
+    void flush();
+
+Q_SIGNALS:
+    // only the properties that really changed are passed
+    void accountPropertiesChanged(const QString &accountId, const QVariantMap &properties);
+
 protected:
     explicit AccountProperties(QObject *parent = 0);
 
 private:
+    void load();
+
     QSettings *mSettings;
+    QMap<QString,QVariantMap> mProperties;
+    QSet<QString> mDirtyAccounts;
+    QTimer mFlushTimer;
 };
 
 #endif // ACCOUNTPROPERTIES_H
@@ -22,44 +22,16 @@
 #include "audioroutemanager.h"
 #include "telepathyhelper.h"
 #include "accountentry.h"
+#include "telephonylogging.h"
 #include <TelepathyQt/Contact>
 #include <TelepathyQt/Functors>
 
 
-static void enable_earpiece()
-{
-#ifdef USE_PULSEAUDIO
-    QPulseAudioEngine::instance()->setCallMode(CallActive, AudioModeBtOrWiredOrEarpiece);
-#endif
-}
-
-static void enable_normal()
-{
-#ifdef USE_PULSEAUDIO
-    QTimer* timer = new QTimer();
-    timer->setSingleShot(true);
-    QObject::connect(timer, &QTimer::timeout, [=](){
-        QPulseAudioEngine::instance()->setMicMute(false);
-        QPulseAudioEngine::instance()->setCallMode(CallEnded, AudioModeWiredOrSpeaker);
-        timer->deleteLater();
-    });
-    timer->start(2000);
-#endif
-}
-
-static void enable_speaker()
-{
-#ifdef USE_PULSEAUDIO
-    QPulseAudioEngine::instance()->setCallMode(CallActive, AudioModeSpeaker);
-#endif
-}
-
-static void enable_ringtone()
-{
-#ifdef USE_PULSEAUDIO
-    QPulseAudioEngine::instance()->setCallMode(CallRinging, AudioModeBtOrWiredOrSpeaker);
-#endif
-}
+// state changes arriving closer than this to the last route change are
+// collapsed into a single reconfiguration
+#define ROUTE_COALESCE_INTERVAL 150
+// going back to normal is delayed so the end of the call is not cut short
+#define NORMAL_ROUTE_DELAY 2000
 
 AudioRouteManager *AudioRouteManager::instance()
 {
@@ -68,8 +40,11 @@ AudioRouteManager *AudioRouteManager::instance()
 }
 
 AudioRouteManager::AudioRouteManager(QObject *parent) :
-    QObject(parent), mAudioModeMediator(mPowerDDBus)
+    QObject(parent), mAudioModeMediator(mPowerDDBus), mPendingRoute(RouteNone), mAppliedRoute(RouteNone)
 {
+    mRouteTimer.setSingleShot(true);
+    connect(&mRouteTimer, SIGNAL(timeout()), SLOT(applyPendingRoute()));
+
     TelepathyHelper::instance()->registerChannelObserver("TelephonyServiceHandlerAudioRouteManager");
 
     QObject::connect(TelepathyHelper::instance()->channelObserver(), SIGNAL(callChannelAvailable(Tp::CallChannelPtr)),
@@ -124,8 +99,11 @@ void AudioRouteManager::setActiveAudioOutput(const QString &id)
     } else if (id == "speaker") {
         mode = AudioModeSpeaker;
     }
-    if (mHasPulseAudio)
+    if (mHasPulseAudio) {
+        // the user picked the output, so whatever comes next has to be applied
+        mAppliedRoute = RouteNone;
         QPulseAudioEngine::instance()->setCallMode(CallActive, mode);
+    }
 #endif
 }
 
@@ -160,29 +138,83 @@ void AudioRouteManager::updateAudioRoute(bool newCall)
             bool incoming = callChannel->initiatorContact() != accountEntry->account()->connection()->selfContact();
             Tp::CallState state = callChannel->callState();
             if (incoming && newCall) {
-                enable_ringtone();
+                requestRoute(RouteRingtone);
                 return;
             }
             if (state == Tp::CallStateEnded) {
-                enable_normal();
+                requestRoute(RouteNormal);
                 return;
             }
             // if only one call and dialing, or incoming call just accepted, then default to earpiece
             if (newCall || (state == Tp::CallStateAccepted && incoming)) {
-                enable_earpiece();
+                requestRoute(RouteEarpiece);
                 return;
             }
         }
     } else {
-        enable_normal();
+        requestRoute(RouteNormal);
         Q_EMIT lastChannelClosed();
     }
 }
 
+void AudioRouteManager::requestRoute(Route route)
+{
+    mPendingRoute = route;
+
+    if (route == RouteNormal) {
+        // a new call arriving in the meantime replaces this request
+        mRouteTimer.start(NORMAL_ROUTE_DELAY);
+        return;
+    }
+
+    // the first change after a quiet period is applied right away, and so is
+    // answering a ringing call, so neither gets any slower. Only the changes
+    // following those within the interval are coalesced into the last one.
+    bool inBurst = mLastRouteChange.isValid() && !mLastRouteChange.hasExpired(ROUTE_COALESCE_INTERVAL);
+    if (!inBurst || (mAppliedRoute == RouteRingtone && route == RouteEarpiece)) {
+        applyPendingRoute();
+        return;
+    }
+
+    if (!mRouteTimer.isActive() || mRouteTimer.interval() != ROUTE_COALESCE_INTERVAL) {
+        mRouteTimer.start(ROUTE_COALESCE_INTERVAL);
+    }
+}
+
+void AudioRouteManager::applyPendingRoute()
+{
+    mRouteTimer.stop();
+    Route route = mPendingRoute;
+    mPendingRoute = RouteNone;
+    if (route == RouteNone || route == mAppliedRoute) {
+        return;
+    }
+
+    mAppliedRoute = route;
+    mLastRouteChange.start();
+
+#ifdef USE_PULSEAUDIO
+    switch (route) {
+    case RouteRingtone:
+        QPulseAudioEngine::instance()->setCallMode(CallRinging, AudioModeBtOrWiredOrSpeaker);
+        break;
+    case RouteEarpiece:
+        QPulseAudioEngine::instance()->setCallMode(CallActive, AudioModeBtOrWiredOrEarpiece);
+        break;
+    case RouteNormal:
+        QPulseAudioEngine::instance()->setMicMute(false);
+        QPulseAudioEngine::instance()->setCallMode(CallEnded, AudioModeWiredOrSpeaker);
+        break;
+    default:
+        break;
+    }
+#endif
+}
+
 #ifdef USE_PULSEAUDIO
 void AudioRouteManager::onAudioModeChanged(AudioMode mode)
 {
-    qDebug("PulseAudio audio mode changed: 0x%x", mode);
+    qCDebug(lcAudio, "PulseAudio audio mode changed: 0x%x", mode);
 
     if (mode == AudioModeEarpiece && mActiveAudioOutput != "earpiece") {
         mActiveAudioOutput = "earpiece";
@@ -198,7 +230,7 @@ void AudioRouteManager::onAudioModeChanged(AudioMode mode)
 
 void AudioRouteManager::onAvailableAudioModesChanged(AudioModes modes)
 {
-    qDebug("PulseAudio available audio modes changed");
+    qCDebug(lcAudio, "PulseAudio available audio modes changed");
     bool defaultFound = false;
     mAudioOutputs.clear();
     Q_FOREACH(const AudioMode &mode, modes) {
@@ -28,7 +28,9 @@
 #include "audiooutput.h"
 #include "powerdaudiomodemediator.h"
 #include "powerddbus.h"
+#include <QElapsedTimer>
 #include <QObject>
+#include <QTimer>
 #include <TelepathyQt/CallChannel>
 
 
@@ -55,18 +57,32 @@ protected Q_SLOTS:
     void onCallStateChanged(Tp::CallState state);
 
 private Q_SLOTS:
+    void applyPendingRoute();
 #ifdef USE_PULSEAUDIO
     void onAudioModeChanged(AudioMode mode);
     void onAvailableAudioModesChanged(AudioModes modes);
 #endif
 
 private:
+    enum Route {
+        RouteNone,
+        RouteRingtone,
+        RouteEarpiece,
+        RouteNormal
+    };
+
     explicit AudioRouteManager(QObject *parent = 0);
+    void requestRoute(Route route);
+
     QList<Tp::CallChannelPtr> mChannels;
     AudioOutputDBusList mAudioOutputs;
     QString mActiveAudioOutput;
     PowerDDBus mPowerDDBus;
     PowerDAudioModeMediator mAudioModeMediator;
+    QTimer mRouteTimer;
+    QElapsedTimer mLastRouteChange;
+    Route mPendingRoute;
+    Route mAppliedRoute;
 #ifdef USE_PULSEAUDIO
     bool mHasPulseAudio;
 #endif
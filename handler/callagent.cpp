@@ -20,6 +20,7 @@
  */
 
 #include "callagent.h"
+#include "telephonylogging.h"
 #include <TelepathyQt/CallContent>
 #include <TelepathyQt/Contact>
 #include <TelepathyQt/Farstream/Channel>
@@ -86,7 +87,7 @@ void CallAgent::onContentAdded(const Tp::CallContentPtr &content)
         return;
     }
 
-    qDebug() << "Content Added, name: " << content->name() << " type: " << content->type();
+    qCDebug(lcHandlerCall) << "Content Added, name: " << content->name() << " type: " << content->type();
 
     connect(content.data(),
             SIGNAL(streamAdded(Tp::CallStreamPtr)),
@@ -99,11 +100,11 @@ void CallAgent::onContentAdded(const Tp::CallContentPtr &content)
 
 void CallAgent::onStreamAdded(const Tp::CallStreamPtr &stream)
 {
-    qDebug() << "Stream present: " << stream->localSendingState();
+    qCDebug(lcHandlerCall) << "Stream present: " << stream->localSendingState();
 
-    qDebug() << "  members " << stream->remoteMembers().size();
+    qCDebug(lcHandlerCall) << "  members " << stream->remoteMembers().size();
     Q_FOREACH(const Tp::ContactPtr contact, stream->remoteMembers()) {
-        qDebug() << "    member " << contact->id() << " remoteSendingState=" << stream->remoteSendingState(contact);
+        qCDebug(lcHandlerCall) << "    member " << contact->id() << " remoteSendingState=" << stream->remoteSendingState(contact);
     }
 }
 
@@ -23,19 +23,30 @@
 #include "accountproperties.h"
 #include "callagent.h"
 #include "callhandler.h"
+#include "flowtracer.h"
 #include "telepathyhelper.h"
 #include "accountentry.h"
 #include "tonegenerator.h"
 #include "greetercontacts.h"
 #include "phoneutils.h"
+#include "telephonylogging.h"
+#include <TelepathyQt/Constants>
 #include <TelepathyQt/ContactManager>
 #include <TelepathyQt/PendingContacts>
 #include <TelepathyQt/PendingChannelRequest>
 #include <TelepathyQt/PendingVariant>
+#include <QTimer>
 #include <memory>
 
 #define TELEPATHY_MUTE_IFACE "org.freedesktop.Telepathy.Call1.Interface.Mute"
-#define DBUS_PROPERTIES_IFACE "org.freedesktop.DBus.Properties"
+
+// when sending tones one at a time, the gap between them adapts to how fast
+// the service finishes each tone, within these bounds (in milliseconds)
+#define DTMF_MIN_INTER_DIGIT_DELAY 100
+#define DTMF_MAX_INTER_DIGIT_DELAY 250
+#define DTMF_DELAY_STEP 25
+// how long to wait for the service to report it stopped sending a tone
+#define DTMF_TONE_TIMEOUT 1000
 
 typedef QMap<QString, QVariant> dbusQMap;
 Q_DECLARE_METATYPE(dbusQMap)
@@ -48,34 +59,30 @@ CallHandler *CallHandler::instance()
 
 QVariantMap CallHandler::getCallProperties(const QString &objectPath)
 {
-    QVariantMap properties;
-    Tp::CallChannelPtr channel = callFromObjectPath(objectPath);
-    if (!channel) {
-        return properties;
+    CallState *state = callState(objectPath);
+    if (!state) {
+        return QVariantMap();
     }
 
-    QVariant property = channel->property("timestamp");
-    if (property.isValid()) {
-        properties["timestamp"] = property;
-    }
+    return callProperties(*state, AllCallProperties);
+}
 
-    property = channel->property("activeTimestamp");
-    if (property.isValid()) {
-        properties["activeTimestamp"] = property;
-    }
-    property = channel->property("dtmfString");
-    if (property.isValid()) {
-        properties["dtmfString"] = property;
+QVariantMap CallHandler::allCallProperties() const
+{
+    QVariantMap calls;
+    QHash<QString, CallState>::const_iterator it = mCalls.constBegin();
+    for (; it != mCalls.constEnd(); ++it) {
+        calls[it.key()] = callProperties(it.value(), AllCallProperties);
     }
-
-    return properties;
+    return calls;
 }
 
 bool CallHandler::hasCalls() const
 {
     bool hasActiveCalls = false;
 
-    Q_FOREACH(const Tp::CallChannelPtr channel, mCallChannels) {
+    Q_FOREACH(const CallState &state, mCalls) {
+        const Tp::CallChannelPtr &channel = state.channel;
         bool incoming = isIncoming(channel);
         bool dialing = !incoming && (channel->callState() == Tp::CallStateInitialised);
         bool active = channel->callState() == Tp::CallStateActive;
@@ -89,10 +96,32 @@ bool CallHandler::hasCalls() const
     return hasActiveCalls;
 }
 
+CallHandler::CallState::CallState()
+: agent(0),
+  sendingDTMF(false),
+  dtmfSequenceStart(0),
+  dtmfSequenceDigits(0)
+{
+}
+
+CallHandler::DTMFProtocolInfo::DTMFProtocolInfo()
+: multipleTones(true),
+  interDigitDelay(DTMF_MAX_INTER_DIGIT_DELAY),
+  sequences(0),
+  digits(0),
+  totalTime(0),
+  maxTime(0)
+{
+}
+
 CallHandler::CallHandler(QObject *parent)
 : QObject(parent),
   mHangupRequested(false)
 {
+    mDTMFClock.start();
+    connect(AccountProperties::instance(),
+            SIGNAL(accountPropertiesChanged(QString,QVariantMap)),
+            SLOT(onAccountPropertiesChanged(QString)));
 }
 
 void CallHandler::startCall(const QString &targetId, const QString &accountId)
@@ -114,8 +143,7 @@ void CallHandler::startCall(const QString &targetId, const QString &accountId)
     // we can request a handle based on the vCard field "tel"
     if (accountEntry->protocolInfo()->name() == "sip") {
         // check if the phone number needs rewriting
-        QVariantMap accountProperties = AccountProperties::instance()->accountProperties(accountId);
-        finalId = applyNumberRewritingRules(finalId, accountProperties);
+        finalId = numberRewriter(accountId).rewrite(finalId);
 
         // replace the numbers by a SIP URI
         QString domain = accountEntry->account()->parameters()["account"].toString();
@@ -126,6 +154,14 @@ void CallHandler::startCall(const QString &targetId, const QString &accountId)
         }
     }
 
+    QString traceId = FlowTracer::instance()->newTraceId();
+    if (!traceId.isEmpty()) {
+        QVariantMap args;
+        args["direction"] = "outgoing";
+        FlowTracer::instance()->begin(traceId, "call", args);
+        mPendingCallTraces[finalId] = traceId;
+    }
+
     connect(connection->contactManager()->contactsForIdentifiers(QStringList() << finalId),
             SIGNAL(finished(Tp::PendingOperation*)),
             SLOT(onContactsAvailable(Tp::PendingOperation*)));
@@ -168,7 +204,7 @@ void CallHandler::setMuted(const QString &objectPath, bool muted)
     }
 
     if (channel->handlerStreamingRequired()) {
-        CallAgent *agent = mCallAgents[channel.data()];
+        CallAgent *agent = mCalls[objectPath].agent;
         if (!agent) {
             return;
         }
@@ -193,25 +229,25 @@ void CallHandler::sendDTMF(const QString &objectPath, const QString &key)
         ToneGenerator::instance()->playDTMFTone(event);
     }
 
-    Tp::CallChannelPtr channel = callFromObjectPath(objectPath);
-    if (channel.isNull()) {
+    CallState *state = callState(objectPath);
+    if (!state) {
         return;
     }
 
     // save the dtmfString to send to clients that request it
-    QString dtmfString = channel->property("dtmfString").toString();
-    QString pendingDTMF = channel->property("pendingDTMF").toString();
-    pendingDTMF += key;
-    dtmfString += key;
-    channel->setProperty("dtmfString", dtmfString);
-    channel->setProperty("pendingDTMF", pendingDTMF);
-
-    // if there is only one pending DTMF event, start playing it
-    if (pendingDTMF.length() == 1) {
-        playNextDTMFTone(channel);
+    state->dtmfString += key;
+    state->pendingDTMF += key;
+
+    // if nothing is being sent, start a new sequence, otherwise the key goes
+    // out together with the next batch
+    if (!state->sendingDTMF) {
+        state->sendingDTMF = true;
+        state->dtmfSequenceStart = mDTMFClock.elapsed();
+        state->dtmfSequenceDigits = 0;
+        playNextDTMFTone(state->channel);
     }
 
-    Q_EMIT callPropertiesChanged(channel->objectPath(), getCallProperties(channel->objectPath()));
+    notifyCallPropertiesChanged(*state, CallPropertyDTMFString);
 }
 
 void CallHandler::createConferenceCall(const QStringList &objectPaths)
@@ -221,7 +257,7 @@ void CallHandler::createConferenceCall(const QStringList &objectPaths)
     Q_FOREACH(const QString &objectPath, objectPaths) {
         Tp::CallChannelPtr call = callFromObjectPath(objectPath);
         if (!call) {
-            qWarning() << "Could not find a call channel for objectPath:" << objectPath;
+            qCWarning(lcHandlerCall) << "Could not find a call channel for objectPath:" << objectPath;
             return;
         }
 
@@ -231,14 +267,14 @@ void CallHandler::createConferenceCall(const QStringList &objectPaths)
 
         // make sure all call channels belong to the same connection
         if (call->connection() != accountEntry->account()->connection()) {
-            qWarning() << "It is not possible to merge channels from different accounts.";
+            qCWarning(lcHandlerCall) << "It is not possible to merge channels from different accounts.";
             return;
         }
         calls.append(call);
     }
 
     if (calls.isEmpty() || !accountEntry) {
-        qWarning() << "The list of calls was empty. Failed to create a conference.";
+        qCWarning(lcHandlerCall) << "The list of calls was empty. Failed to create a conference.";
         return;
     }
 
@@ -255,7 +291,7 @@ void CallHandler::mergeCall(const QString &conferenceObjectPath, const QString &
     Tp::CallChannelPtr conferenceChannel = callFromObjectPath(conferenceObjectPath);
     Tp::CallChannelPtr callChannel = callFromObjectPath(callObjectPath);
     if (!conferenceChannel || !callChannel || !conferenceChannel->isConference()) {
-        qWarning() << "No valid channels found.";
+        qCWarning(lcHandlerCall) << "No valid channels found.";
         return;
     }
 
@@ -276,15 +312,28 @@ void CallHandler::splitCall(const QString &objectPath)
 
 void CallHandler::onCallChannelAvailable(Tp::CallChannelPtr channel)
 {
-    QDBusInterface callChannelIface(channel->busName(), channel->objectPath(), DBUS_PROPERTIES_IFACE);
-    channel->setProperty("timestamp", QDateTime::currentDateTimeUtc());
+    CallState &state = mCalls[channel->objectPath()];
+    state.channel = channel;
+    state.timestamp = QDateTime::currentDateTimeUtc();
 
     if (channel->callState() == Tp::CallStateActive) {
-        channel->setProperty("activeTimestamp", QDateTime::currentDateTimeUtc());
+        state.activeTimestamp = state.timestamp;
     } else if (channel->callState() == Tp::CallStatePendingInitiator) {
         channel->accept();
     }
 
+    if (FlowTracer::instance()->isEnabled()) {
+        QString targetId = channel->targetContact() ? channel->targetContact()->id() : QString();
+        state.traceId = mPendingCallTraces.take(targetId);
+        if (state.traceId.isEmpty()) {
+            state.traceId = FlowTracer::instance()->newTraceId();
+            QVariantMap args;
+            args["direction"] = isIncoming(channel) ? "incoming" : "outgoing";
+            FlowTracer::instance()->begin(state.traceId, "call", args);
+        }
+        FlowTracer::instance()->instant(state.traceId, "channel-available");
+    }
+
     connect(channel.data(),
             SIGNAL(invalidated(Tp::DBusProxy*,QString,QString)),
             SLOT(onCallChannelInvalidated()));
@@ -292,12 +341,9 @@ void CallHandler::onCallChannelAvailable(Tp::CallChannelPtr channel)
             SIGNAL(callStateChanged(Tp::CallState)),
             SLOT(onCallStateChanged(Tp::CallState)));
 
-    // FIXME: save this to a list
-    CallAgent *agent = new CallAgent(channel, this);
-    mCallAgents[channel.data()] = agent;
+    state.agent = new CallAgent(channel, this);
 
-    mCallChannels.append(channel);
-    Q_EMIT callPropertiesChanged(channel->objectPath(), getCallProperties(channel->objectPath()));
+    notifyCallPropertiesChanged(state, AllCallProperties);
 }
 
 void CallHandler::onContactsAvailable(Tp::PendingOperation *op)
@@ -305,25 +351,65 @@ void CallHandler::onContactsAvailable(Tp::PendingOperation *op)
     Tp::PendingContacts *pc = qobject_cast<Tp::PendingContacts*>(op);
 
     if (!pc) {
-        qCritical() << "The pending object is not a Tp::PendingContacts";
+        qCCritical(lcHandlerCall) << "The pending object is not a Tp::PendingContacts";
         return;
     }
 
     AccountEntry *accountEntry = TelepathyHelper::instance()->accountForConnection(pc->manager()->connection());
+    if (!accountEntry || pc->isError()) {
+        qCWarning(lcHandlerCall) << "Failed to get the contacts to call:" << pc->identifiers() << pc->errorName();
+        Q_FOREACH(const QString &identifier, pc->identifiers()) {
+            abandonCallTrace(identifier, pc->isError() ? pc->errorName() : QString("no account"));
+        }
+        return;
+    }
+
+    // no channel is going to show up for these
+    Q_FOREACH(const QString &identifier, pc->invalidIdentifiers().keys()) {
+        abandonCallTrace(identifier, pc->invalidIdentifiers()[identifier].first);
+    }
 
     // start call to the contacts
     Q_FOREACH(Tp::ContactPtr contact, pc->contacts()) {
-        accountEntry->account()->ensureAudioCall(contact, QLatin1String("audio"), QDateTime::currentDateTime(), TP_QT_IFACE_CLIENT + ".TelephonyServiceHandler");
+        Tp::PendingChannelRequest *request = accountEntry->account()->ensureAudioCall(contact, QLatin1String("audio"), QDateTime::currentDateTime(), TP_QT_IFACE_CLIENT + ".TelephonyServiceHandler");
+        QString contactId = contact->id();
+        connect(request, &Tp::PendingOperation::finished, [this, request, contactId] {
+            if (request->isError()) {
+                abandonCallTrace(contactId, request->errorName());
+            }
+        });
 
         // hold the ContactPtr to make sure its refcounting stays bigger than 0
         mContacts[contact->id()] = contact;
+
+        // the channel comes back with the normalized id of the contact
+        Q_FOREACH(const QString &identifier, pc->identifiers()) {
+            if (mPendingCallTraces.contains(identifier)) {
+                QString traceId = mPendingCallTraces.take(identifier);
+                FlowTracer::instance()->instant(traceId, "contact-ready");
+                mPendingCallTraces[contact->id()] = traceId;
+            }
+        }
+    }
+}
+
+void CallHandler::abandonCallTrace(const QString &targetId, const QString &error)
+{
+    // the outgoing call failed before it got a channel, so close its trace
+    // here instead of when the channel goes away
+    QString traceId = mPendingCallTraces.take(targetId);
+    if (traceId.isEmpty()) {
+        return;
     }
+    QVariantMap args;
+    args["error"] = error;
+    FlowTracer::instance()->end(traceId, "call", args);
 }
 
 void CallHandler::onCallHangupFinished(Tp::PendingOperation *op)
 {
     if (!mClosingChannels.contains(op)) {
-        qCritical() << "Channel for pending hangup not found:" << op;
+        qCCritical(lcHandlerCall) << "Channel for pending hangup not found:" << op;
         return;
     }
 
@@ -331,7 +417,7 @@ void CallHandler::onCallHangupFinished(Tp::PendingOperation *op)
     // if you request it to be closed, the CallStateEnded will never be reached and the UI
     // and logging will be broken.
     Tp::CallChannelPtr channel = mClosingChannels.take(op);
-    if (mCallChannels.count() == 1) {
+    if (mCalls.count() == 1) {
         mHangupRequested = true;
     }
 }
@@ -344,14 +430,14 @@ void CallHandler::onCallChannelInvalidated()
         return;
     }
 
-    mCallChannels.removeAll(channel);
-    if (mCallAgents.contains(channel.data())) {
-        CallAgent *agent = mCallAgents.take(channel.data());
-        agent->deleteLater();
+    CallState state = mCalls.take(channel->objectPath());
+    if (state.agent) {
+        state.agent->deleteLater();
     }
+    FlowTracer::instance()->end(state.traceId, "call");
 
     ToneGenerator::instance()->stopTone();
-    if (mCallChannels.isEmpty() && !mHangupRequested) {
+    if (mCalls.isEmpty() && !mHangupRequested) {
         ToneGenerator::instance()->playCallEndedTone();
     }
     mHangupRequested = false;
@@ -381,8 +467,11 @@ void CallHandler::onCallStateChanged(Tp::CallState state)
         if (channel->handlerStreamingRequired()) {
             ToneGenerator::instance()->stopTone();
         }
-        channel->setProperty("activeTimestamp", QDateTime::currentDateTimeUtc());
-        Q_EMIT callPropertiesChanged(channel->objectPath(), getCallProperties(channel->objectPath()));
+        if (CallState *state = callState(channel->objectPath())) {
+            state->activeTimestamp = QDateTime::currentDateTimeUtc();
+            notifyCallPropertiesChanged(*state, CallPropertyActiveTimestamp);
+            FlowTracer::instance()->instant(state->traceId, "call-active");
+        }
         break;
     case Tp::CallStateEnded:
         ToneGenerator::instance()->stopTone();
@@ -391,10 +480,50 @@ void CallHandler::onCallStateChanged(Tp::CallState state)
     }
 }
 
+CallHandler::CallState *CallHandler::callState(const QString &objectPath)
+{
+    QHash<QString, CallState>::iterator it = mCalls.find(objectPath);
+    if (it == mCalls.end()) {
+        return 0;
+    }
+    return &it.value();
+}
+
+QVariantMap CallHandler::callProperties(const CallState &state, int properties) const
+{
+    QVariantMap result;
+    if ((properties & CallPropertyTimestamp) && state.timestamp.isValid()) {
+        result["timestamp"] = state.timestamp;
+    }
+    if ((properties & CallPropertyActiveTimestamp) && state.activeTimestamp.isValid()) {
+        result["activeTimestamp"] = state.activeTimestamp;
+    }
+    if ((properties & CallPropertyDTMFString) && !state.dtmfString.isEmpty()) {
+        result["dtmfString"] = state.dtmfString;
+    }
+    if ((properties & CallPropertyTraceId) && !state.traceId.isEmpty()) {
+        result[TRACE_ID_PROPERTY] = state.traceId;
+    }
+    return result;
+}
+
+void CallHandler::notifyCallPropertiesChanged(const CallState &state, int properties)
+{
+    // only the properties that changed are sent, clients merge them into
+    // what they already have
+    QVariantMap changed = callProperties(state, properties);
+    if (!changed.isEmpty()) {
+        Q_EMIT callPropertiesChanged(state.channel->objectPath(), changed);
+    }
+}
+
 Tp::CallChannelPtr CallHandler::existingCall(const QString &targetId)
 {
+    // ids need to be compared the way the account does it (phone numbers
+    // match loosely), so this cannot be a plain lookup
     Tp::CallChannelPtr channel;
-    Q_FOREACH(const Tp::CallChannelPtr &ch, mCallChannels) {
+    Q_FOREACH(const CallState &state, mCalls) {
+        const Tp::CallChannelPtr &ch = state.channel;
         if (ch->isConference()) {
             continue;
         }
@@ -415,93 +544,193 @@ Tp::CallChannelPtr CallHandler::existingCall(const QString &targetId)
 
 Tp::CallChannelPtr CallHandler::callFromObjectPath(const QString &objectPath)
 {
-    Tp::CallChannelPtr channel;
-    Q_FOREACH(const Tp::CallChannelPtr &ch, mCallChannels) {
-        if (ch->objectPath() == objectPath) {
-            channel = ch;
-            break;
-        }
-    }
-
-    return channel;
+    return mCalls.value(objectPath).channel;
 }
 
 void CallHandler::playNextDTMFTone(Tp::CallChannelPtr channel)
 {
     // the channel might have been closed already
-    if (!channel) {
+    CallState *state = channel ? callState(channel->objectPath()) : 0;
+    if (!state) {
         return;
     }
 
-    QString pendingDTMF = channel->property("pendingDTMF").toString();
-    QString key = "";
-    if (!pendingDTMF.isEmpty()) {
-        key = pendingDTMF[0];
+    Tp::CallContentPtr dtmfContent;
+    Q_FOREACH(const Tp::CallContentPtr &content, channel->contents()) {
+        if (content->supportsDTMF()) {
+            dtmfContent = content;
+            break;
+        }
     }
 
-    int event = toDTMFEvent(key);
+    // skip the keys that are not valid DTMF events
+    QString tones;
+    Q_FOREACH(const QChar &key, state->pendingDTMF) {
+        if (toDTMFEvent(key) >= 0) {
+            tones += key;
+        }
+    }
 
-    Q_FOREACH(const Tp::CallContentPtr &content, channel->contents()) {
-        if (content->supportsDTMF()) {
+    if (tones.isEmpty() || !dtmfContent) {
+        state->pendingDTMF.clear();
+        finishDTMFSequence(channel);
+        return;
+    }
 
-            /* stop any previous DTMF tone before sending the new one*/
-            connect(content->stopDTMFTone(), &Tp::PendingOperation::finished, [=](Tp::PendingOperation *op){
-                // in case stopDTMFTone, it might mean the service automatically stops the tone,
-                // so try playing the next one
-                if (op->isError()) {
-                    /* send DTMF to network (via telepathy) */
-                    if (event >= 0) {
-                        content->startDTMFTone((Tp::DTMFEvent)event);
-                    }
-                    triggerNextDTMFTone(channel);
-                    return;
-                }
-
-                Tp::Client::CallContentInterfaceDTMFInterface *dtmfInterface = content->interface<Tp::Client::CallContentInterfaceDTMFInterface>();
-                Tp::PendingVariant *pv = dtmfInterface->requestPropertyCurrentlySendingTones();
-                connect(pv, &Tp::PendingOperation::finished, [=](){
-                    bool sendingTones = pv->result().toBool();
-                    // if we already stopped sending tones, we can send the next one
-                    if (!sendingTones) {
-                        /* send DTMF to network (via telepathy) */
-                        if (event >= 0) {
-                            content->startDTMFTone((Tp::DTMFEvent)event);
-                        }
-                        triggerNextDTMFTone(channel);
-                        return;
-                    }
-
-                    // in case the previous tone is not finished, we need to wait for it
-                    auto conn = std::make_shared<QMetaObject::Connection>();
-                    *conn = connect(dtmfInterface, &Tp::Client::CallContentInterfaceDTMFInterface::StoppedTones, [=](){
-                        QObject::disconnect(*conn);
-
-                        /* send DTMF to network (via telepathy) */
-                        if (event >= 0) {
-                            content->startDTMFTone((Tp::DTMFEvent)event);
-                        }
-                        triggerNextDTMFTone(channel);
-                    });
-                });
+    if (mDTMFProtocols[channel->connection()->protocolName()].multipleTones) {
+        state->pendingDTMF.clear();
+        sendMultipleTones(channel, dtmfContent, tones);
+    } else {
+        state->pendingDTMF = tones.mid(1);
+        sendSingleTone(channel, dtmfContent, tones.left(1));
+    }
+}
 
+void CallHandler::sendMultipleTones(Tp::CallChannelPtr channel, Tp::CallContentPtr content, const QString &tones)
+{
+    QString protocol = channel->connection()->protocolName();
+    Tp::Client::CallContentInterfaceDTMFInterface *dtmfInterface = content->interface<Tp::Client::CallContentInterfaceDTMFInterface>();
+    mCalls[channel->objectPath()].dtmfSequenceDigits += tones.length();
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(dtmfInterface->MultipleTones(tones), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, [=](QDBusPendingCallWatcher *call) {
+        call->deleteLater();
+        QDBusPendingReply<> reply = *call;
+        if (!reply.isError()) {
+            // the service plays the whole batch now, the keys typed in the
+            // meantime go out once it is done
+            waitForStoppedTones(content, tones.length() * DTMF_TONE_TIMEOUT, [=]() {
+                playNextDTMFTone(channel);
             });
+            return;
         }
-    }
+
+        CallState *state = callState(channel->objectPath());
+        if (!state) {
+            return;
+        }
+
+        // put the tones back in front of the ones typed in the meantime
+        state->pendingDTMF.prepend(tones);
+        state->dtmfSequenceDigits -= tones.length();
+
+        QString error = reply.error().name();
+        if (error == TP_QT_ERROR_SERVICE_BUSY) {
+            // a previous tone is still being sent
+            waitForStoppedTones(content, DTMF_TONE_TIMEOUT, [=]() {
+                playNextDTMFTone(channel);
+            });
+            return;
+        }
+
+        if (error == TP_QT_ERROR_NOT_IMPLEMENTED || reply.error().type() == QDBusError::UnknownMethod) {
+            qCDebug(lcHandlerCall) << "MultipleTones is not supported by" << protocol << ", sending DTMF tones one at a time";
+            mDTMFProtocols[protocol].multipleTones = false;
+            playNextDTMFTone(channel);
+            return;
+        }
+
+        qCWarning(lcHandlerCall) << "Failed to send DTMF tones:" << reply.error().message();
+        state->pendingDTMF.clear();
+        finishDTMFSequence(channel);
+    });
 }
 
-void CallHandler::triggerNextDTMFTone(Tp::CallChannelPtr channel)
+void CallHandler::sendSingleTone(Tp::CallChannelPtr channel, Tp::CallContentPtr content, const QString &key)
 {
-    QTimer::singleShot(250, [=](){
-        QString pendingDTMF = channel->property("pendingDTMF").toString();
-        if (pendingDTMF.isEmpty()) {
+    QString protocol = channel->connection()->protocolName();
+    Tp::DTMFEvent event = (Tp::DTMFEvent)toDTMFEvent(key);
+    mCalls[channel->objectPath()].dtmfSequenceDigits++;
+
+    /* stop any previous DTMF tone before sending the new one*/
+    connect(content->stopDTMFTone(), &Tp::PendingOperation::finished, [=](Tp::PendingOperation *op){
+        // in case stopDTMFTone, it might mean the service automatically stops the tone,
+        // so try playing the next one
+        if (op->isError()) {
+            /* send DTMF to network (via telepathy) */
+            content->startDTMFTone(event);
+            triggerNextDTMFTone(channel, mDTMFProtocols[protocol].interDigitDelay);
             return;
         }
-        pendingDTMF.remove(0, 1);
-        channel->setProperty("pendingDTMF", pendingDTMF);
+
+        Tp::Client::CallContentInterfaceDTMFInterface *dtmfInterface = content->interface<Tp::Client::CallContentInterfaceDTMFInterface>();
+        Tp::PendingVariant *pv = dtmfInterface->requestPropertyCurrentlySendingTones();
+        connect(pv, &Tp::PendingOperation::finished, [=](){
+            DTMFProtocolInfo &info = mDTMFProtocols[protocol];
+            bool sendingTones = pv->result().toBool();
+            // if we already stopped sending tones, we can send the next one,
+            // and the gap before the following one can be shorter
+            if (!sendingTones) {
+                info.interDigitDelay = qMax(DTMF_MIN_INTER_DIGIT_DELAY, info.interDigitDelay - DTMF_DELAY_STEP);
+                /* send DTMF to network (via telepathy) */
+                content->startDTMFTone(event);
+                triggerNextDTMFTone(channel, info.interDigitDelay);
+                return;
+            }
+
+            // in case the previous tone is not finished, we need to wait for it,
+            // and leave a longer gap next time
+            info.interDigitDelay = qMin(DTMF_MAX_INTER_DIGIT_DELAY, info.interDigitDelay + DTMF_DELAY_STEP);
+            waitForStoppedTones(content, DTMF_TONE_TIMEOUT, [=](){
+                /* send DTMF to network (via telepathy) */
+                content->startDTMFTone(event);
+                triggerNextDTMFTone(channel, mDTMFProtocols[protocol].interDigitDelay);
+            });
+        });
+    });
+}
+
+void CallHandler::triggerNextDTMFTone(Tp::CallChannelPtr channel, int delay)
+{
+    QTimer::singleShot(delay, this, [=](){
         playNextDTMFTone(channel);
     });
 }
 
+void CallHandler::waitForStoppedTones(Tp::CallContentPtr content, int timeout, std::function<void()> callback)
+{
+    Tp::Client::CallContentInterfaceDTMFInterface *dtmfInterface = content->interface<Tp::Client::CallContentInterfaceDTMFInterface>();
+
+    // whichever comes first, the signal or the timeout, continues the sequence
+    QTimer *timer = new QTimer(this);
+    timer->setSingleShot(true);
+    auto conn = std::make_shared<QMetaObject::Connection>();
+    auto done = [=]() {
+        QObject::disconnect(*conn);
+        timer->stop();
+        timer->deleteLater();
+        callback();
+    };
+    *conn = connect(dtmfInterface, &Tp::Client::CallContentInterfaceDTMFInterface::StoppedTones, done);
+    connect(timer, &QTimer::timeout, done);
+    timer->start(timeout);
+}
+
+void CallHandler::finishDTMFSequence(Tp::CallChannelPtr channel)
+{
+    CallState *state = callState(channel->objectPath());
+    if (!state || !state->sendingDTMF) {
+        return;
+    }
+    state->sendingDTMF = false;
+
+    int digits = state->dtmfSequenceDigits;
+    if (digits == 0) {
+        return;
+    }
+
+    QString protocol = channel->connection()->protocolName();
+    qint64 elapsed = mDTMFClock.elapsed() - state->dtmfSequenceStart;
+    DTMFProtocolInfo &info = mDTMFProtocols[protocol];
+    info.sequences++;
+    info.digits += digits;
+    info.totalTime += elapsed;
+    info.maxTime = qMax(info.maxTime, elapsed);
+    qCDebug(lcHandlerCall) << "DTMF sequence of" << digits << "digits sent in" << elapsed << "ms on" << protocol
+             << (info.multipleTones ? "(batched)" : "(one tone at a time)")
+             << "- average per digit:" << info.totalTime / info.digits << "ms, slowest sequence:" << info.maxTime << "ms";
+}
+
 int CallHandler::toDTMFEvent(const QString &key)
 {
     bool ok;
@@ -524,29 +753,16 @@ bool CallHandler::isIncoming(const Tp::CallChannelPtr &channel) const
     return channel->initiatorContact() != accountEntry->account()->connection()->selfContact();
 }
 
-QString CallHandler::applyNumberRewritingRules(const QString &originalNumber, const QVariantMap &properties)
+const NumberRewriter &CallHandler::numberRewriter(const QString &accountId)
 {
-    QString finalNumber = originalNumber;
-    if (properties.contains("numberRewrite") && properties["numberRewrite"].toBool()) {
-        // FIXME: do a proper phone number identification implementation
-        // for now consider anything bigger than 6 digits to be a phone number
-        if (finalNumber.length() <= 6) {
-            return finalNumber;
-        }
-
-        QString defaultCountryCode = properties["defaultCountryCode"].toString();
-        QString defaultAreaCode = properties["defaultAreaCode"].toString();
-        QString removeCharacters = properties["removeCharacters"].toString();
-        QString prefix = properties["prefix"].toString();
-
-        if (!defaultCountryCode.startsWith("+")) {
-            defaultCountryCode.prepend("+");
-        }
-
-        finalNumber = PhoneUtils::getFullNumber(finalNumber, defaultCountryCode, defaultAreaCode);
-        finalNumber.remove(removeCharacters);
-        finalNumber.prepend(prefix);
+    QHash<QString, NumberRewriter>::iterator it = mNumberRewriters.find(accountId);
+    if (it == mNumberRewriters.end()) {
+        it = mNumberRewriters.insert(accountId, NumberRewriter(AccountProperties::instance()->accountProperties(accountId)));
     }
+    return it.value();
+}
 
-    return finalNumber;
+void CallHandler::onAccountPropertiesChanged(const QString &accountId)
+{
+    mNumberRewriters.remove(accountId);
 }
@@ -23,9 +23,14 @@
 #ifndef CALLHANDLER_H
 #define CALLHANDLER_H
 
+#include <QtCore/QHash>
 #include <QtCore/QMap>
+#include <QDateTime>
 #include <QDBusInterface>
+#include <QElapsedTimer>
 #include <TelepathyQt/CallChannel>
+#include <functional>
+#include "numberrewriter.h"
 
 class TelepathyHelper;
 class CallAgent;
@@ -37,6 +42,8 @@ class CallHandler : public QObject
 public:
     static CallHandler *instance();
     QVariantMap getCallProperties(const QString &objectPath);
+    // object path -> properties of every call being handled
+    QVariantMap allCallProperties() const;
     bool hasCalls() const;
 
 public Q_SLOTS:
@@ -58,30 +65,84 @@ Q_SIGNALS:
     void callHoldingFailed(const QString &objectPath);
 
 protected:
+    // the properties clients can get through getCallProperties()
+    enum CallProperty {
+        CallPropertyTimestamp = 0x1,
+        CallPropertyActiveTimestamp = 0x2,
+        CallPropertyDTMFString = 0x4,
+        CallPropertyTraceId = 0x8,
+        AllCallProperties = 0xF
+    };
+
+    // what the handler keeps for each call channel
+    struct CallState {
+        CallState();
+        Tp::CallChannelPtr channel;
+        CallAgent *agent;
+        QDateTime timestamp;
+        QDateTime activeTimestamp;
+        QString dtmfString;
+        // DTMF keys not sent yet and the sequence being sent
+        QString pendingDTMF;
+        bool sendingDTMF;
+        qint64 dtmfSequenceStart;
+        int dtmfSequenceDigits;
+        // the flow the call is part of, see FlowTracer
+        QString traceId;
+    };
+
+    CallState *callState(const QString &objectPath);
+    QVariantMap callProperties(const CallState &state, int properties) const;
+    void notifyCallPropertiesChanged(const CallState &state, int properties);
+
     Tp::CallChannelPtr existingCall(const QString &targetId);
     Tp::CallChannelPtr callFromObjectPath(const QString &objectPath);
 
     void playNextDTMFTone(Tp::CallChannelPtr channel);
-    void triggerNextDTMFTone(Tp::CallChannelPtr channel);
+    void sendMultipleTones(Tp::CallChannelPtr channel, Tp::CallContentPtr content, const QString &tones);
+    void sendSingleTone(Tp::CallChannelPtr channel, Tp::CallContentPtr content, const QString &key);
+    void triggerNextDTMFTone(Tp::CallChannelPtr channel, int delay);
+    void waitForStoppedTones(Tp::CallContentPtr content, int timeout, std::function<void()> callback);
+    void finishDTMFSequence(Tp::CallChannelPtr channel);
     static int toDTMFEvent(const QString &key);
     bool isIncoming(const Tp::CallChannelPtr &channel) const;
 
-    QString applyNumberRewritingRules(const QString &originalNumber, const QVariantMap &properties);
+    const NumberRewriter &numberRewriter(const QString &accountId);
+    void abandonCallTrace(const QString &targetId, const QString &error);
 
 protected Q_SLOTS:
     void onContactsAvailable(Tp::PendingOperation *op);
     void onCallHangupFinished(Tp::PendingOperation *op);
     void onCallChannelInvalidated();
     void onCallStateChanged(Tp::CallState state);
+    void onAccountPropertiesChanged(const QString &accountId);
 
 private:
+    // DTMF sending behavior learned for each protocol, and the timing of the
+    // sequences sent through it
+    struct DTMFProtocolInfo {
+        DTMFProtocolInfo();
+        bool multipleTones;
+        int interDigitDelay;
+        int sequences;
+        int digits;
+        qint64 totalTime;
+        qint64 maxTime;
+    };
+
     explicit CallHandler(QObject *parent = 0);
 
     QMap<QString, Tp::ContactPtr> mContacts;
-    QList<Tp::CallChannelPtr> mCallChannels;
-    QMap<Tp::CallChannel*,CallAgent*> mCallAgents;
+    // indexed by the channel object path
+    QHash<QString, CallState> mCalls;
     QMap<Tp::PendingOperation*,Tp::CallChannelPtr> mClosingChannels;
     bool mHangupRequested;
+    QMap<QString, DTMFProtocolInfo> mDTMFProtocols;
+    QElapsedTimer mDTMFClock;
+    // compiled from the account properties when first needed
+    QHash<QString, NumberRewriter> mNumberRewriters;
+    // trace ids of the outgoing calls waiting for their channel, by target id
+    QHash<QString, QString> mPendingCallTraces;
 };
 
 #endif // CALLHANDLER_H
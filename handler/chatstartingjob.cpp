@@ -22,15 +22,18 @@
 
 #include "chatstartingjob.h"
 #include "chatstartingjobadaptor.h"
+#include "flowtracer.h"
 #include "telepathyhelper.h"
 #include "texthandler.h"
+#include "telephonylogging.h"
 #include <TelepathyQt/PendingChannelRequest>
 
 ChatStartingJob::ChatStartingJob(TextHandler *textHandler, const QString &accountId, const QVariantMap &properties)
 : MessageJob(textHandler), mTextHandler(textHandler), mAccountId(accountId), mProperties(properties)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerText) << __PRETTY_FUNCTION__;
     connect(this, &ChatStartingJob::textChannelChanged, &ChatStartingJob::channelObjectPathChanged);
+    setTraceId(properties[TRACE_ID_PROPERTY].toString());
 
     setAdaptorAndRegister(new ChatStartingJobAdaptor(this));
 }
@@ -42,16 +45,15 @@ QString ChatStartingJob::accountId()
 
 void ChatStartingJob::startJob()
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerText) << __PRETTY_FUNCTION__;
     setStatus(Running);
 
     // Request the contact to start chatting to
     // FIXME: make it possible to select which account to use, for now, pick the first one
     AccountEntry *account = TelepathyHelper::instance()->accountForId(mAccountId);
     if (!account || !account->connected()) {
-        qCritical() << "The selected account does not have a connection. AccountId:" << mAccountId;
-        setStatus(Failed);
-        scheduleDeletion();
+        qCCritical(lcHandlerText) << "The selected account does not have a connection. AccountId:" << mAccountId;
+        finishJob(Failed);
         return;
     }
 
@@ -64,18 +66,27 @@ void ChatStartingJob::startJob()
         startTextChatRoom(account->account(), mProperties);
         break;
     default:
-        qCritical() << "Chat type not supported";
+        qCCritical(lcHandlerText) << "Chat type not supported";
+        finishJob(Failed);
     }
 }
 
+void ChatStartingJob::cancel()
+{
+    if (mChannelRequest && !mChannelRequest->isFinished()) {
+        mChannelRequest->cancel();
+    }
+    MessageJob::cancel();
+}
+
 void ChatStartingJob::startTextChat(const Tp::AccountPtr &account, const QVariantMap &properties)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerText) << __PRETTY_FUNCTION__;
     Tp::PendingChannelRequest *op = NULL;
     QStringList participants = properties["participantIds"].toStringList();
     switch(participants.size()) {
     case 0:
-        qCritical() << "Error: No participant list provided";
+        qCCritical(lcHandlerText) << "Error: No participant list provided";
         break;
     case 1:
         op = account->ensureTextChat(participants[0], QDateTime::currentDateTime(), TP_QT_IFACE_CLIENT + ".TelephonyServiceHandler");
@@ -85,18 +96,17 @@ void ChatStartingJob::startTextChat(const Tp::AccountPtr &account, const QVarian
     }
 
     if (!op) {
-        setStatus(Failed);
-        scheduleDeletion();
+        finishJob(Failed);
         return;
     }
 
-    connect(op, &Tp::PendingOperation::finished,
-            this, &ChatStartingJob::onChannelRequestFinished);
+    mChannelRequest = op;
+    awaitOperation(op, &ChatStartingJob::onChannelRequestFinished);
 }
 
 void ChatStartingJob::startTextChatRoom(const Tp::AccountPtr &account, const QVariantMap &properties)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerText) << __PRETTY_FUNCTION__;
     QString roomName = properties["threadId"].toString();
 
     // these properties are still not used
@@ -126,17 +136,17 @@ void ChatStartingJob::startTextChatRoom(const Tp::AccountPtr &account, const QVa
     }
 
     if (!op) {
-        setStatus(Failed);
-        scheduleDeletion();
+        finishJob(Failed);
         return;
     }
-    connect(op, &Tp::PendingOperation::finished,
-            this, &ChatStartingJob::onChannelRequestFinished);
+
+    mChannelRequest = op;
+    awaitOperation(op, &ChatStartingJob::onChannelRequestFinished);
 }
 
 Tp::TextChannelPtr ChatStartingJob::textChannel() const
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerText) << __PRETTY_FUNCTION__;
     return mTextChannel;
 }
 
@@ -150,14 +160,14 @@ QString ChatStartingJob::channelObjectPath() const
 
 void ChatStartingJob::setTextChannel(Tp::TextChannelPtr channel)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerText) << __PRETTY_FUNCTION__;
     mTextChannel = channel;
     Q_EMIT textChannelChanged();
 }
 
 void ChatStartingJob::onChannelRequestFinished(Tp::PendingOperation *op)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerText) << __PRETTY_FUNCTION__;
     Status status;
     if (op->isError()) {
         status = Failed;
@@ -171,7 +181,6 @@ void ChatStartingJob::onChannelRequestFinished(Tp::PendingOperation *op)
         }
     }
 
-    setStatus(status);
-    scheduleDeletion();
+    finishJob(status);
 }
 
@@ -24,9 +24,10 @@
 #define CHATSTARTINGJOB_H
 
 #include <QObject>
+#include <QPointer>
 #include "messagejob.h"
 #include <TelepathyQt/Types>
-#include <TelepathyQt/PendingOperation>
+#include <TelepathyQt/PendingChannelRequest>
 
 class TextHandler;
 
@@ -45,6 +46,7 @@ public:
 
 public Q_SLOTS:
     virtual void startJob();
+    virtual void cancel();
 
 Q_SIGNALS:
     void textChannelChanged();
@@ -63,7 +65,7 @@ private:
     QString mAccountId;
     QVariantMap mProperties;
     Tp::TextChannelPtr mTextChannel;
-
+    QPointer<Tp::PendingChannelRequest> mChannelRequest;
 };
 
 #endif // CHATSTARTINGJOB_H
@@ -20,6 +20,7 @@
  */
 
 #include "farstreamchannel.h"
+#include "telephonylogging.h"
 #include <farstream/fs-utils.h>
 #include <QDebug>
 
@@ -28,7 +29,7 @@ FarstreamChannel::FarstreamChannel(TfChannel *channel, QObject *parent) :
     mConferenceAddedSignal(0), mConferenceRemovedSignal(0), mContentAddedSignal(0),
     mContentRemovedSignal(0), mAudioInput(0), mAudioOutput(0)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerCall) << __PRETTY_FUNCTION__;
     initialize();
 }
 
@@ -77,7 +78,7 @@ void FarstreamChannel::setMute(bool mute)
 
 void FarstreamChannel::initialize()
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerCall) << __PRETTY_FUNCTION__;
     // connect all the signals
     mConferenceAddedSignal = g_signal_connect(mChannel, "fs-conference-added",
                                               G_CALLBACK(&FarstreamChannel::onConferenceAdded),
@@ -95,13 +96,13 @@ void FarstreamChannel::initialize()
     // and initialize the gstreamer pipeline
     mPipeline = gst_pipeline_new(NULL);
     if (!mPipeline) {
-        qCritical() << "Failed to create GStreamer pipeline.";
+        qCCritical(lcHandlerCall) << "Failed to create GStreamer pipeline.";
         return;
     }
 
     mBus = gst_pipeline_get_bus(GST_PIPELINE(mPipeline));
     if (!mBus) {
-        qCritical() << "Failed to get GStreamer pipeline bus.";
+        qCCritical(lcHandlerCall) << "Failed to get GStreamer pipeline bus.";
         return;
     }
 
@@ -114,7 +115,7 @@ void FarstreamChannel::initialize()
 
 GstElement *FarstreamChannel::initializeAudioSource(TfContent *content)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerCall) << __PRETTY_FUNCTION__;
     GstElement *element = gst_parse_bin_from_description ("alsasrc ! audio/x-raw, rate=8000 ! queue"
                                                           " ! audioconvert ! audioresample"
                                                           " ! volume name=input_volume ! audioconvert ",
@@ -135,23 +136,23 @@ GstElement *FarstreamChannel::initializeAudioSource(TfContent *content)
 
 bool FarstreamChannel::addToPipeline(GstElement *element)
 {
-    qDebug() << __PRETTY_FUNCTION__ << GST_ELEMENT_NAME(element);
+    qCDebug(lcHandlerCall) << __PRETTY_FUNCTION__ << GST_ELEMENT_NAME(element);
     if (!mPipeline) {
-        qWarning() << "No gstreamer pipeline found.";
+        qCWarning(lcHandlerCall) << "No gstreamer pipeline found.";
         return false;
     }
 
     if (!gst_bin_add(GST_BIN(mPipeline), element)) {
-        qCritical() << "Failed to add bin" << GST_ELEMENT_NAME(element) << "to pipeline.";
+        qCCritical(lcHandlerCall) << "Failed to add bin" << GST_ELEMENT_NAME(element) << "to pipeline.";
         return false;
     }
-    qDebug() << "Succeeded adding to pipeline!";
+    qCDebug(lcHandlerCall) << "Succeeded adding to pipeline!";
     return true;
 }
 
 void FarstreamChannel::removeFromPipeline(GstElement *element)
 {
-    qDebug() << __PRETTY_FUNCTION__ << GST_ELEMENT_NAME(element);
+    qCDebug(lcHandlerCall) << __PRETTY_FUNCTION__ << GST_ELEMENT_NAME(element);
     gst_element_set_locked_state(element, TRUE);
     setState(element, GST_STATE_NULL);
     gst_bin_remove (GST_BIN (mPipeline), element);
@@ -159,13 +160,13 @@ void FarstreamChannel::removeFromPipeline(GstElement *element)
 
 bool FarstreamChannel::setState(GstElement *element, GstState state)
 {
-    qDebug() << __PRETTY_FUNCTION__ << GST_ELEMENT_NAME(element) << gst_element_state_get_name(state);
+    qCDebug(lcHandlerCall) << __PRETTY_FUNCTION__ << GST_ELEMENT_NAME(element) << gst_element_state_get_name(state);
     GstStateChangeReturn result = gst_element_set_state(element, state);
     if (result == GST_STATE_CHANGE_FAILURE) {
-        qCritical() << "Failed to set GStreamer element" << GST_ELEMENT_NAME(element) << "state to" << gst_element_state_get_name(state);
+        qCCritical(lcHandlerCall) << "Failed to set GStreamer element" << GST_ELEMENT_NAME(element) << "state to" << gst_element_state_get_name(state);
         return false;
     }
-    qDebug() << "Succeeded playing!";
+    qCDebug(lcHandlerCall) << "Succeeded playing!";
     return true;
 }
 
@@ -183,13 +184,13 @@ gboolean FarstreamChannel::onBusWatch(GstBus *bus, GstMessage *message, Farstrea
 
 void FarstreamChannel::onConferenceAdded(TfChannel *channel, FsConference *conference, FarstreamChannel *self)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerCall) << __PRETTY_FUNCTION__;
     Q_UNUSED(channel)
 
     /* Add notifier to set the various element properties as needed */
     GKeyFile *keyfile = fs_utils_get_default_element_properties (GST_ELEMENT(conference));
     if (keyfile != NULL) {
-        qDebug() << "Loaded default properties for" << GST_ELEMENT_NAME(conference);
+        qCDebug(lcHandlerCall) << "Loaded default properties for" << GST_ELEMENT_NAME(conference);
         FsElementAddedNotifier *notifier = fs_element_added_notifier_new();
         fs_element_added_notifier_set_properties_from_keyfile(notifier, keyfile);
         fs_element_added_notifier_add(notifier, GST_BIN(self->mPipeline));
@@ -207,7 +208,7 @@ void FarstreamChannel::onConferenceAdded(TfChannel *channel, FsConference *confe
 
 void FarstreamChannel::onConferenceRemoved(TfChannel *channel, FsConference *conference, FarstreamChannel *self)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerCall) << __PRETTY_FUNCTION__;
     Q_UNUSED(channel);
 
     // just remove the conference from the pipeline
@@ -216,7 +217,7 @@ void FarstreamChannel::onConferenceRemoved(TfChannel *channel, FsConference *con
 
 void FarstreamChannel::onContentAdded(TfChannel *channel, TfContent *content, FarstreamChannel *self)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerCall) << __PRETTY_FUNCTION__;
     Q_UNUSED(channel)
 
     g_signal_connect(content, "src-pad-added",
@@ -229,13 +230,13 @@ void FarstreamChannel::onContentAdded(TfChannel *channel, TfContent *content, Fa
 
 void FarstreamChannel::onContentRemoved(TfChannel *channel, TfContent *content, FarstreamChannel *self)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerCall) << __PRETTY_FUNCTION__;
     // FIXME: implement
 }
 
 bool FarstreamChannel::onStartSending(TfContent *content, FarstreamChannel *self)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerCall) << __PRETTY_FUNCTION__;
     GstPad *sinkPad;
     FsMediaType mediaType;
     GstElement *element;
@@ -248,7 +249,7 @@ bool FarstreamChannel::onStartSending(TfContent *content, FarstreamChannel *self
         break;
     // FIXME: add video support
     default:
-        qWarning() << "Unsupported media type:" << mediaType;
+        qCWarning(lcHandlerCall) << "Unsupported media type:" << mediaType;
         g_object_unref(sinkPad);
         return false;
     }
@@ -260,7 +261,7 @@ bool FarstreamChannel::onStartSending(TfContent *content, FarstreamChannel *self
 
     GstPad *sourcePad = gst_element_get_static_pad (element, "src");
     if (GST_PAD_LINK_FAILED (gst_pad_link (sourcePad, sinkPad))) {
-        qCritical() << "Failed to link source pad to content's sink pad";
+        qCCritical(lcHandlerCall) << "Failed to link source pad to content's sink pad";
         g_object_unref(sinkPad);
         g_object_unref(sourcePad);
         return false;
@@ -277,15 +278,15 @@ bool FarstreamChannel::onStartSending(TfContent *content, FarstreamChannel *self
 
 void FarstreamChannel::onStopSending(TfContent *content, FarstreamChannel *self)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerCall) << __PRETTY_FUNCTION__;
     // FIXME: implement
 }
 
 void FarstreamChannel::onSrcPadAdded(TfContent *content, uint handle, FsStream *stream, GstPad *pad, FsCodec *codec, FarstreamChannel *self)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerCall) << __PRETTY_FUNCTION__;
     gchar *codecString = fs_codec_to_string (codec);
-    qDebug() << __PRETTY_FUNCTION__ << "Codec:" << codecString;
+    qCDebug(lcHandlerCall) << __PRETTY_FUNCTION__ << "Codec:" << codecString;
 
     FsMediaType mediaType;
     GstElement *element;
@@ -307,7 +308,7 @@ void FarstreamChannel::onSrcPadAdded(TfContent *content, uint handle, FsStream *
     }
     // FIXME: handle video
     default:
-        qWarning() << "Unsupported media type:" << mediaType;
+        qCWarning(lcHandlerCall) << "Unsupported media type:" << mediaType;
         return;
     }
 
@@ -317,7 +318,7 @@ void FarstreamChannel::onSrcPadAdded(TfContent *content, uint handle, FsStream *
 
     GstPad *sinkPad = gst_element_get_static_pad (element, "sink");
     if (GST_PAD_LINK_FAILED (gst_pad_link (pad, sinkPad))) {
-        qCritical() << "Failed to link content's source pad to local sink pad";
+        qCCritical(lcHandlerCall) << "Failed to link content's source pad to local sink pad";
     }
 
     self->setState(element, GST_STATE_PLAYING);
@@ -24,6 +24,7 @@
 #include "accountentry.h"
 #include "protocolmanager.h"
 #include "telepathyhelper.h"
+#include "telephonylogging.h"
 
 #include <TelepathyQt/MethodInvocationContext>
 #include <TelepathyQt/CallChannel>
@@ -123,7 +124,7 @@ void Handler::onTextChannelReady(Tp::PendingOperation *op)
     Tp::PendingReady *pr = qobject_cast<Tp::PendingReady*>(op);
 
     if (!pr) {
-        qCritical() << "The pending object is not a Tp::PendingReady";
+        qCCritical(lcHandler) << "The pending object is not a Tp::PendingReady";
         return;
     }
 
@@ -131,7 +132,7 @@ void Handler::onTextChannelReady(Tp::PendingOperation *op)
     Tp::TextChannelPtr textChannel = Tp::TextChannelPtr::dynamicCast(channel);
 
     if(!textChannel) {
-        qCritical() << "The saved channel is not a Tp::TextChannel";
+        qCCritical(lcHandler) << "The saved channel is not a Tp::TextChannel";
         return;
     }
 
@@ -149,7 +150,7 @@ void Handler::onCallChannelReady(Tp::PendingOperation *op)
     Tp::PendingReady *pr = qobject_cast<Tp::PendingReady*>(op);
 
     if (!pr) {
-        qCritical() << "The pending object is not a Tp::PendingReady";
+        qCCritical(lcHandler) << "The pending object is not a Tp::PendingReady";
         return;
     }
 
@@ -161,7 +162,7 @@ void Handler::onCallChannelReady(Tp::PendingOperation *op)
         if (context) {
             context->setFinishedWithError(TP_QT_ERROR_CONFUSED, "Channel was not a call channel");
         }
-        qCritical() << "The saved channel is not a Tp::CallChannel";
+        qCCritical(lcHandler) << "The saved channel is not a Tp::CallChannel";
         return;
     }
 
@@ -176,7 +177,7 @@ void Handler::onCallChannelReady(Tp::PendingOperation *op)
         incoming = true;
     }
     if (incoming && callChannel->callState() != Tp::CallStateAccepted && callChannel->callState() != Tp::CallStateActive) {
-        qWarning() << "Available channel was not approved by telephony-service-approver, ignoring it.";
+        qCWarning(lcHandler) << "Available channel was not approved by telephony-service-approver, ignoring it.";
         if (context) {
             context->setFinishedWithError(TP_QT_ERROR_NOT_CAPABLE, "Only channels approved and accepted by telephony-service-approver are supported");
         }
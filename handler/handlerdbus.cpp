@@ -27,41 +27,101 @@
 #include "callhandler.h"
 #include "handlerdbus.h"
 #include "handleradaptor.h"
+#include "handlerstats.h"
+#include "handlerstatsadaptor.h"
+#include "telephonylogging.h"
 #include "texthandler.h"
 #include "telepathyhelper.h"
 #include "protocolmanager.h"
 #include <config.h>
 
 // Qt
+#include <QtDBus/QDBusArgument>
 #include <QtDBus/QDBusConnection>
+#include <QtDBus/QDBusMessage>
 
 static const char* DBUS_SERVICE = "com.canonical.TelephonyServiceHandler";
 static const char* DBUS_OBJECT_PATH = "/com/canonical/TelephonyServiceHandler";
 
-HandlerDBus::HandlerDBus(QObject* parent) : QObject(parent), mCallIndicatorVisible(false)
+// bump it whenever keys are removed or change meaning in GetSnapshot()
+#define SNAPSHOT_VERSION 1
+
+// nested values (like the number rewriting rules) arrive as QDBusArgument,
+// which can be neither used nor saved as is
+static QVariant fromDBusValue(const QVariant &value)
+{
+    if (value.userType() == qMetaTypeId<QDBusVariant>()) {
+        return fromDBusValue(value.value<QDBusVariant>().variant());
+    }
+    if (value.userType() != qMetaTypeId<QDBusArgument>()) {
+        return value;
+    }
+
+    const QDBusArgument argument = value.value<QDBusArgument>();
+    switch (argument.currentType()) {
+    case QDBusArgument::MapType: {
+        QVariantMap map;
+        argument.beginMap();
+        while (!argument.atEnd()) {
+            QString key;
+            argument.beginMapEntry();
+            argument >> key;
+            map[key] = fromDBusValue(argument.asVariant());
+            argument.endMapEntry();
+        }
+        argument.endMap();
+        return map;
+    }
+    case QDBusArgument::ArrayType: {
+        QVariantList list;
+        argument.beginArray();
+        while (!argument.atEnd()) {
+            list << fromDBusValue(argument.asVariant());
+        }
+        argument.endArray();
+        return list;
+    }
+    default:
+        return value;
+    }
+}
+
+HandlerDBus::HandlerDBus(QObject* parent) : QObject(parent), mCallIndicatorVisible(false), mSequence(0)
 {
     qDBusRegisterMetaType<ProtocolList>();
     qDBusRegisterMetaType<ProtocolStruct>();
 
     connect(CallHandler::instance(),
-            SIGNAL(callPropertiesChanged(QString,QVariantMap)),
-            SIGNAL(CallPropertiesChanged(QString,QVariantMap)));
+            &CallHandler::callPropertiesChanged, [this](const QString &objectPath, const QVariantMap &properties) {
+                Q_EMIT CallPropertiesChanged(objectPath, properties, nextSequence());
+            });
     connect(CallHandler::instance(),
             SIGNAL(callHoldingFailed(QString)),
             SIGNAL(CallHoldingFailed(QString)));
     connect(CallHandler::instance(),
             SIGNAL(conferenceCallRequestFinished(bool)),
             SIGNAL(ConferenceCallRequestFinished(bool)));
+    connect(AccountProperties::instance(),
+            &AccountProperties::accountPropertiesChanged, [this](const QString &accountId, const QVariantMap &properties) {
+                Q_EMIT AccountPropertiesChanged(accountId, properties, nextSequence());
+            });
+    connect(TelepathyHelper::instance(),
+            &TelepathyHelper::accountIdsChanged, [this]() {
+                Q_EMIT AccountIdsChanged(TelepathyHelper::instance()->accountIds(), nextSequence());
+            });
     connect(ProtocolManager::instance(),
             &ProtocolManager::protocolsChanged, [this]() {
-                Q_EMIT ProtocolsChanged(ProtocolManager::instance()->protocols().dbusType());
+                Q_EMIT ProtocolsChanged(ProtocolManager::instance()->protocols().dbusType(), nextSequence());
             });
     connect(AudioRouteManager::instance(),
-            SIGNAL(audioOutputsChanged(AudioOutputDBusList)),
-            SIGNAL(AudioOutputsChanged(AudioOutputDBusList)));
+            &AudioRouteManager::audioOutputsChanged, [this](const AudioOutputDBusList &audioOutputs) {
+                Q_EMIT AudioOutputsChanged(audioOutputs, nextSequence());
+            });
     connect(AudioRouteManager::instance(),
-            SIGNAL(activeAudioOutputChanged(QString)),
-            SIGNAL(ActiveAudioOutputChanged(QString)));
+            &AudioRouteManager::activeAudioOutputChanged, [this](const QString &id) {
+                Q_EMIT ActiveAudioOutputChanged(id, nextSequence());
+                notifyPropertyChanged("ActiveAudioOutput", id);
+            });
 }
 
 HandlerDBus::~HandlerDBus()
@@ -70,24 +130,58 @@ HandlerDBus::~HandlerDBus()
 
 QVariantMap HandlerDBus::GetCallProperties(const QString &objectPath)
 {
+    HandlerStats::Scope stats(__func__, this);
     return CallHandler::instance()->getCallProperties(objectPath);
 }
 
 bool HandlerDBus::HasCalls()
 {
+    HandlerStats::Scope stats(__func__, this);
     return CallHandler::instance()->hasCalls();
 }
 
 QStringList HandlerDBus::AccountIds()
 {
+    HandlerStats::Scope stats(__func__, this);
     return TelepathyHelper::instance()->accountIds();
 }
 
 bool HandlerDBus::IsReady()
 {
+    HandlerStats::Scope stats(__func__, this);
     return TelepathyHelper::instance()->ready();
 }
 
+QVariantMap HandlerDBus::GetSnapshot()
+{
+    HandlerStats::Scope stats(__func__, this);
+    // everything a client needs to start, so that it can be fetched in a
+    // single round trip instead of one call per piece of state
+    QVariantMap accountProperties;
+    AllAccountsProperties allProperties = AccountProperties::instance()->allProperties();
+    AllAccountsProperties::const_iterator it = allProperties.constBegin();
+    for (; it != allProperties.constEnd(); ++it) {
+        accountProperties[it.key()] = it.value();
+    }
+
+    QVariantMap properties;
+    properties["CallIndicatorVisible"] = callIndicatorVisible();
+    properties["ActiveAudioOutput"] = activeAudioOutput();
+
+    QVariantMap snapshot;
+    snapshot["version"] = SNAPSHOT_VERSION;
+    snapshot["sequence"] = mSequence;
+    snapshot["ready"] = IsReady();
+    snapshot["accountIds"] = AccountIds();
+    snapshot["accountProperties"] = accountProperties;
+    snapshot["protocols"] = QVariant::fromValue(GetProtocols());
+    snapshot["hasCalls"] = HasCalls();
+    snapshot["calls"] = CallHandler::instance()->allCallProperties();
+    snapshot["properties"] = properties;
+    snapshot["audioOutputs"] = QVariant::fromValue(AudioOutputs());
+    return snapshot;
+}
+
 bool HandlerDBus::callIndicatorVisible() const
 {
     return mCallIndicatorVisible;
@@ -95,28 +189,68 @@ bool HandlerDBus::callIndicatorVisible() const
 
 void HandlerDBus::setCallIndicatorVisible(bool visible)
 {
+    if (visible == mCallIndicatorVisible) {
+        return;
+    }
     mCallIndicatorVisible = visible;
-    Q_EMIT CallIndicatorVisibleChanged(visible);
+    Q_EMIT CallIndicatorVisibleChanged(visible, nextSequence());
+    notifyPropertyChanged("CallIndicatorVisible", visible);
+}
+
+void HandlerDBus::notifyPropertyChanged(const QString &name, const QVariant &value)
+{
+    // clients keep a mirror of the properties, so let them know through the
+    // standard signal as well
+    QDBusMessage signal = QDBusMessage::createSignal(DBUS_OBJECT_PATH,
+                                                     "org.freedesktop.DBus.Properties",
+                                                     "PropertiesChanged");
+    QVariantMap changed;
+    changed[name] = value;
+    signal << QString("com.canonical.TelephonyServiceHandler") << changed << QStringList();
+    QDBusConnection::sessionBus().send(signal);
+}
+
+qulonglong HandlerDBus::nextSequence()
+{
+    // the snapshot reports the last change it includes, so any change signal
+    // with a sequence up to that one is already reflected in it
+    return ++mSequence;
 }
 
 ProtocolList HandlerDBus::GetProtocols()
 {
+    HandlerStats::Scope stats(__func__, this);
     return ProtocolManager::instance()->protocols().dbusType();
 }
 
 AllAccountsProperties HandlerDBus::GetAllAccountsProperties()
 {
+    HandlerStats::Scope stats(__func__, this);
     return AccountProperties::instance()->allProperties();
 }
 
 QVariantMap HandlerDBus::GetAccountProperties(const QString &accountId)
 {
+    HandlerStats::Scope stats(__func__, this);
     return AccountProperties::instance()->accountProperties(accountId);
 }
 
 void HandlerDBus::SetAccountProperties(const QString &accountId, const QVariantMap &properties)
 {
-    AccountProperties::instance()->setAccountProperties(accountId, properties);
+    HandlerStats::Scope stats(__func__, this);
+    QVariantMap props;
+    QMapIterator<QString, QVariant> it(properties);
+    while (it.hasNext()) {
+        it.next();
+        props[it.key()] = fromDBusValue(it.value());
+    }
+    AccountProperties::instance()->setAccountProperties(accountId, props);
+}
+
+void HandlerDBus::SetLoggingRules(const QString &rules)
+{
+    HandlerStats::Scope stats(__func__, this);
+    setTelephonyLoggingRules(rules);
 }
 
 QString HandlerDBus::registerObject(QObject *object, const QString &path)
@@ -141,31 +275,37 @@ HandlerDBus *HandlerDBus::instance()
 
 void HandlerDBus::InviteParticipants(const QString &objectPath, const QStringList &participants, const QString &message)
 {
+    HandlerStats::Scope stats(__func__, this);
     TextHandler::instance()->inviteParticipants(objectPath, participants, message);
 }
 
 void HandlerDBus::RemoveParticipants(const QString &objectPath, const QStringList &participants, const QString &message)
 {
+    HandlerStats::Scope stats(__func__, this);
     TextHandler::instance()->removeParticipants(objectPath, participants, message);
 }
 
 void HandlerDBus::LeaveRooms(const QString &accountId, const QString &message)
 {
+    HandlerStats::Scope stats(__func__, this);
     return TextHandler::instance()->leaveRooms(accountId, message);
 }
 
 bool HandlerDBus::LeaveChat(const QString &objectPath, const QString &message)
 {
+    HandlerStats::Scope stats(__func__, this);
     return TextHandler::instance()->leaveChat(objectPath, message);
 }
 
 bool HandlerDBus::DestroyTextChannel(const QString &objectPath)
 {
+    HandlerStats::Scope stats(__func__, this);
     return TextHandler::instance()->destroyTextChannel(objectPath);
 }
 
 bool HandlerDBus::ChangeRoomTitle(const QString &objectPath, const QString &title)
 {
+    HandlerStats::Scope stats(__func__, this);
     return TextHandler::instance()->changeRoomTitle(objectPath, title);
 }
 
@@ -181,72 +321,107 @@ QString HandlerDBus::activeAudioOutput() const
 
 AudioOutputDBusList HandlerDBus::AudioOutputs() const
 {
+    HandlerStats::Scope stats(__func__, this);
     return AudioRouteManager::instance()->audioOutputs();
 }
 
+QVariantMap HandlerDBus::GetStats() const
+{
+    return HandlerStats::instance()->stats();
+}
+
+void HandlerDBus::ResetStats()
+{
+    HandlerStats::instance()->reset();
+}
+
+bool HandlerDBus::statsEnabled() const
+{
+    return HandlerStats::instance()->isEnabled();
+}
+
+void HandlerDBus::setStatsEnabled(bool enabled)
+{
+    HandlerStats::instance()->setEnabled(enabled);
+}
+
 bool HandlerDBus::connectToBus()
 {
     new TelephonyServiceHandlerAdaptor(this);
+    new StatsAdaptor(this);
+    HandlerStats::instance()->watchSignals(this);
     QDBusConnection::sessionBus().registerObject(DBUS_OBJECT_PATH, this);
     return QDBusConnection::sessionBus().registerService(DBUS_SERVICE);
 }
 
 QString HandlerDBus::SendMessage(const QString &accountId, const QString &message, const AttachmentList &attachments, const QVariantMap &properties)
 {
+    HandlerStats::Scope stats(__func__, this);
     return TextHandler::instance()->sendMessage(accountId, message, attachments, properties);
 }
 
 void HandlerDBus::AcknowledgeMessages(const QVariantList &messages)
 {
+    HandlerStats::Scope stats(__func__, this);
     TextHandler::instance()->acknowledgeMessages(messages);
 }
 
 QString HandlerDBus::StartChat(const QString &accountId, const QVariantMap &properties)
 {
+    HandlerStats::Scope stats(__func__, this);
     return TextHandler::instance()->startChat(accountId, properties);
 }
 
 void HandlerDBus::AcknowledgeAllMessages(const QVariantMap &properties)
 {
+    HandlerStats::Scope stats(__func__, this);
     TextHandler::instance()->acknowledgeAllMessages(properties);
 }
 
 void HandlerDBus::StartCall(const QString &number, const QString &accountId)
 {
+    HandlerStats::Scope stats(__func__, this);
     CallHandler::instance()->startCall(number, accountId);
 }
 
 void HandlerDBus::HangUpCall(const QString &objectPath)
 {
+    HandlerStats::Scope stats(__func__, this);
     CallHandler::instance()->hangUpCall(objectPath);
 }
 
 void HandlerDBus::SetHold(const QString &objectPath, bool hold)
 {
+    HandlerStats::Scope stats(__func__, this);
     CallHandler::instance()->setHold(objectPath, hold);
 }
 
 void HandlerDBus::SetMuted(const QString &objectPath, bool muted)
 {
+    HandlerStats::Scope stats(__func__, this);
     CallHandler::instance()->setMuted(objectPath, muted);
 }
 
 void HandlerDBus::SendDTMF(const QString &objectPath, const QString &key)
 {
+    HandlerStats::Scope stats(__func__, this);
     CallHandler::instance()->sendDTMF(objectPath, key);
 }
 
 void HandlerDBus::CreateConferenceCall(const QStringList &objectPaths)
 {
+    HandlerStats::Scope stats(__func__, this);
     CallHandler::instance()->createConferenceCall(objectPaths);
 }
 
 void HandlerDBus::MergeCall(const QString &conferenceObjectPath, const QString &callObjectPath)
 {
+    HandlerStats::Scope stats(__func__, this);
     CallHandler::instance()->mergeCall(conferenceObjectPath, callObjectPath);
 }
 
 void HandlerDBus::SplitCall(const QString &objectPath)
 {
+    HandlerStats::Scope stats(__func__, this);
     CallHandler::instance()->splitCall(objectPath);
 }
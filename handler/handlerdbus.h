@@ -48,6 +48,10 @@ class HandlerDBus : public QObject, protected QDBusContext
                WRITE setActiveAudioOutput
                NOTIFY ActiveAudioOutputChanged)
 
+    Q_PROPERTY(bool StatsEnabled
+               READ statsEnabled
+               WRITE setStatsEnabled)
+
 public:
     HandlerDBus(QObject* parent=0);
     ~HandlerDBus();
@@ -56,6 +60,7 @@ public:
     bool HasCalls();
     QStringList AccountIds();
     bool IsReady();
+    QVariantMap GetSnapshot();
     bool callIndicatorVisible() const;
     void setCallIndicatorVisible(bool visible);
     // configuration related
@@ -63,6 +68,7 @@ public:
     AllAccountsProperties GetAllAccountsProperties();
     QVariantMap GetAccountProperties(const QString &accountId);
     void SetAccountProperties(const QString &accountId, const QVariantMap &properties);
+    void SetLoggingRules(const QString &rules);
 
     QString registerObject(QObject *object, const QString &path);
     void unregisterObject(const QString &path);
@@ -71,6 +77,12 @@ public:
     QString activeAudioOutput() const;
     void setActiveAudioOutput(const QString &id);
 
+    // stats related
+    QVariantMap GetStats() const;
+    void ResetStats();
+    bool statsEnabled() const;
+    void setStatsEnabled(bool enabled);
+
 public Q_SLOTS:
     bool connectToBus();
 
@@ -103,17 +115,24 @@ public Q_SLOTS:
 
 Q_SIGNALS:
     void onMessageSent(const QString &number, const QString &message);
-    void CallPropertiesChanged(const QString &objectPath, const QVariantMap &properties);
-    void AccountPropertiesChanged(const QString &accountId, const QVariantMap &properties);
-    void CallIndicatorVisibleChanged(bool visible);
+    // the state change signals carry the sequence number of the change, so
+    // that clients can drop the ones already included in their snapshot
+    void CallPropertiesChanged(const QString &objectPath, const QVariantMap &properties, qulonglong sequence);
+    void AccountPropertiesChanged(const QString &accountId, const QVariantMap &properties, qulonglong sequence);
+    void AccountIdsChanged(const QStringList &accountIds, qulonglong sequence);
+    void CallIndicatorVisibleChanged(bool visible, qulonglong sequence);
     void ConferenceCallRequestFinished(bool succeeded);
     void CallHoldingFailed(const QString &objectPath);
-    void ProtocolsChanged(const ProtocolList &protocols);
-    void ActiveAudioOutputChanged(const QString &id);
-    void AudioOutputsChanged(const AudioOutputDBusList &audioOutputs);
+    void ProtocolsChanged(const ProtocolList &protocols, qulonglong sequence);
+    void ActiveAudioOutputChanged(const QString &id, qulonglong sequence);
+    void AudioOutputsChanged(const AudioOutputDBusList &audioOutputs, qulonglong sequence);
 
 private:
+    void notifyPropertyChanged(const QString &name, const QVariant &value);
+    qulonglong nextSequence();
+
     bool mCallIndicatorVisible;
+    qulonglong mSequence;
 };
 
 #endif // HANDLERDBUS_H
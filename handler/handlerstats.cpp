@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "handlerstats.h"
+#include <QDBusArgument>
+#include <QDBusContext>
+#include <QDBusMessage>
+#include <QDBusObjectPath>
+#include <QDBusVariant>
+#include <QSequentialIterable>
+
+// upper limits of the latency buckets in microseconds, the last bucket
+// takes everything above
+static const qint64 BUCKET_LIMITS[] = { 50, 100, 250, 500, 1000, 2500, 5000, 10000, 50000, 100000 };
+
+static qint64 argumentSize(const QDBusArgument &argument)
+{
+    qint64 size = 0;
+    switch (argument.currentType()) {
+    case QDBusArgument::BasicType:
+    case QDBusArgument::VariantType:
+        return HandlerStats::payloadSize(argument.asVariant());
+    case QDBusArgument::ArrayType:
+        argument.beginArray();
+        while (!argument.atEnd()) {
+            size += argumentSize(argument);
+        }
+        argument.endArray();
+        return size + 4;
+    case QDBusArgument::MapType:
+        argument.beginMap();
+        while (!argument.atEnd()) {
+            argument.beginMapEntry();
+            size += argumentSize(argument);
+            size += argumentSize(argument);
+            argument.endMapEntry();
+        }
+        argument.endMap();
+        return size + 4;
+    case QDBusArgument::StructureType:
+        argument.beginStructure();
+        while (!argument.atEnd()) {
+            size += argumentSize(argument);
+        }
+        argument.endStructure();
+        return size;
+    default:
+        return 0;
+    }
+}
+
+HandlerStats::Scope::Scope(const char *method, const QDBusContext *context)
+: mMethod(method), mCounted(false), mActive(false), mPayloadSize(0)
+{
+    HandlerStats *stats = HandlerStats::instance();
+    if (!stats->mEnabled) {
+        return;
+    }
+
+    // methods calling each other (like GetSnapshot) are recorded only once
+    mCounted = true;
+    if (stats->mScopeDepth++ > 0 || !context->calledFromDBus()) {
+        return;
+    }
+
+    mActive = true;
+    Q_FOREACH(const QVariant &argument, context->message().arguments()) {
+        mPayloadSize += payloadSize(argument);
+    }
+    mTimer.start();
+}
+
+HandlerStats::Scope::~Scope()
+{
+    HandlerStats *stats = HandlerStats::instance();
+    if (mCounted) {
+        stats->mScopeDepth--;
+    }
+    if (mActive) {
+        stats->recordCall(mMethod, mTimer.nsecsElapsed() / 1000, mPayloadSize);
+    }
+}
+
+HandlerStats::Entry::Entry()
+: count(0), totalPayload(0), maxPayload(0)
+{
+    QVector<qint64> limits;
+    for (uint i = 0; i < sizeof(BUCKET_LIMITS) / sizeof(BUCKET_LIMITS[0]); i++) {
+        limits << BUCKET_LIMITS[i];
+    }
+    latency = Histogram(limits);
+}
+
+HandlerStats *HandlerStats::instance()
+{
+    static HandlerStats *self = new HandlerStats();
+    return self;
+}
+
+HandlerStats::HandlerStats()
+: mEnabled(!qgetenv("TELEPHONY_SERVICE_HANDLER_STATS").isEmpty()), mScopeDepth(0)
+{
+}
+
+bool HandlerStats::isEnabled() const
+{
+    return mEnabled;
+}
+
+void HandlerStats::setEnabled(bool enabled)
+{
+    mEnabled = enabled;
+}
+
+void HandlerStats::watchSignals(QObject *object)
+{
+    new SignalStatsRecorder(object);
+}
+
+void HandlerStats::recordCall(const QString &method, qint64 latency, qint64 payloadSize)
+{
+    Entry &entry = mMethods[method];
+    entry.count++;
+    entry.latency.add(latency);
+    entry.totalPayload += payloadSize;
+    entry.maxPayload = qMax(entry.maxPayload, payloadSize);
+}
+
+void HandlerStats::recordSignal(const QString &signal, qint64 payloadSize)
+{
+    Entry &entry = mSignals[signal];
+    entry.count++;
+    entry.totalPayload += payloadSize;
+    entry.maxPayload = qMax(entry.maxPayload, payloadSize);
+}
+
+QVariantMap HandlerStats::stats() const
+{
+    QVariantMap methods;
+    QHash<QString, Entry>::const_iterator it = mMethods.constBegin();
+    for (; it != mMethods.constEnd(); ++it) {
+        QVariantMap method;
+        method["calls"] = it.value().count;
+        method["latency"] = it.value().latency.toMap();
+        method["payload"] = payloadMap(it.value());
+        methods[it.key()] = method;
+    }
+
+    QVariantMap signalStats;
+    for (it = mSignals.constBegin(); it != mSignals.constEnd(); ++it) {
+        QVariantMap signal;
+        signal["emitted"] = it.value().count;
+        signal["payload"] = payloadMap(it.value());
+        signalStats[it.key()] = signal;
+    }
+
+    QVariantMap stats;
+    stats["enabled"] = mEnabled;
+    stats["methods"] = methods;
+    stats["signals"] = signalStats;
+    return stats;
+}
+
+void HandlerStats::reset()
+{
+    mMethods.clear();
+    mSignals.clear();
+}
+
+qint64 HandlerStats::payloadSize(const QVariant &value)
+{
+    int type = value.userType();
+    switch (type) {
+    case QMetaType::UnknownType:
+        return 0;
+    case QMetaType::Bool:
+    case QMetaType::Int:
+    case QMetaType::UInt:
+        return 4;
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+    case QMetaType::Double:
+        return 8;
+    case QMetaType::QString:
+        return value.toString().size() + 5;
+    case QMetaType::QByteArray:
+        return value.toByteArray().size() + 4;
+    default:
+        break;
+    }
+
+    if (type == qMetaTypeId<QDBusArgument>()) {
+        return argumentSize(value.value<QDBusArgument>());
+    }
+    if (type == qMetaTypeId<QDBusVariant>()) {
+        return payloadSize(value.value<QDBusVariant>().variant()) + 3;
+    }
+    if (type == qMetaTypeId<QDBusObjectPath>()) {
+        return value.value<QDBusObjectPath>().path().size() + 5;
+    }
+
+    qint64 size = 0;
+    if (type == QMetaType::QVariantMap) {
+        QVariantMap map = value.toMap();
+        QVariantMap::const_iterator it = map.constBegin();
+        for (; it != map.constEnd(); ++it) {
+            size += it.key().size() + 5 + payloadSize(it.value());
+        }
+        return size + 4;
+    }
+    if (value.canConvert<QVariantList>()) {
+        // covers QStringList and the lists of custom types as well
+        QSequentialIterable iterable = value.value<QSequentialIterable>();
+        Q_FOREACH(const QVariant &item, iterable) {
+            size += payloadSize(item);
+        }
+        return size + 4;
+    }
+
+    // a custom structure with no way to look inside
+    return QMetaType::sizeOf(type);
+}
+
+QVariantMap HandlerStats::payloadMap(const Entry &entry)
+{
+    QVariantMap payload;
+    payload["total"] = entry.totalPayload;
+    payload["max"] = entry.maxPayload;
+    return payload;
+}
+
+SignalStatsRecorder::SignalStatsRecorder(QObject *object)
+: QObject(object)
+{
+    const QMetaObject *metaObject = object->metaObject();
+    for (int i = metaObject->methodOffset(); i < metaObject->methodCount(); i++) {
+        QMetaMethod method = metaObject->method(i);
+        if (method.methodType() != QMetaMethod::Signal) {
+            continue;
+        }
+        // our own "slots" start right after the ones of QObject
+        QMetaObject::connect(object, i, this, QObject::staticMetaObject.methodCount() + mSignals.count(),
+                             Qt::DirectConnection);
+        mSignals << method;
+    }
+}
+
+int SignalStatsRecorder::qt_metacall(QMetaObject::Call call, int id, void **arguments)
+{
+    id = QObject::qt_metacall(call, id, arguments);
+    if (id < 0 || call != QMetaObject::InvokeMetaMethod) {
+        return id;
+    }
+
+    if (id < mSignals.count() && HandlerStats::instance()->isEnabled()) {
+        const QMetaMethod &method = mSignals[id];
+        qint64 size = 0;
+        for (int i = 0; i < method.parameterCount(); i++) {
+            size += HandlerStats::payloadSize(QVariant(method.parameterType(i), arguments[i + 1]));
+        }
+        HandlerStats::instance()->recordSignal(QString::fromLatin1(method.name()), size);
+    }
+    return id - mSignals.count();
+}
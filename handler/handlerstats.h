@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HANDLERSTATS_H
+#define HANDLERSTATS_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMetaMethod>
+#include <QObject>
+#include <QVariantMap>
+#include "histogram.h"
+
+class QDBusContext;
+
+/* Call counts, latencies and payload sizes of the handler dbus methods and
+ * signals. Nothing is recorded until stats are enabled (through the Stats
+ * dbus interface or the TELEPHONY_SERVICE_HANDLER_STATS environment
+ * variable), so the cost for everybody else is a single check per call.
+ * Payload sizes are an estimate of the marshalled size of the arguments. */
+class HandlerStats
+{
+public:
+    // records the method call it is created in, if it comes from dbus
+    class Scope
+    {
+    public:
+        Scope(const char *method, const QDBusContext *context);
+        ~Scope();
+
+    private:
+        const char *mMethod;
+        bool mCounted;
+        bool mActive;
+        qint64 mPayloadSize;
+        QElapsedTimer mTimer;
+    };
+
+    static HandlerStats *instance();
+
+    bool isEnabled() const;
+    void setEnabled(bool enabled);
+    // starts recording the signals emitted by the given object
+    void watchSignals(QObject *object);
+
+    void recordCall(const QString &method, qint64 latency, qint64 payloadSize);
+    void recordSignal(const QString &signal, qint64 payloadSize);
+    // enabled, methods (name -> calls, latency and payload) and
+    // signals (name -> emitted and payload)
+    QVariantMap stats() const;
+    void reset();
+
+    static qint64 payloadSize(const QVariant &value);
+
+private:
+    struct Entry {
+        Entry();
+        uint count;
+        Histogram latency;
+        qint64 totalPayload;
+        qint64 maxPayload;
+    };
+
+    HandlerStats();
+    static QVariantMap payloadMap(const Entry &entry);
+
+    bool mEnabled;
+    int mScopeDepth;
+    QHash<QString, Entry> mMethods;
+    QHash<QString, Entry> mSignals;
+};
+
+/* Relays the signals of an object to HandlerStats. It is a plain QObject
+ * with a hand written qt_metacall (like QSignalSpy) so that a single
+ * receiver can take any signal together with its arguments. */
+class SignalStatsRecorder : public QObject
+{
+public:
+    explicit SignalStatsRecorder(QObject *object);
+    int qt_metacall(QMetaObject::Call call, int id, void **arguments) override;
+
+private:
+    QList<QMetaMethod> mSignals;
+};
+
+#endif // HANDLERSTATS_H
@@ -25,6 +25,7 @@
 #include "handlerdbus.h"
 #include "telepathyhelper.h"
 #include "texthandler.h"
+#include "telephonylogging.h"
 #include <QCoreApplication>
 #include <TelepathyQt/ClientRegistrar>
 #include <TelepathyQt/AbstractClient>
@@ -51,7 +52,7 @@ int main(int argc, char **argv)
 
     // check if there is already an instance of the handler running
     if (ApplicationUtils::checkApplicationRunning(TP_QT_IFACE_CLIENT + ".TelephonyServiceHandler")) {
-        qDebug() << "Found another instance of the handler. Quitting.";
+        qCInfo(lcHandler) << "Found another instance of the handler. Quitting.";
         return 1;
     }
 
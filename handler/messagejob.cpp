@@ -21,15 +21,17 @@
  */
 
 #include "messagejob.h"
+#include "flowtracer.h"
 #include "handlerdbus.h"
-#include <QCoreApplication>
-#include <QTime>
+#include "telephonylogging.h"
 #include <QTimer>
 #include <QDebug>
 
 MessageJob::MessageJob(QObject *parent)
 : QObject(parent), mStatus(Pending), mFinished(false), mAdaptor(0)
 {
+    mStepTimer.setSingleShot(true);
+    connect(&mStepTimer, &QTimer::timeout, this, &MessageJob::onStepTimeout);
 }
 
 MessageJob::~MessageJob()
@@ -64,13 +66,14 @@ QString MessageJob::objectPath() const
     return mObjectPath;
 }
 
-void MessageJob::waitForFinished(int timeout)
+QString MessageJob::traceId() const
 {
-    QTime time;
-    time.start();
-    while (!mFinished && time.elapsed() < timeout) {
-        QCoreApplication::processEvents();
-    }
+    return mTraceId;
+}
+
+void MessageJob::setTraceId(const QString &traceId)
+{
+    mTraceId = traceId;
 }
 
 void MessageJob::startJob()
@@ -79,8 +82,24 @@ void MessageJob::startJob()
     setStatus(Finished);
 }
 
+void MessageJob::cancel()
+{
+    if (mFinished) {
+        return;
+    }
+    qCWarning(lcHandlerText) << "Cancelling job" << mObjectPath;
+    finishJob(Failed);
+}
+
+void MessageJob::onStepTimeout()
+{
+    qCWarning(lcHandlerText) << "Job" << mObjectPath << "timed out";
+    cancel();
+}
+
 void MessageJob::setStatus(MessageJob::Status status)
 {
+    traceStatus(status);
     mStatus = status;
     Q_EMIT statusChanged();
 
@@ -95,8 +114,49 @@ void MessageJob::setStatus(MessageJob::Status status)
     }
 }
 
+void MessageJob::traceStatus(MessageJob::Status status)
+{
+    // there is only a trace id while tracing
+    if (mTraceId.isEmpty()) {
+        return;
+    }
+
+    const char *name = metaObject()->className();
+    if (status == Running && mStatus != Running) {
+        FlowTracer::instance()->begin(mTraceId, name);
+    } else if ((status == Finished || status == Failed) && mStatus == Running) {
+        QVariantMap args;
+        args["status"] = status == Finished ? "finished" : "failed";
+        FlowTracer::instance()->end(mTraceId, name, args);
+    }
+}
+
 void MessageJob::scheduleDeletion(int timeout)
 {
     QTimer::singleShot(timeout, this, &QObject::deleteLater);
 }
 
+void MessageJob::startStepTimeout(int timeout)
+{
+    if (timeout < 0) {
+        mStepTimer.stop();
+        return;
+    }
+    mStepTimer.start(timeout);
+}
+
+void MessageJob::finishStep()
+{
+    mStepTimer.stop();
+    Q_FOREACH(const QMetaObject::Connection &connection, mAwaitConnections) {
+        QObject::disconnect(connection);
+    }
+    mAwaitConnections.clear();
+}
+
+void MessageJob::finishJob(MessageJob::Status status)
+{
+    finishStep();
+    setStatus(status);
+    scheduleDeletion();
+}
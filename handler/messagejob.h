@@ -26,6 +26,9 @@
 #include <QObject>
 #include <QDBusAbstractAdaptor>
 #include <QDBusContext>
+#include <QSharedPointer>
+#include <QTimer>
+#include <TelepathyQt/PendingOperation>
 
 class MessageJob : public QObject, protected QDBusContext
 {
@@ -53,7 +56,16 @@ public:
 
     QString objectPath() const;
 
-    void waitForFinished(int timeout = 10000);
+    // the flow the job is part of, see FlowTracer
+    QString traceId() const;
+    void setTraceId(const QString &traceId);
+
+    // calls the given functor exactly once, as soon as the job reaches the
+    // Finished or Failed state, without blocking the caller. If the job is
+    // already finished, the call is queued to the context object's thread.
+    // Nothing is called if the context is destroyed first.
+    template <typename Functor>
+    void whenFinished(QObject *context, Functor functor);
 
 Q_SIGNALS:
     void statusChanged();
@@ -62,16 +74,72 @@ Q_SIGNALS:
 
 public Q_SLOTS:
     virtual void startJob();
+    virtual void cancel();
+
+protected Q_SLOTS:
+    virtual void onStepTimeout();
 
 protected:
     void setStatus(Status status);
     void scheduleDeletion(int timeout = 60000);
 
+    // suspends the job until the given operation finishes, and then resumes it
+    // by calling the given member. Only one step is awaited at a time, and
+    // the wait is aborted by cancel() or after the given timeout (in ms, a
+    // negative value meaning no timeout).
+    template <typename Job>
+    void awaitOperation(Tp::PendingOperation *op, void (Job::*resume)(Tp::PendingOperation*), int timeout = 60000);
+    // same for a step made of several operations running side by side: the
+    // member is called as each of them finishes, and the timeout covers them
+    // all. The job tells when the step is over by calling finishStep() or
+    // finishJob().
+    template <typename Job, typename Operation>
+    void awaitOperations(const QList<Operation*> &ops, void (Job::*resume)(Tp::PendingOperation*), int timeout = 60000);
+    void startStepTimeout(int timeout);
+    void finishStep();
+    void finishJob(Status status);
+
 private:
+    void traceStatus(Status status);
+
     Status mStatus;
     bool mFinished;
     QString mObjectPath;
     QDBusAbstractAdaptor *mAdaptor;
+    QString mTraceId;
+    QTimer mStepTimer;
+    QList<QMetaObject::Connection> mAwaitConnections;
 };
 
+template <typename Job>
+void MessageJob::awaitOperation(Tp::PendingOperation *op, void (Job::*resume)(Tp::PendingOperation*), int timeout)
+{
+    awaitOperations(QList<Tp::PendingOperation*>() << op, resume, timeout);
+}
+
+template <typename Job, typename Operation>
+void MessageJob::awaitOperations(const QList<Operation*> &ops, void (Job::*resume)(Tp::PendingOperation*), int timeout)
+{
+    finishStep();
+    Q_FOREACH(Operation *op, ops) {
+        mAwaitConnections << connect(op, &Tp::PendingOperation::finished, static_cast<Job*>(this), resume);
+    }
+    startStepTimeout(timeout);
+}
+
+template <typename Functor>
+void MessageJob::whenFinished(QObject *context, Functor functor)
+{
+    if (mFinished) {
+        QTimer::singleShot(0, context, functor);
+        return;
+    }
+
+    QSharedPointer<QMetaObject::Connection> connection(new QMetaObject::Connection);
+    *connection = connect(this, &MessageJob::finished, context, [connection, functor]() mutable {
+        QObject::disconnect(*connection);
+        functor();
+    });
+}
+
 #endif // MESSAGEJOB_H
@@ -22,14 +22,18 @@
 
 #include "accountentry.h"
 #include "chatstartingjob.h"
+#include "flowtracer.h"
 #include "messagesendingjob.h"
 #include "messagesendingjobadaptor.h"
 #include "telepathyhelper.h"
 #include "texthandler.h"
+#include "telephonylogging.h"
 #include <TelepathyQt/ContactManager>
 #include <TelepathyQt/PendingContacts>
 #include <QImage>
 
+#define SEND_MESSAGE_TIMEOUT 60000
+
 #define SMIL_TEXT_REGION "<region id=\"Text\" width=\"100%\" height=\"100%\" fit=\"scroll\" />"
 #define SMIL_IMAGE_REGION "<region id=\"Image\" width=\"100%\" height=\"100%\" fit=\"meet\" />"
 #define SMIL_VIDEO_REGION "<region id=\"Video\" width=\"100%\" height=\"100%\" fit=\"meet\" />"
@@ -59,19 +63,37 @@
  </smil>"
 
 MessageSendingJob::MessageSendingJob(TextHandler *textHandler, PendingMessage message)
-: MessageJob(textHandler), mTextHandler(textHandler), mMessage(message), mFinished(false)
+: MessageJob(textHandler), mTextHandler(textHandler), mMessage(message), mAccount(0),
+  mPendingParts(0), mFailedParts(0)
 {
     setAdaptorAndRegister(new MessageSendingJobAdaptor(this));
+
+    if (FlowTracer::instance()->isEnabled()) {
+        QString id = mMessage.properties[TRACE_ID_PROPERTY].toString();
+        if (id.isEmpty()) {
+            // the client is not tracing, so the flow starts here
+            id = FlowTracer::instance()->newTraceId();
+            mMessage.properties[TRACE_ID_PROPERTY] = id;
+            FlowTracer::instance()->begin(id, "send-message");
+        }
+        setTraceId(id);
+        connect(this, &MessageJob::finished, [this]() {
+            QVariantMap args;
+            args["status"] = status() == Finished ? "finished" : "failed";
+            args["messageId"] = mMessageId;
+            FlowTracer::instance()->end(traceId(), "send-message", args);
+        });
+    }
 }
 
 MessageSendingJob::~MessageSendingJob()
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerText) << __PRETTY_FUNCTION__;
 }
 
 QString MessageSendingJob::accountId() const
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerText) << __PRETTY_FUNCTION__;
     return mAccountId;
 }
 
@@ -82,7 +104,7 @@ QString MessageSendingJob::messageId() const
 
 QString MessageSendingJob::channelObjectPath() const
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerText) << __PRETTY_FUNCTION__;
     return mChannelObjectPath;
 }
 
@@ -93,12 +115,11 @@ QVariantMap MessageSendingJob::properties() const
 
 void MessageSendingJob::startJob()
 {
-    qDebug() << __PRETTY_FUNCTION__;
-    qDebug() << "Getting account for id:" << mMessage.accountId;
+    qCDebug(lcHandlerText) << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerText) << "Getting account for id:" << mMessage.accountId;
     AccountEntry *account = TelepathyHelper::instance()->accountForId(mMessage.accountId);
     if (!account) {
-        setStatus(Failed);
-        scheduleDeletion();
+        finishJob(Failed);
         return;
     }
 
@@ -121,80 +142,155 @@ void MessageSendingJob::startJob()
     mAccount = account;
     setAccountId(mAccount->accountId());
 
+    // there is no timeout while waiting for the account to connect: messages
+    // are kept pending until the connection is back or the job is cancelled
     if (!account->connected()) {
-        connect(account, &AccountEntry::connectedChanged, [this, account]() {
-            if (account->connected()) {
-                findOrCreateChannel();
-            }
-        });
+        FlowTracer::instance()->instant(traceId(), "waiting-for-account");
+        mAccountConnection = connect(account, &AccountEntry::connectedChanged,
+                                     this, &MessageSendingJob::onAccountConnectedChanged);
+        return;
+    }
+
+    findOrCreateChannel();
+}
+
+void MessageSendingJob::cancel()
+{
+    QObject::disconnect(mAccountConnection);
+    if (mChatStartingJob) {
+        mChatStartingJob->cancel();
+    }
+    MessageJob::cancel();
+}
+
+void MessageSendingJob::onAccountConnectedChanged()
+{
+    if (isFinished() || !mAccount->connected()) {
         return;
     }
 
+    QObject::disconnect(mAccountConnection);
     findOrCreateChannel();
 }
 
 void MessageSendingJob::findOrCreateChannel()
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerText) << __PRETTY_FUNCTION__;
     // now that we know what account to use, find existing channels or request a new one
     QList<Tp::TextChannelPtr> channels = mTextHandler->existingChannels(mAccount->accountId(), mMessage.properties);
     if (channels.isEmpty()) {
-        ChatStartingJob *job = new ChatStartingJob(mTextHandler, mAccount->accountId(), mMessage.properties);
-        connect(job, &MessageJob::finished, [this, job]() {
-            if (job->status() == MessageJob::Failed) {
-                setStatus(Failed);
-                scheduleDeletion();
-                return;
-            }
-
-            mTextChannel = job->textChannel();
-            sendMessage();
+        mChatStartingJob = new ChatStartingJob(mTextHandler, mAccount->accountId(), mMessage.properties);
+        mChatStartingJob->whenFinished(this, [this]() {
+            onChatStartingJobFinished();
         });
-        job->startJob();
+        mChatStartingJob->startJob();
         return;
     }
 
     mTextChannel = channels.last();
+    FlowTracer::instance()->instant(traceId(), "existing-channel");
+    sendMessage();
+}
+
+void MessageSendingJob::onChatStartingJobFinished()
+{
+    ChatStartingJob *job = mChatStartingJob.data();
+    mChatStartingJob.clear();
+    if (!job || isFinished()) {
+        return;
+    }
+
+    if (job->status() == MessageJob::Failed) {
+        finishJob(Failed);
+        return;
+    }
+
+    mTextChannel = job->textChannel();
     sendMessage();
 }
 
 void MessageSendingJob::sendMessage()
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerText) << __PRETTY_FUNCTION__;
 
     Tp::MessagePartList messageParts = buildMessage(mMessage);
-    Tp::PendingSendMessage *op = NULL;
+    if (messageParts.isEmpty()) {
+        finishJob(Failed);
+        return;
+    }
+
+    mSendOperations.clear();
+    mPendingParts = 0;
+    mFailedParts = 0;
+    mSentMessageToken.clear();
+    mSendTimer.start();
+
     // some protocols can't sent multipart messages, so we check here
-    // and split the parts if needed
+    // and split the parts if needed. The split messages are all sent back to
+    // back, and the job only finishes once every one of them is done.
     if (canSendMultiPartMessages()) {
-        op = mTextChannel->send(messageParts);
+        mSendOperations << mTextChannel->send(messageParts);
     } else {
-        bool messageSent = false;
         Tp::MessagePart header = messageParts.takeFirst();
         Q_FOREACH(const Tp::MessagePart &part, messageParts) {
             Tp::MessagePartList newMessage;
             newMessage << header;
             newMessage << part;
-            Tp::PendingSendMessage *thisOp = mTextChannel->send(newMessage);
-            if (messageSent) {
-                continue;
-            }
-            messageSent = true;
-            op = thisOp;
+            mSendOperations << mTextChannel->send(newMessage);
         }
     }
-    connect(op, &Tp::PendingOperation::finished, [this, op]() {
-        if (op->isError()) {
-            setStatus(Failed);
-            scheduleDeletion();
-            return;
-        }
 
-        setChannelObjectPath(mTextChannel->objectPath());
-        setMessageId(op->sentMessageToken());
-        setStatus(Finished);
-        scheduleDeletion();
-    });
+    if (mSendOperations.isEmpty()) {
+        finishJob(Failed);
+        return;
+    }
+
+    mPendingParts = mSendOperations.size();
+    if (FlowTracer::instance()->isEnabled()) {
+        QVariantMap args;
+        args["parts"] = mPendingParts;
+        FlowTracer::instance()->instant(traceId(), "sending", args);
+    }
+    awaitOperations(mSendOperations, &MessageSendingJob::onMessageSent, SEND_MESSAGE_TIMEOUT);
+}
+
+void MessageSendingJob::onMessageSent(Tp::PendingOperation *op)
+{
+    int index = mSendOperations.indexOf(qobject_cast<Tp::PendingSendMessage*>(op));
+    if (isFinished() || index < 0) {
+        return;
+    }
+
+    // the operation deletes itself once finished, so do not keep it around
+    mSendOperations[index] = 0;
+    mPendingParts--;
+    FlowTracer::instance()->instant(traceId(), op->isError() ? "part-failed" : "part-sent");
+
+    if (op->isError()) {
+        qCWarning(lcHandlerText) << "Failed to send part" << index + 1 << "of" << mSendOperations.size()
+                   << "of message in job" << objectPath() << ":" << op->errorName() << op->errorMessage();
+        mFailedParts++;
+    } else if (index == 0) {
+        mSentMessageToken = static_cast<Tp::PendingSendMessage*>(op)->sentMessageToken();
+    }
+
+    if (mPendingParts > 0) {
+        return;
+    }
+
+    if (mSendOperations.size() > 1) {
+        qCDebug(lcHandlerText) << "Sent message split in" << mSendOperations.size() << "parts in"
+                 << mSendTimer.elapsed() << "ms," << mFailedParts << "failed";
+    }
+
+    if (mFailedParts > 0) {
+        finishJob(Failed);
+        return;
+    }
+
+    setChannelObjectPath(mTextChannel->objectPath());
+    setMessageId(mSentMessageToken);
+    finishJob(Finished);
 }
  
 bool MessageSendingJob::canSendMultiPartMessages()
@@ -216,14 +312,14 @@ bool MessageSendingJob::canSendMultiPartMessages()
 
 void MessageSendingJob::setAccountId(const QString &accountId)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerText) << __PRETTY_FUNCTION__;
     mAccountId = accountId;
     Q_EMIT accountIdChanged();
 }
 
 void MessageSendingJob::setChannelObjectPath(const QString &objectPath)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerText) << __PRETTY_FUNCTION__;
     mChannelObjectPath = objectPath;
     Q_EMIT channelObjectPathChanged();
 }
@@ -236,7 +332,7 @@ void MessageSendingJob::setMessageId(const QString &id)
 
 Tp::MessagePartList MessageSendingJob::buildMessage(const PendingMessage &pendingMessage)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerText) << __PRETTY_FUNCTION__;
     Tp::MessagePartList message;
     Tp::MessagePart header;
     QString smil, regions, parts;
@@ -278,7 +374,7 @@ Tp::MessagePartList MessageSendingJob::buildMessage(const PendingMessage &pendin
         QString newFilePath = QString(attachment.filePath).replace("file://", "");
         QFile attachmentFile(newFilePath);
         if (!attachmentFile.open(QIODevice::ReadOnly)) {
-            qWarning() << "fail to load attachment" << attachmentFile.errorString() << attachment.filePath;
+            qCWarning(lcHandlerText) << "fail to load attachment" << attachmentFile.errorString() << attachment.filePath;
             continue;
         }
         if (attachment.contentType.startsWith("image/")) {
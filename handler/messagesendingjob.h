@@ -23,12 +23,16 @@
 #ifndef MESSAGESENDINGJOB_H
 #define MESSAGESENDINGJOB_H
 
+#include <QElapsedTimer>
 #include <QObject>
+#include <QPointer>
+#include <TelepathyQt/PendingSendMessage>
 #include <TelepathyQt/Types>
 #include "dbustypes.h"
 #include "messagejob.h"
 
 class AccountEntry;
+class ChatStartingJob;
 class TextHandler;
 class MessageSendingJobAdaptor;
 
@@ -64,11 +68,16 @@ Q_SIGNALS:
 
 public Q_SLOTS:
     void startJob();
+    void cancel();
 
 protected Q_SLOTS:
     void findOrCreateChannel();
     void sendMessage();
 
+    void onAccountConnectedChanged();
+    void onChatStartingJobFinished();
+    void onMessageSent(Tp::PendingOperation *op);
+
     void setAccountId(const QString &accountId);
     void setChannelObjectPath(const QString &objectPath);
     void setMessageId(const QString &id);
@@ -81,7 +90,13 @@ private:
     AccountEntry *mAccount;
     QString mChannelObjectPath;
     Tp::TextChannelPtr mTextChannel;
-    bool mFinished;
+    QPointer<ChatStartingJob> mChatStartingJob;
+    QMetaObject::Connection mAccountConnection;
+    QList<Tp::PendingSendMessage*> mSendOperations;
+    int mPendingParts;
+    int mFailedParts;
+    QString mSentMessageToken;
+    QElapsedTimer mSendTimer;
 
     Tp::MessagePartList buildMessage(const PendingMessage &pendingMessage);
     bool canSendMultiPartMessages();
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "numberrewriter.h"
+#include "phoneutils.h"
+#include "telephonylogging.h"
+#include <QDebug>
+
+// FIXME: do a proper phone number identification implementation
+// for now consider anything bigger than 6 digits to be a phone number
+#define DEFAULT_MIN_LENGTH 7
+#define MAX_RESULTS 64
+
+NumberRewriter::Rule::Rule()
+: minLength(0), fullNumber(false), hasReplacement(false), continues(false)
+{
+}
+
+NumberRewriter::NumberRewriter(const QVariantMap &accountProperties)
+: mResults(MAX_RESULTS)
+{
+    if (!accountProperties["numberRewrite"].toBool()) {
+        return;
+    }
+
+    QVariantList rules = accountProperties["numberRewriteRules"].toList();
+    if (rules.isEmpty()) {
+        // the single rule all accounts had before rule lists were supported
+        Rule rule = compileRule(accountProperties);
+        rule.minLength = DEFAULT_MIN_LENGTH;
+        rule.fullNumber = true;
+        mRules << rule;
+        return;
+    }
+
+    Q_FOREACH(const QVariant &settings, rules) {
+        Rule rule = compileRule(settings.toMap());
+        if (!rule.match.isValid()) {
+            qCWarning(lcHandlerCall) << "Ignoring number rewriting rule with an invalid expression:"
+                       << rule.match.pattern() << rule.match.errorString();
+            continue;
+        }
+        mRules << rule;
+    }
+}
+
+NumberRewriter::NumberRewriter(const NumberRewriter &other)
+: mRules(other.mRules), mResults(MAX_RESULTS)
+{
+}
+
+NumberRewriter &NumberRewriter::operator=(const NumberRewriter &other)
+{
+    mRules = other.mRules;
+    mResults.clear();
+    return *this;
+}
+
+bool NumberRewriter::isEmpty() const
+{
+    return mRules.isEmpty();
+}
+
+QString NumberRewriter::rewrite(const QString &number) const
+{
+    if (mRules.isEmpty()) {
+        return number;
+    }
+
+    QString *result = mResults.object(number);
+    if (result) {
+        return *result;
+    }
+
+    QString finalNumber = number;
+    Q_FOREACH(const Rule &rule, mRules) {
+        if (finalNumber.length() < rule.minLength ||
+            (!rule.match.pattern().isEmpty() && !rule.match.match(finalNumber).hasMatch())) {
+            continue;
+        }
+
+        finalNumber = applyRule(rule, finalNumber);
+        if (!rule.continues) {
+            break;
+        }
+    }
+
+    mResults.insert(number, new QString(finalNumber));
+    return finalNumber;
+}
+
+NumberRewriter::Rule NumberRewriter::compileRule(const QVariantMap &settings)
+{
+    Rule rule;
+    rule.match.setPattern(settings["match"].toString());
+    rule.match.optimize();
+    rule.minLength = settings["minLength"].toInt();
+    rule.fullNumber = settings.contains("defaultCountryCode") || settings.contains("defaultAreaCode");
+    rule.defaultCountryCode = settings["defaultCountryCode"].toString();
+    if (!rule.defaultCountryCode.startsWith("+")) {
+        rule.defaultCountryCode.prepend("+");
+    }
+    rule.defaultAreaCode = settings["defaultAreaCode"].toString();
+    rule.hasReplacement = settings.contains("replace");
+    rule.replacement = settings["replace"].toString();
+    rule.removeCharacters = settings["removeCharacters"].toString();
+    rule.prefix = settings["prefix"].toString();
+    rule.continues = settings["continue"].toBool();
+    return rule;
+}
+
+QString NumberRewriter::applyRule(const Rule &rule, const QString &number) const
+{
+    QString finalNumber = number;
+    if (rule.hasReplacement && !rule.match.pattern().isEmpty()) {
+        finalNumber.replace(rule.match, rule.replacement);
+    }
+    if (rule.fullNumber) {
+        finalNumber = PhoneUtils::getFullNumber(finalNumber, rule.defaultCountryCode, rule.defaultAreaCode);
+    }
+    if (!rule.removeCharacters.isEmpty()) {
+        finalNumber.remove(rule.removeCharacters);
+    }
+    finalNumber.prepend(rule.prefix);
+    return finalNumber;
+}
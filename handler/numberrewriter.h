@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUMBERREWRITER_H
+#define NUMBERREWRITER_H
+
+#include <QCache>
+#include <QList>
+#include <QRegularExpression>
+#include <QVariantMap>
+
+/* The number rewriting settings of an account, compiled once so that
+ * dialing does not need to parse them again.
+ *
+ * Numbers are only rewritten if the numberRewrite account property is set.
+ * The rules are either the single one from the account properties
+ * (defaultCountryCode, defaultAreaCode, removeCharacters and prefix) or the
+ * ordered list in the numberRewriteRules property, when there is one.
+ * Each rule is a map that can have:
+ *   match: a regular expression the number has to match for the rule to apply
+ *   minLength: the minimum length of the number for the rule to apply
+ *   defaultCountryCode, defaultAreaCode: complete the number to its
+ *       international format using these defaults
+ *   replace: replaces what match captured, \1 and so on refer to its groups
+ *   removeCharacters: a string to remove from the number
+ *   prefix: a string to prepend to the number
+ *   continue: keep going through the rules after this one applied
+ * The rules are tried in order and, unless told to continue, the first one
+ * that applies ends the rewriting. */
+class NumberRewriter
+{
+public:
+    explicit NumberRewriter(const QVariantMap &accountProperties = QVariantMap());
+    // copies only the rules, the copy starts with no cached results
+    NumberRewriter(const NumberRewriter &other);
+    NumberRewriter &operator=(const NumberRewriter &other);
+
+    bool isEmpty() const;
+    QString rewrite(const QString &number) const;
+
+private:
+    struct Rule {
+        Rule();
+        QRegularExpression match;
+        int minLength;
+        bool fullNumber;
+        QString defaultCountryCode;
+        QString defaultAreaCode;
+        bool hasReplacement;
+        QString replacement;
+        QString removeCharacters;
+        QString prefix;
+        bool continues;
+    };
+
+    static Rule compileRule(const QVariantMap &settings);
+    QString applyRule(const Rule &rule, const QString &number) const;
+
+    QList<Rule> mRules;
+    // the same numbers tend to be dialed over and over, and completing them
+    // to the full number is the expensive part. The least recently used
+    // results are dropped first.
+    mutable QCache<QString, QString> mResults;
+};
+
+#endif // NUMBERREWRITER_H
@@ -18,8 +18,10 @@
 ****************************************************************************/
 
 #include <QtCore/qdebug.h>
+#include <QtCore/qelapsedtimer.h>
 
 #include "qpulseaudioengine.h"
+#include "telephonylogging.h"
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -47,55 +49,113 @@ static void success_cb(pa_context *context, int success, void *userdata)
     pa_threaded_mainloop_signal(pulseEngine->mainloop(), 0);
 }
 
-/* Callbacks used when handling events from PulseAudio */
-static void plug_card_cb(pa_context *c, const pa_card_info *info, int isLast, void *userdata)
+/* Callbacks used to keep the PulseAudio model up to date */
+static void cardinfo_cb(pa_context *context, const pa_card_info *info, int isLast, void *userdata)
 {
     QPulseAudioEngineWorker *pulseEngine = static_cast<QPulseAudioEngineWorker*>(userdata);
     if (isLast != 0 || !pulseEngine || !info) {
         pa_threaded_mainloop_signal(pulseEngine->mainloop(), 0);
         return;
     }
-    pulseEngine->plugCardCallback(info);
+    pulseEngine->updateCardCache(info);
 }
 
-static void update_card_cb(pa_context *c, const pa_card_info *info, int isLast, void *userdata)
+static void sinkinfo_cb(pa_context *context, const pa_sink_info *info, int isLast, void *userdata)
 {
     QPulseAudioEngineWorker *pulseEngine = static_cast<QPulseAudioEngineWorker*>(userdata);
     if (isLast != 0 || !pulseEngine || !info) {
         pa_threaded_mainloop_signal(pulseEngine->mainloop(), 0);
         return;
     }
-    pulseEngine->updateCardCallback(info);
+    pulseEngine->updateSinkCache(info);
 }
 
-static void unplug_card_cb(pa_context *c, const pa_card_info *info, int isLast, void *userdata)
+static void sourceinfo_cb(pa_context *context, const pa_source_info *info, int isLast, void *userdata)
 {
     QPulseAudioEngineWorker *pulseEngine = static_cast<QPulseAudioEngineWorker*>(userdata);
-    if (!pulseEngine) {
+    if (isLast != 0 || !pulseEngine || !info) {
         pa_threaded_mainloop_signal(pulseEngine->mainloop(), 0);
         return;
     }
+    pulseEngine->updateSourceCache(info);
+}
+
+static void serverinfo_cb(pa_context *context, const pa_server_info *info, void *userdata)
+{
+    QPulseAudioEngineWorker *pulseEngine = static_cast<QPulseAudioEngineWorker*>(userdata);
+    if (pulseEngine && info) {
+        pulseEngine->updateServerCache(info);
+    }
+    pa_threaded_mainloop_signal(pulseEngine->mainloop(), 0);
+}
 
-    if (info == NULL) {
-        /* That means that the card used to query card_info was removed */
-        pulseEngine->unplugCardCallback();
+/* Callbacks used when handling card events from PulseAudio: the model is
+ * updated first, and the worker is then notified to react to the change */
+static void plug_card_cb(pa_context *c, const pa_card_info *info, int isLast, void *userdata)
+{
+    QPulseAudioEngineWorker *pulseEngine = static_cast<QPulseAudioEngineWorker*>(userdata);
+    if (isLast != 0 || !pulseEngine || !info) {
+        pa_threaded_mainloop_signal(pulseEngine->mainloop(), 0);
+        return;
     }
+    pulseEngine->updateCardCache(info);
+    pulseEngine->postCardEvent(PA_SUBSCRIPTION_EVENT_NEW, info->index);
+}
+
+static void update_card_cb(pa_context *c, const pa_card_info *info, int isLast, void *userdata)
+{
+    QPulseAudioEngineWorker *pulseEngine = static_cast<QPulseAudioEngineWorker*>(userdata);
+    if (isLast != 0 || !pulseEngine || !info) {
+        pa_threaded_mainloop_signal(pulseEngine->mainloop(), 0);
+        return;
+    }
+    pulseEngine->updateCardCache(info);
+    pulseEngine->postCardEvent(PA_SUBSCRIPTION_EVENT_CHANGE, info->index);
 }
 
 static void subscribeCallback(pa_context *context, pa_subscription_event_type_t t, uint32_t idx, void *userdata)
 {
-    /* For card change events (slot plug/unplug and add/remove card) */
-    if ((t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK) == PA_SUBSCRIPTION_EVENT_CARD) {
-        if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_CHANGE) {
-            QMetaObject::invokeMethod((QPulseAudioEngineWorker *) userdata, "handleCardEvent",
-                    Qt::QueuedConnection, Q_ARG(int, PA_SUBSCRIPTION_EVENT_CHANGE), Q_ARG(unsigned int, idx));
-        } else if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_NEW) {
-            QMetaObject::invokeMethod((QPulseAudioEngineWorker *) userdata, "handleCardEvent",
-                    Qt::QueuedConnection, Q_ARG(int, PA_SUBSCRIPTION_EVENT_NEW), Q_ARG(unsigned int, idx));
-        } else if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE) {
-            QMetaObject::invokeMethod((QPulseAudioEngineWorker *) userdata, "handleCardEvent",
-                    Qt::QueuedConnection, Q_ARG(int, PA_SUBSCRIPTION_EVENT_REMOVE), Q_ARG(unsigned int, idx));
+    QPulseAudioEngineWorker *pulseEngine = static_cast<QPulseAudioEngineWorker*>(userdata);
+    pa_subscription_event_type_t facility = pa_subscription_event_type_t(t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK);
+    pa_subscription_event_type_t type = pa_subscription_event_type_t(t & PA_SUBSCRIPTION_EVENT_TYPE_MASK);
+    pa_operation *o = NULL;
+
+    /* This runs on the PulseAudio thread with the mainloop locked, so just
+     * request the new state without waiting: the model gets updated from the
+     * info callbacks */
+    if (type == PA_SUBSCRIPTION_EVENT_REMOVE) {
+        pulseEngine->removeFromCache(facility, idx);
+        /* For card removal (slot unplug and remove card) */
+        if (facility == PA_SUBSCRIPTION_EVENT_CARD) {
+            pulseEngine->postCardEvent(PA_SUBSCRIPTION_EVENT_REMOVE, idx);
         }
+        return;
+    }
+
+    switch (facility) {
+    case PA_SUBSCRIPTION_EVENT_CARD:
+        /* For card change events (slot plug and add card) */
+        if (type == PA_SUBSCRIPTION_EVENT_NEW) {
+            o = pa_context_get_card_info_by_index(context, idx, plug_card_cb, userdata);
+        } else {
+            o = pa_context_get_card_info_by_index(context, idx, update_card_cb, userdata);
+        }
+        break;
+    case PA_SUBSCRIPTION_EVENT_SINK:
+        o = pa_context_get_sink_info_by_index(context, idx, sinkinfo_cb, userdata);
+        break;
+    case PA_SUBSCRIPTION_EVENT_SOURCE:
+        o = pa_context_get_source_info_by_index(context, idx, sourceinfo_cb, userdata);
+        break;
+    case PA_SUBSCRIPTION_EVENT_SERVER:
+        o = pa_context_get_server_info(context, serverinfo_cb, userdata);
+        break;
+    default:
+        break;
+    }
+
+    if (o) {
+        pa_operation_unref(o);
     }
 }
 
@@ -114,16 +174,17 @@ QPulseAudioEngineWorker::QPulseAudioEngineWorker(QObject *parent)
     , m_bt_hsp("")
     , m_bt_hsp_a2dp("")
     , m_default_bt_card_fallback("")
+    , m_pendingCardAction(-1)
 
 {
     m_mainLoop = pa_threaded_mainloop_new();
     if (m_mainLoop == 0) {
-        qWarning("Unable to create pulseaudio mainloop");
+        qCWarning(lcAudio, "Unable to create pulseaudio mainloop");
         return;
     }
 
     if (pa_threaded_mainloop_start(m_mainLoop) != 0) {
-        qWarning("Unable to start pulseaudio mainloop");
+        qCWarning(lcAudio, "Unable to start pulseaudio mainloop");
         pa_threaded_mainloop_free(m_mainLoop);
         m_mainLoop = 0;
         return;
@@ -148,13 +209,13 @@ bool QPulseAudioEngineWorker::createPulseContext()
     pa_context_set_state_callback(m_context, contextStateCallbackInit, this);
 
     if (!m_context) {
-        qWarning("Unable to create new pulseaudio context");
+        qCWarning(lcAudio, "Unable to create new pulseaudio context");
         pa_threaded_mainloop_unlock(m_mainLoop);
         return false;
     }
 
     if (pa_context_connect(m_context, NULL, PA_CONTEXT_NOAUTOSPAWN, NULL) < 0) {
-        qWarning("Unable to create a connection to the pulseaudio context");
+        qCWarning(lcAudio, "Unable to create a connection to the pulseaudio context");
         pa_threaded_mainloop_unlock(m_mainLoop);
         releasePulseContext();
         return false;
@@ -170,19 +231,19 @@ bool QPulseAudioEngineWorker::createPulseContext()
                 break;
 
             case PA_CONTEXT_READY:
-                qDebug("Pulseaudio connection established.");
+                qCDebug(lcAudio, "Pulseaudio connection established.");
                 keepGoing = false;
                 break;
 
             case PA_CONTEXT_TERMINATED:
-                qCritical("Pulseaudio context terminated.");
+                qCCritical(lcAudio, "Pulseaudio context terminated.");
                 keepGoing = false;
                 ok = false;
                 break;
 
             case PA_CONTEXT_FAILED:
             default:
-                qCritical() << QString("Pulseaudio connection failure: %1").arg(pa_strerror(pa_context_errno(m_context)));
+                qCCritical(lcAudio) << QString("Pulseaudio connection failure: %1").arg(pa_strerror(pa_context_errno(m_context)));
                 keepGoing = false;
                 ok = false;
         }
@@ -195,7 +256,23 @@ bool QPulseAudioEngineWorker::createPulseContext()
     if (ok) {
         pa_context_set_state_callback(m_context, contextStateCallback, this);
         pa_context_set_subscribe_callback(m_context, subscribeCallback, this);
-        pa_context_subscribe(m_context, PA_SUBSCRIPTION_MASK_CARD, NULL, this);
+        pa_context_subscribe(m_context, pa_subscription_mask_t(PA_SUBSCRIPTION_MASK_CARD |
+                                                               PA_SUBSCRIPTION_MASK_SINK |
+                                                               PA_SUBSCRIPTION_MASK_SOURCE |
+                                                               PA_SUBSCRIPTION_MASK_SERVER), NULL, this);
+
+        /* Fill the model once, all the queries in parallel */
+        std::vector<pa_operation*> operations;
+        m_cards.clear();
+        m_sinks.clear();
+        m_sources.clear();
+        if (!queueOperation(operations, pa_context_get_card_info_list(m_context, cardinfo_cb, this), "pa_context_get_card_info_list") ||
+            !queueOperation(operations, pa_context_get_sink_info_list(m_context, sinkinfo_cb, this), "pa_context_get_sink_info_list") ||
+            !queueOperation(operations, pa_context_get_source_info_list(m_context, sourceinfo_cb, this), "pa_context_get_source_info_list") ||
+            !queueOperation(operations, pa_context_get_server_info(m_context, serverinfo_cb, this), "pa_context_get_server_info")) {
+            return false;
+        }
+        waitForOperations(operations);
     } else {
         if (m_context) {
             pa_context_unref(m_context);
@@ -214,6 +291,9 @@ void QPulseAudioEngineWorker::releasePulseContext()
         pa_threaded_mainloop_lock(m_mainLoop);
         pa_context_disconnect(m_context);
         pa_context_unref(m_context);
+        m_cards.clear();
+        m_sinks.clear();
+        m_sources.clear();
         pa_threaded_mainloop_unlock(m_mainLoop);
         m_context = 0;
     }
@@ -231,76 +311,137 @@ QPulseAudioEngineWorker::~QPulseAudioEngineWorker()
     }
 }
 
-void QPulseAudioEngineWorker::cardInfoCallback(const pa_card_info *info)
+void QPulseAudioEngineWorker::updateCardCache(const pa_card_info *info)
 {
-    pa_card_profile_info2 *voice_call = NULL, *highest = NULL;
-    pa_card_profile_info2 *hsp = NULL, *a2dp = NULL;
+    PulseCard &card = m_cards[info->index];
+    card.name = info->name;
+    card.activeProfile = info->active_profile ? info->active_profile->name : "";
+    card.profiles.clear();
+    for (uint32_t i = 0; i < info->n_profiles; i++) {
+        PulseProfile profile = { info->profiles2[i]->name, info->profiles2[i]->priority, info->profiles2[i]->available };
+        card.profiles.push_back(profile);
+    }
+    card.ports.clear();
+    for (uint32_t i = 0; i < info->n_ports; i++) {
+        if (!info->ports[i])
+            continue;
+        PulsePort port = { info->ports[i]->name, info->ports[i]->available };
+        card.ports.push_back(port);
+    }
+}
+
+void QPulseAudioEngineWorker::updateSinkCache(const pa_sink_info *info)
+{
+    PulseDevice &sink = m_sinks[info->index];
+    sink.name = info->name;
+    sink.activePort = info->active_port ? info->active_port->name : "";
+    sink.isMonitor = false;
+    sink.ports.clear();
+    for (uint32_t i = 0; i < info->n_ports; i++) {
+        PulsePort port = { info->ports[i]->name, info->ports[i]->available };
+        sink.ports.push_back(port);
+    }
+}
+
+void QPulseAudioEngineWorker::updateSourceCache(const pa_source_info *info)
+{
+    PulseDevice &source = m_sources[info->index];
+    source.name = info->name;
+    source.activePort = info->active_port ? info->active_port->name : "";
+    source.isMonitor = info->monitor_of_sink != PA_INVALID_INDEX;
+    source.ports.clear();
+    for (uint32_t i = 0; i < info->n_ports; i++) {
+        PulsePort port = { info->ports[i]->name, info->ports[i]->available };
+        source.ports.push_back(port);
+    }
+}
+
+void QPulseAudioEngineWorker::updateServerCache(const pa_server_info *info)
+{
+    m_currentsink = info->default_sink_name ? info->default_sink_name : "";
+    m_currentsource = info->default_source_name ? info->default_source_name : "";
+}
+
+void QPulseAudioEngineWorker::removeFromCache(pa_subscription_event_type_t facility, uint32_t idx)
+{
+    switch (facility) {
+    case PA_SUBSCRIPTION_EVENT_CARD:
+        m_cards.erase(idx);
+        break;
+    case PA_SUBSCRIPTION_EVENT_SINK:
+        m_sinks.erase(idx);
+        break;
+    case PA_SUBSCRIPTION_EVENT_SOURCE:
+        m_sources.erase(idx);
+        break;
+    default:
+        break;
+    }
+}
+
+void QPulseAudioEngineWorker::cardInfoCallback(const PulseCard &card)
+{
+    const PulseProfile *voice_call = NULL, *highest = NULL;
+    const PulseProfile *hsp = NULL, *a2dp = NULL;
 
     /* For now we only support one card with the voicecall feature */
-    for (int i = 0; i < info->n_profiles; i++) {
-        if (!highest || info->profiles2[i]->priority > highest->priority)
-            highest = info->profiles2[i];
-        if (!strcmp(info->profiles2[i]->name, "voicecall") ||
-            !strcmp(info->profiles2[i]->name, "Voice Call"))
-            voice_call = info->profiles2[i];
-        else if (!strcmp(info->profiles2[i]->name, PULSEAUDIO_PROFILE_HSP) &&
-                 info->profiles2[i]->available != 0)
-            hsp = info->profiles2[i];
-        else if (!strcmp(info->profiles2[i]->name, PULSEAUDIO_PROFILE_A2DP) &&
-                 info->profiles2[i]->available != 0)
-            a2dp = info->profiles2[i];
+    for (size_t i = 0; i < card.profiles.size(); i++) {
+        const PulseProfile &profile = card.profiles[i];
+        if (!highest || profile.priority > highest->priority)
+            highest = &profile;
+        if (profile.name == "voicecall" || profile.name == "Voice Call")
+            voice_call = &profile;
+        else if (profile.name == PULSEAUDIO_PROFILE_HSP && profile.available != 0)
+            hsp = &profile;
+        else if (profile.name == PULSEAUDIO_PROFILE_A2DP && profile.available != 0)
+            a2dp = &profile;
     }
 
     /* Record the card that supports voicecall (default one to be used) */
     if (voice_call) {
-        qDebug("Found card that supports voicecall: '%s'", info->name);
-        m_voicecallcard = info->name;
+        qCDebug(lcAudio, "Found card that supports voicecall: '%s'", card.name.c_str());
+        m_voicecallcard = card.name;
         m_voicecallhighest = highest->name;
-    qDebug("1");
         m_voicecallprofile = voice_call->name;
-    qDebug("2");
     }
 
     /* Handle the use cases needed for bluetooth */
     if (hsp && a2dp) {
-        qDebug("Found card that supports hsp and a2dp: '%s'", info->name);
-        m_bt_hsp_a2dp = info->name;
+        qCDebug(lcAudio, "Found card that supports hsp and a2dp: '%s'", card.name.c_str());
+        m_bt_hsp_a2dp = card.name;
     } else if (hsp && (a2dp == NULL)) {
         /* This card only provides the hsp profile */
-        qDebug("Found card that supports only hsp: '%s'", info->name);
-        m_bt_hsp = info->name;
+        qCDebug(lcAudio, "Found card that supports only hsp: '%s'", card.name.c_str());
+        m_bt_hsp = card.name;
     }
-    qDebug("3");
 }
 
-void QPulseAudioEngineWorker::sinkInfoCallback(const pa_sink_info *info)
+void QPulseAudioEngineWorker::sinkInfoCallback(const PulseDevice &sink)
 {
-    pa_sink_port_info *earpiece = NULL, *speaker = NULL;
-    pa_sink_port_info *wired_headset = NULL, *wired_headphone = NULL;
-    pa_sink_port_info *preferred = NULL;
-    pa_sink_port_info *bluetooth_sco = NULL;
-    pa_sink_port_info *speaker_and_wired_headphone = NULL;
+    const PulsePort *earpiece = NULL, *speaker = NULL;
+    const PulsePort *wired_headset = NULL, *wired_headphone = NULL;
+    const PulsePort *preferred = NULL;
+    const PulsePort *bluetooth_sco = NULL;
+    const PulsePort *speaker_and_wired_headphone = NULL;
     AudioMode audiomodetoset;
     AudioModes modes;
 
-    for (int i = 0; i < info->n_ports; i++) {
-        if (!strcmp(info->ports[i]->name, "output-earpiece") ||
-            !strcmp(info->ports[i]->name, "Earpiece"))
-            earpiece = info->ports[i];
-        else if (!strcmp(info->ports[i]->name, "output-wired_headset") &&
-                (info->ports[i]->available != PA_PORT_AVAILABLE_NO))
-            wired_headset = info->ports[i];
-        else if ((!strcmp(info->ports[i]->name, "output-wired_headphone") ||
-                  !strcmp(info->ports[i]->name, "Headphone")) &&
-                (info->ports[i]->available != PA_PORT_AVAILABLE_NO))
-            wired_headphone = info->ports[i];
-        else if (!strcmp(info->ports[i]->name, "output-speaker") ||
-                 !strcmp(info->ports[i]->name, "Speaker"))
-            speaker = info->ports[i];
-        else if (!strcmp(info->ports[i]->name, "output-bluetooth_sco"))
-            bluetooth_sco = info->ports[i];
-        else if (!strcmp(info->ports[i]->name, "output-speaker+wired_headphone"))
-            speaker_and_wired_headphone = info->ports[i];
+    for (size_t i = 0; i < sink.ports.size(); i++) {
+        const PulsePort &port = sink.ports[i];
+        if (port.name == "output-earpiece" || port.name == "Earpiece")
+            earpiece = &port;
+        else if (port.name == "output-wired_headset" &&
+                (port.available != PA_PORT_AVAILABLE_NO))
+            wired_headset = &port;
+        else if ((port.name == "output-wired_headphone" || port.name == "Headphone") &&
+                (port.available != PA_PORT_AVAILABLE_NO))
+            wired_headphone = &port;
+        else if (port.name == "output-speaker" || port.name == "Speaker")
+            speaker = &port;
+        else if (port.name == "output-bluetooth_sco")
+            bluetooth_sco = &port;
+        else if (port.name == "output-speaker+wired_headphone")
+            speaker_and_wired_headphone = &port;
     }
 
     if (!earpiece || !speaker)
@@ -342,32 +483,31 @@ void QPulseAudioEngineWorker::sinkInfoCallback(const pa_sink_info *info)
 
     m_audiomode = audiomodetoset;
 
-    m_nametoset = info->name;
-    if (info->active_port != preferred)
+    m_nametoset = sink.name;
+    if (preferred && sink.activePort != preferred->name)
         m_valuetoset = preferred->name;
 
     if (modes != m_availableAudioModes)
         m_availableAudioModes = modes;
 }
 
-void QPulseAudioEngineWorker::sourceInfoCallback(const pa_source_info *info)
+void QPulseAudioEngineWorker::sourceInfoCallback(const PulseDevice &source)
 {
-    pa_source_port_info *builtin_mic = NULL, *preferred = NULL;
-    pa_source_port_info *wired_headset = NULL, *bluetooth_sco = NULL;
+    const PulsePort *builtin_mic = NULL, *preferred = NULL;
+    const PulsePort *wired_headset = NULL, *bluetooth_sco = NULL;
 
-    if (info->monitor_of_sink != PA_INVALID_INDEX)
+    if (source.isMonitor)
         return;  /* Not the right source */
 
-    for (int i = 0; i < info->n_ports; i++) {
-        if (!strcmp(info->ports[i]->name, "input-builtin_mic") ||
-            !strcmp(info->ports[i]->name, "DigitalMic"))
-            builtin_mic = info->ports[i];
-        else if ((!strcmp(info->ports[i]->name, "input-wired_headset") ||
-                  !strcmp(info->ports[i]->name, "HeadsetMic")) &&
-                (info->ports[i]->available != PA_PORT_AVAILABLE_NO))
-            wired_headset = info->ports[i];
-        else if (!strcmp(info->ports[i]->name, "input-bluetooth_sco_headset"))
-            bluetooth_sco = info->ports[i];
+    for (size_t i = 0; i < source.ports.size(); i++) {
+        const PulsePort &port = source.ports[i];
+        if (port.name == "input-builtin_mic" || port.name == "DigitalMic")
+            builtin_mic = &port;
+        else if ((port.name == "input-wired_headset" || port.name == "HeadsetMic") &&
+                (port.available != PA_PORT_AVAILABLE_NO))
+            wired_headset = &port;
+        else if (port.name == "input-bluetooth_sco_headset")
+            bluetooth_sco = &port;
     }
 
     if (!builtin_mic)
@@ -381,74 +521,62 @@ void QPulseAudioEngineWorker::sourceInfoCallback(const pa_source_info *info)
     if ((m_audiomode & AudioModeBluetooth) && (m_availableAudioModes.contains(AudioModeBluetooth)))
         preferred = bluetooth_sco;
 
-    m_nametoset = info->name;
-    if (info->active_port != preferred)
+    m_nametoset = source.name;
+    if (preferred && source.activePort != preferred->name)
         m_valuetoset = preferred->name;
 }
 
-void QPulseAudioEngineWorker::serverInfoCallback(const pa_server_info *info)
+bool QPulseAudioEngineWorker::handleOperation(pa_operation *operation, const char *func_name)
 {
-    /* Saving default sink/source to restore after call hangup */
-    m_defaultsink = info->default_sink_name;
-    m_defaultsource = info->default_source_name;
+    if (!operation) {
+        qCCritical(lcAudio, "'%s' failed (lost PulseAudio connection?)", func_name);
+        /* Free resources so it can retry a new connection during next operation */
+        pa_threaded_mainloop_unlock(m_mainLoop);
+        releasePulseContext();
+        return false;
+    }
 
-    /* In the case of a server callback we need to signal the mainloop */
-    pa_threaded_mainloop_signal(mainloop(), 0);
+    while (pa_operation_get_state(operation) == PA_OPERATION_RUNNING)
+        pa_threaded_mainloop_wait(m_mainLoop);
+    pa_operation_unref(operation);
+    return true;
 }
 
-static void cardinfo_cb(pa_context *context, const pa_card_info *info, int isLast, void *userdata)
+bool QPulseAudioEngineWorker::queueOperation(std::vector<pa_operation*> &operations, pa_operation *operation, const char *func_name)
 {
-    QPulseAudioEngineWorker *pulseEngine = static_cast<QPulseAudioEngineWorker*>(userdata);
-    if (isLast != 0 || !pulseEngine || !info) {
-        pa_threaded_mainloop_signal(pulseEngine->mainloop(), 0);
-        return;
+    if (!operation) {
+        for (size_t i = 0; i < operations.size(); i++)
+            pa_operation_unref(operations[i]);
+        operations.clear();
+        return handleOperation(operation, func_name);
     }
-    pulseEngine->cardInfoCallback(info);
-}
 
-static void sinkinfo_cb(pa_context *context, const pa_sink_info *info, int isLast, void *userdata)
-{
-    QPulseAudioEngineWorker *pulseEngine = static_cast<QPulseAudioEngineWorker*>(userdata);
-    if (isLast != 0 || !pulseEngine || !info) {
-        pa_threaded_mainloop_signal(pulseEngine->mainloop(), 0);
-        return;
-    }
-    pulseEngine->sinkInfoCallback(info);
+    operations.push_back(operation);
+    return true;
 }
 
-static void sourceinfo_cb(pa_context *context, const pa_source_info *info, int isLast, void *userdata)
+void QPulseAudioEngineWorker::waitForOperations(std::vector<pa_operation*> &operations)
 {
-    QPulseAudioEngineWorker *pulseEngine = static_cast<QPulseAudioEngineWorker*>(userdata);
-    if (isLast != 0 || !pulseEngine || !info) {
-        pa_threaded_mainloop_signal(pulseEngine->mainloop(), 0);
-        return;
+    /* The operations were all sent back to back, so this only waits
+     * for the slowest of them */
+    for (size_t i = 0; i < operations.size(); i++) {
+        while (pa_operation_get_state(operations[i]) == PA_OPERATION_RUNNING)
+            pa_threaded_mainloop_wait(m_mainLoop);
+        pa_operation_unref(operations[i]);
     }
-    pulseEngine->sourceInfoCallback(info);
+    operations.clear();
 }
 
-static void serverinfo_cb(pa_context *context, const pa_server_info *info, void *userdata)
+bool QPulseAudioEngineWorker::refreshDevices()
 {
-    QPulseAudioEngineWorker *pulseEngine = static_cast<QPulseAudioEngineWorker*>(userdata);
-    if (!pulseEngine || !info) {
-        pa_threaded_mainloop_signal(pulseEngine->mainloop(), 0);
-        return;
-    }
-    pulseEngine->serverInfoCallback(info);
-}
+    std::vector<pa_operation*> operations;
 
-bool QPulseAudioEngineWorker::handleOperation(pa_operation *operation, const char *func_name)
-{
-    if (!operation) {
-        qCritical("'%s' failed (lost PulseAudio connection?)", func_name);
-        /* Free resources so it can retry a new connection during next operation */
-        pa_threaded_mainloop_unlock(m_mainLoop);
-        releasePulseContext();
+    m_sinks.clear();
+    m_sources.clear();
+    if (!queueOperation(operations, pa_context_get_sink_info_list(m_context, sinkinfo_cb, this), "pa_context_get_sink_info_list") ||
+        !queueOperation(operations, pa_context_get_source_info_list(m_context, sourceinfo_cb, this), "pa_context_get_source_info_list"))
         return false;
-    }
-
-    while (pa_operation_get_state(operation) == PA_OPERATION_RUNNING)
-        pa_threaded_mainloop_wait(m_mainLoop);
-    pa_operation_unref(operation);
+    waitForOperations(operations);
     return true;
 }
 
@@ -456,29 +584,30 @@ int QPulseAudioEngineWorker::setupVoiceCall()
 {
     pa_operation *o;
 
-    qDebug("Setting up pulseaudio for voice call");
+    qCDebug(lcAudio, "Setting up pulseaudio for voice call");
 
     pa_threaded_mainloop_lock(m_mainLoop);
 
-    /* Get and set the default sink/source to be restored later */
-    o = pa_context_get_server_info(m_context, serverinfo_cb, this);
-    if (!handleOperation(o, "pa_context_get_server_info"))
-        return -1;
+    /* Record the default sink/source to be restored later */
+    if (m_currentsink != "")
+        m_defaultsink = m_currentsink;
+    if (m_currentsource != "")
+        m_defaultsource = m_currentsource;
 
-    qDebug("Recorded default sink: %s default source: %s",
+    qCDebug(lcAudio, "Recorded default sink: %s default source: %s",
             m_defaultsink.c_str(), m_defaultsource.c_str());
 
     /* Walk through the list of devices, find the voice call capable card and
      * identify if we have bluetooth capable devices (hsp and a2dp) */
     m_voicecallcard = m_voicecallhighest = m_voicecallprofile = "";
     m_bt_hsp = m_bt_hsp_a2dp = "";
-    o = pa_context_get_card_info_list(m_context, cardinfo_cb, this);
-    if (!handleOperation(o, "pa_context_get_card_info_list"))
-        return -1;
+    for (std::map<uint32_t, PulseCard>::const_iterator it = m_cards.begin(); it != m_cards.end(); ++it)
+        cardInfoCallback(it->second);
+
     /* In case we have only one bt device that provides hsp and a2dp, we need
      * to make sure we switch the default profile for that card (to hsp) */
     if ((m_bt_hsp_a2dp != "") && (m_bt_hsp == "")) {
-        qDebug("Setting PulseAudio card '%s' profile '%s'",
+        qCDebug(lcAudio, "Setting PulseAudio card '%s' profile '%s'",
                 m_bt_hsp_a2dp.c_str(), PULSEAUDIO_PROFILE_HSP);
         o = pa_context_set_card_profile_by_name(m_context,
             m_bt_hsp_a2dp.c_str(), PULSEAUDIO_PROFILE_HSP, success_cb, this);
@@ -493,37 +622,38 @@ int QPulseAudioEngineWorker::setupVoiceCall()
 
 void QPulseAudioEngineWorker::restoreVoiceCall()
 {
-    pa_operation *o;
+    std::vector<pa_operation*> operations;
 
-    qDebug("Restoring pulseaudio previous state");
+    qCDebug(lcAudio, "Restoring pulseaudio previous state");
 
     /* Then restore previous settings */
     pa_threaded_mainloop_lock(m_mainLoop);
 
     /* See if we need to restore any HSP+AD2P device state */
     if ((m_bt_hsp_a2dp != "") && (m_bt_hsp == "")) {
-        qDebug("Restoring PulseAudio card '%s' to profile '%s'",
+        qCDebug(lcAudio, "Restoring PulseAudio card '%s' to profile '%s'",
                 m_bt_hsp_a2dp.c_str(), PULSEAUDIO_PROFILE_A2DP);
-        o = pa_context_set_card_profile_by_name(m_context,
-            m_bt_hsp_a2dp.c_str(), PULSEAUDIO_PROFILE_A2DP, success_cb, this);
-        if (!handleOperation(o, "pa_context_set_card_profile_by_name"))
+        if (!queueOperation(operations, pa_context_set_card_profile_by_name(m_context,
+                m_bt_hsp_a2dp.c_str(), PULSEAUDIO_PROFILE_A2DP, success_cb, this), "pa_context_set_card_profile_by_name"))
             return;
     }
 
     /* Restore default sink/source */
-    if (m_defaultsink != "") {
-        qDebug("Restoring PulseAudio default sink to '%s'", m_defaultsink.c_str());
-        o = pa_context_set_default_sink(m_context, m_defaultsink.c_str(), success_cb, this);
-        if (!handleOperation(o, "pa_context_set_default_sink"))
+    if (m_defaultsink != "" && m_defaultsink != m_currentsink) {
+        qCDebug(lcAudio, "Restoring PulseAudio default sink to '%s'", m_defaultsink.c_str());
+        if (!queueOperation(operations, pa_context_set_default_sink(m_context,
+                m_defaultsink.c_str(), success_cb, this), "pa_context_set_default_sink"))
             return;
     }
-    if (m_defaultsource != "") {
-        qDebug("Restoring PulseAudio default source to '%s'", m_defaultsource.c_str());
-        o = pa_context_set_default_source(m_context, m_defaultsource.c_str(), success_cb, this);
-        if (!handleOperation(o, "pa_context_set_default_source"))
+    if (m_defaultsource != "" && m_defaultsource != m_currentsource) {
+        qCDebug(lcAudio, "Restoring PulseAudio default source to '%s'", m_defaultsource.c_str());
+        if (!queueOperation(operations, pa_context_set_default_source(m_context,
+                m_defaultsource.c_str(), success_cb, this), "pa_context_set_default_source"))
             return;
     }
 
+    waitForOperations(operations);
+
     pa_threaded_mainloop_unlock(m_mainLoop);
 }
 
@@ -535,12 +665,16 @@ void QPulseAudioEngineWorker::setCallMode(CallStatus callstatus, AudioMode audio
     CallStatus p_callstatus = m_callstatus;
     AudioMode p_audiomode = m_audiomode;
     AudioModes p_availableAudioModes = m_availableAudioModes;
+    std::vector<pa_operation*> operations;
+    std::map<uint32_t, PulseDevice>::iterator it;
     pa_operation *o;
+    QElapsedTimer timer;
+    timer.start();
 
     /* Check if we need to save the current pulseaudio state (e.g. when starting a call) */
     if ((callstatus != CallEnded) && (p_callstatus == CallEnded)) {
         if (setupVoiceCall() < 0) {
-            qCritical("Failed to setup PulseAudio for Voice Call");
+            qCCritical(lcAudio, "Failed to setup PulseAudio for Voice Call");
             return;
         }
     }
@@ -553,68 +687,90 @@ void QPulseAudioEngineWorker::setCallMode(CallStatus callstatus, AudioMode audio
 
     /* Switch the virtual card mode when call is active and not active
      * This needs to be done before sink/source gets updated, because after changing mode
-     * it will automatically move to input/output-parking */
+     * it will automatically move to input/output-parking, so once it is done the
+     * sinks and sources need to be refreshed before deciding on the ports */
+    bool profileChanged = false;
     if ((m_callstatus == CallActive) && (p_callstatus != CallActive) &&
             (m_voicecallcard != "") && (m_voicecallprofile != "")) {
-        qDebug("Setting PulseAudio card '%s' profile '%s'",
+        qCDebug(lcAudio, "Setting PulseAudio card '%s' profile '%s'",
                 m_voicecallcard.c_str(), m_voicecallprofile.c_str());
         o = pa_context_set_card_profile_by_name(m_context,
                 m_voicecallcard.c_str(), m_voicecallprofile.c_str(), success_cb, this);
         if (!handleOperation(o, "pa_context_set_card_profile_by_name"))
             return;
+        profileChanged = true;
     } else if ((m_callstatus == CallEnded) && (m_voicecallcard != "") && (m_voicecallhighest != "")) {
         /* If using droid, make sure to restore to the profile that has the highest score */
-        qDebug("Restoring PulseAudio card '%s' to profile '%s'",
+        qCDebug(lcAudio, "Restoring PulseAudio card '%s' to profile '%s'",
                 m_voicecallcard.c_str(), m_voicecallhighest.c_str());
         o = pa_context_set_card_profile_by_name(m_context,
             m_voicecallcard.c_str(), m_voicecallhighest.c_str(), success_cb, this);
         if (!handleOperation(o, "pa_context_set_card_profile_by_name"))
             return;
+        profileChanged = true;
     }
 
+    if (profileChanged && !refreshDevices())
+        return;
+
     /* Find highest compatible sink/source elements from the voicecall
-       compatible card (on touch this means the pulse droid element) */
+       compatible card (on touch this means the pulse droid element), and
+       only send the requests that actually change something */
     m_nametoset = m_valuetoset = "";
-    o = pa_context_get_sink_info_list(m_context, sinkinfo_cb, this);
-    if (!handleOperation(o, "pa_context_get_sink_info_list"))
-        return;
-    if ((m_nametoset != "") && (m_nametoset != m_defaultsink)) {
-        qDebug("Setting PulseAudio default sink to '%s'", m_nametoset.c_str());
-        o = pa_context_set_default_sink(m_context, m_nametoset.c_str(), success_cb, this);
-        if (!handleOperation(o, "pa_context_set_default_sink"))
+    for (it = m_sinks.begin(); it != m_sinks.end(); ++it)
+        sinkInfoCallback(it->second);
+    if ((m_nametoset != "") && (m_nametoset != m_currentsink)) {
+        qCDebug(lcAudio, "Setting PulseAudio default sink to '%s'", m_nametoset.c_str());
+        if (!queueOperation(operations, pa_context_set_default_sink(m_context,
+                m_nametoset.c_str(), success_cb, this), "pa_context_set_default_sink"))
             return;
+        m_currentsink = m_nametoset;
     }
     if (m_valuetoset != "") {
-        qDebug("Setting PulseAudio sink '%s' port '%s'",
+        qCDebug(lcAudio, "Setting PulseAudio sink '%s' port '%s'",
                 m_nametoset.c_str(), m_valuetoset.c_str());
-        o = pa_context_set_sink_port_by_name(m_context, m_nametoset.c_str(),
-                                             m_valuetoset.c_str(), success_cb, this);
-        if (!handleOperation(o, "pa_context_set_sink_port_by_name"))
+        if (!queueOperation(operations, pa_context_set_sink_port_by_name(m_context, m_nametoset.c_str(),
+                m_valuetoset.c_str(), success_cb, this), "pa_context_set_sink_port_by_name"))
             return;
+        /* Assume the change succeeds until the server tells otherwise */
+        for (it = m_sinks.begin(); it != m_sinks.end(); ++it) {
+            if (it->second.name == m_nametoset)
+                it->second.activePort = m_valuetoset;
+        }
     }
 
     /* Same for source */
     m_nametoset = m_valuetoset = "";
-    o = pa_context_get_source_info_list(m_context, sourceinfo_cb, this);
-    if (!handleOperation(o, "pa_context_get_source_info_list"))
-        return;
-    if ((m_nametoset != "") && (m_nametoset != m_defaultsource)) {
-        qDebug("Setting PulseAudio default source to '%s'", m_nametoset.c_str());
-        o = pa_context_set_default_source(m_context, m_nametoset.c_str(), success_cb, this);
-        if (!handleOperation(o, "pa_context_set_default_source"))
+    for (it = m_sources.begin(); it != m_sources.end(); ++it)
+        sourceInfoCallback(it->second);
+    if ((m_nametoset != "") && (m_nametoset != m_currentsource)) {
+        qCDebug(lcAudio, "Setting PulseAudio default source to '%s'", m_nametoset.c_str());
+        if (!queueOperation(operations, pa_context_set_default_source(m_context,
+                m_nametoset.c_str(), success_cb, this), "pa_context_set_default_source"))
             return;
+        m_currentsource = m_nametoset;
     }
     if (m_valuetoset != "") {
-        qDebug("Setting PulseAudio source '%s' port '%s'",
+        qCDebug(lcAudio, "Setting PulseAudio source '%s' port '%s'",
                 m_nametoset.c_str(), m_valuetoset.c_str());
-        o = pa_context_set_source_port_by_name(m_context, m_nametoset.c_str(),
-                                               m_valuetoset.c_str(), success_cb, this);
-        if (!handleOperation(o, "pa_context_set_source_port_by_name"))
+        if (!queueOperation(operations, pa_context_set_source_port_by_name(m_context, m_nametoset.c_str(),
+                m_valuetoset.c_str(), success_cb, this), "pa_context_set_source_port_by_name"))
             return;
+        for (it = m_sources.begin(); it != m_sources.end(); ++it) {
+            if (it->second.name == m_nametoset)
+                it->second.activePort = m_valuetoset;
+        }
     }
 
+    size_t operationCount = operations.size();
+    waitForOperations(operations);
+
     pa_threaded_mainloop_unlock(m_mainLoop);
 
+    qCDebug(lcAudio, "PulseAudio route switched to mode %d (call status %d) in %lld ms, %d request(s)%s",
+           m_audiomode, m_callstatus, timer.elapsed(), int(operationCount),
+           profileChanged ? " after a card profile change" : "");
+
     /* Notify if the list of audio modes changed */
     if (p_availableAudioModes != m_availableAudioModes)
         Q_EMIT availableAudioModesChanged(m_availableAudioModes);
@@ -639,7 +795,7 @@ void QPulseAudioEngineWorker::setMicMute(bool muted)
     if (!createPulseContext()) {
        return;
     }
- 
+
     m_micmute = muted;
 
     if (m_callstatus == CallEnded)
@@ -648,14 +804,13 @@ void QPulseAudioEngineWorker::setMicMute(bool muted)
     pa_threaded_mainloop_lock(m_mainLoop);
 
     m_nametoset = "";
-    pa_operation *o = pa_context_get_source_info_list(m_context, sourceinfo_cb, this);
-    if (!handleOperation(o, "pa_context_get_source_info_list"))
-        return;
+    for (std::map<uint32_t, PulseDevice>::const_iterator it = m_sources.begin(); it != m_sources.end(); ++it)
+        sourceInfoCallback(it->second);
 
     if (m_nametoset != "") {
         int m = m_micmute ? 1 : 0;
-        qDebug("Setting PulseAudio source '%s' muted '%d'", m_nametoset.c_str(), m);
-        o = pa_context_set_source_mute_by_name(m_context, 
+        qCDebug(lcAudio, "Setting PulseAudio source '%s' muted '%d'", m_nametoset.c_str(), m);
+        pa_operation *o = pa_context_set_source_mute_by_name(m_context,
             m_nametoset.c_str(), m, success_cb, this);
         if (!handleOperation(o, "pa_context_set_source_mute_by_name"))
             return;
@@ -664,26 +819,26 @@ void QPulseAudioEngineWorker::setMicMute(bool muted)
     pa_threaded_mainloop_unlock(m_mainLoop);
 }
 
-void QPulseAudioEngineWorker::plugCardCallback(const pa_card_info *info)
+void QPulseAudioEngineWorker::plugCardCallback(const PulseCard &card)
 {
-    qDebug("Notified about card (%s) add event from PulseAudio", info->name);
+    qCDebug(lcAudio, "Notified about card (%s) add event from PulseAudio", card.name.c_str());
 
     /* Check if it's indeed a BT device (with at least one hsp profile) */
-    pa_card_profile_info2 *hsp = NULL, *a2dp = NULL;
-    for (int i = 0; i < info->n_profiles; i++) {
-        if (!strcmp(info->profiles2[i]->name, PULSEAUDIO_PROFILE_HSP))
-            hsp = info->profiles2[i];
-        else if (!strcmp(info->profiles2[i]->name, PULSEAUDIO_PROFILE_A2DP) && 
-                  info->profiles2[i]->available != 0) {
-            qDebug("Found a2dp");
-            a2dp = info->profiles2[i];
+    const PulseProfile *hsp = NULL, *a2dp = NULL;
+    for (size_t i = 0; i < card.profiles.size(); i++) {
+        const PulseProfile &profile = card.profiles[i];
+        if (profile.name == PULSEAUDIO_PROFILE_HSP)
+            hsp = &profile;
+        else if (profile.name == PULSEAUDIO_PROFILE_A2DP && profile.available != 0) {
+            qCDebug(lcAudio, "Found a2dp");
+            a2dp = &profile;
         }
-        qDebug("%s", info->profiles2[i]->name);
+        qCDebug(lcAudio, "%s", profile.name.c_str());
     }
 
-    if ((!info->active_profile || !strcmp(info->active_profile->name, "off")) && a2dp) {
-        qDebug("No profile set");
-        m_default_bt_card_fallback = info->name;
+    if ((card.activeProfile == "" || card.activeProfile == "off") && a2dp) {
+        qCDebug(lcAudio, "No profile set");
+        m_default_bt_card_fallback = card.name;
     }
 
     /* We only care about BT (HSP) devices, and if one is not already available */
@@ -693,42 +848,41 @@ void QPulseAudioEngineWorker::plugCardCallback(const pa_card_info *info)
     }
 }
 
-void QPulseAudioEngineWorker::updateCardCallback(const pa_card_info *info)
+void QPulseAudioEngineWorker::updateCardCallback(const PulseCard &card)
 {
-    qDebug("Notified about card (%s) changes event from PulseAudio", info->name);
+    qCDebug(lcAudio, "Notified about card (%s) changes event from PulseAudio", card.name.c_str());
 
     /* Check if it's indeed a BT device (with at least one hsp profile) */
-    pa_card_profile_info2 *hsp = NULL, *a2dp = NULL;
-    for (int i = 0; i < info->n_profiles; i++) {
-        if (!strcmp(info->profiles2[i]->name, PULSEAUDIO_PROFILE_HSP))
-            hsp = info->profiles2[i];
-        else if (!strcmp(info->profiles2[i]->name, PULSEAUDIO_PROFILE_A2DP) && 
-                  info->profiles2[i]->available != 0) {
-            qDebug("Found a2dp");
-            a2dp = info->profiles2[i];
+    const PulseProfile *hsp = NULL, *a2dp = NULL;
+    for (size_t i = 0; i < card.profiles.size(); i++) {
+        const PulseProfile &profile = card.profiles[i];
+        if (profile.name == PULSEAUDIO_PROFILE_HSP)
+            hsp = &profile;
+        else if (profile.name == PULSEAUDIO_PROFILE_A2DP && profile.available != 0) {
+            qCDebug(lcAudio, "Found a2dp");
+            a2dp = &profile;
         }
-        qDebug("%s", info->profiles2[i]->name);
+        qCDebug(lcAudio, "%s", profile.name.c_str());
     }
 
-    if ((!info->active_profile || !strcmp(info->active_profile->name, "off")) && a2dp) {
-        qDebug("No profile set");
-        m_default_bt_card_fallback = info->name;
+    if ((card.activeProfile == "" || card.activeProfile == "off") && a2dp) {
+        qCDebug(lcAudio, "No profile set");
+        m_default_bt_card_fallback = card.name;
     }
 
 
     /* We only care if the card event for the voicecall capable card */
-    if ((m_callstatus == CallActive) && (!strcmp(info->name, m_voicecallcard.c_str()))) {
+    if ((m_callstatus == CallActive) && (card.name == m_voicecallcard)) {
         if (m_audiomode == AudioModeWiredHeadset) {
             /* If previous mode is wired, it means it got unplugged */
             m_handleevent = true;
             m_audiomodetoset = AudioModeBtOrWiredOrEarpiece;
         } else if ((m_audiomode == AudioModeEarpiece) || ((m_audiomode == AudioModeSpeaker))) {
             /* Now only trigger the event in case wired headset/headphone is now available */
-            pa_card_port_info *port_info = NULL;
-            for (int i = 0; i < info->n_ports; i++) {
-                if (info->ports[i] && (info->ports[i]->available == PA_PORT_AVAILABLE_YES) && (
-                            !strcmp(info->ports[i]->name, "output-wired_headset") ||
-                            !strcmp(info->ports[i]->name, "output-wired_headphone"))) {
+            for (size_t i = 0; i < card.ports.size(); i++) {
+                if ((card.ports[i].available == PA_PORT_AVAILABLE_YES) && (
+                            card.ports[i].name == "output-wired_headset" ||
+                            card.ports[i].name == "output-wired_headphone")) {
                     m_handleevent = true;
                     m_audiomodetoset = AudioModeWiredOrEarpiece;
                 }
@@ -748,72 +902,93 @@ void QPulseAudioEngineWorker::unplugCardCallback()
     }
 }
 
+void QPulseAudioEngineWorker::postCardEvent(int evt, unsigned int idx)
+{
+    m_pendingCardEvents.ref();
+    QMetaObject::invokeMethod(this, "handleCardEvent", Qt::QueuedConnection,
+                              Q_ARG(int, evt), Q_ARG(unsigned int, idx));
+}
+
 void QPulseAudioEngineWorker::handleCardEvent(const int evt, const unsigned int idx)
 {
     pa_operation *o = NULL;
 
-    /* Internal state var used to know if we need to update our internal state */
-    m_handleevent = false;
+    /* Card events come in bursts (BT reconnects, profile switches): the card
+     * state is tracked for each of them, but the call is only reconfigured
+     * once, after the last event already queued was handled */
+    bool lastInBurst = !m_pendingCardEvents.deref();
 
-    if (evt == PA_SUBSCRIPTION_EVENT_NEW) {
-        o = pa_context_get_card_info_by_index(m_context, idx, plug_card_cb, this);
-        if (!handleOperation(o, "pa_context_get_card_info_by_index"))
-            return;
+    if (!m_context) {
+        return;
+    }
 
-        if (m_default_bt_card_fallback != "") {
-            o = pa_context_set_card_profile_by_name(m_context,
-                m_default_bt_card_fallback.c_str(), PULSEAUDIO_PROFILE_A2DP, success_cb, this);
-            if (!handleOperation(o, "pa_context_set_card_profile_by_name"))
-                return;
-            m_default_bt_card_fallback = "";
-        }
+    /* Internal state var used to know if we need to update our internal state */
+    m_handleevent = false;
 
-        if (m_handleevent) {
-            qDebug("Adding new BT-HSP capable device");
-            /* In case A2DP is available, switch to HSP */
-            if (setupVoiceCall() < 0)
-                return;
-            /* Enable the HSP output port  */
-            setCallMode(m_callstatus, AudioModeBluetooth);
-        }
-    } else if (evt == PA_SUBSCRIPTION_EVENT_CHANGE) {
-        o = pa_context_get_card_info_by_index(m_context, idx, update_card_cb, this);
-        if (!handleOperation(o, "pa_context_get_card_info_by_index"))
-            return;
+    /* The model was already updated by the time the event gets here */
+    pa_threaded_mainloop_lock(m_mainLoop);
 
-        if (m_default_bt_card_fallback != "") {
-            o = pa_context_set_card_profile_by_name(m_context,
-                m_default_bt_card_fallback.c_str(), PULSEAUDIO_PROFILE_A2DP, success_cb, this);
-            if (!handleOperation(o, "pa_context_set_card_profile_by_name"))
-                return;
-            m_default_bt_card_fallback = "";
-        }
+    if (evt == PA_SUBSCRIPTION_EVENT_NEW || evt == PA_SUBSCRIPTION_EVENT_CHANGE) {
+        /* the card might have been removed in the meantime, the removal
+         * event will handle it */
+        std::map<uint32_t, PulseCard>::const_iterator card = m_cards.find(idx);
+        if (card != m_cards.end()) {
+            if (evt == PA_SUBSCRIPTION_EVENT_NEW) {
+                plugCardCallback(card->second);
+            } else {
+                updateCardCallback(card->second);
+            }
 
-        if (m_handleevent) {
-            /* In this case it means the handset state changed */
-            qDebug("Notifying card changes for the voicecall capable card");
-            setCallMode(m_callstatus, m_audiomodetoset);
+            if (m_default_bt_card_fallback != "") {
+                o = pa_context_set_card_profile_by_name(m_context,
+                    m_default_bt_card_fallback.c_str(), PULSEAUDIO_PROFILE_A2DP, success_cb, this);
+                if (!handleOperation(o, "pa_context_set_card_profile_by_name"))
+                    return;
+                m_default_bt_card_fallback = "";
+            }
         }
     } else if (evt == PA_SUBSCRIPTION_EVENT_REMOVE) {
         /* Check if the main HSP card was removed */
-        if (m_bt_hsp != "") {
-            o = pa_context_get_card_info_by_name(m_context, m_bt_hsp.c_str(), unplug_card_cb, this);
-            if (!handleOperation(o, "pa_context_get_sink_info_by_name"))
-                return;
-        }
-        if (m_bt_hsp_a2dp != "") {
-            o = pa_context_get_card_info_by_name(m_context, m_bt_hsp_a2dp.c_str(), unplug_card_cb, this);
-            if (!handleOperation(o, "pa_context_get_sink_info_by_name"))
-                return;
-        }
-        if (m_handleevent) {
-            qDebug("Notifying about BT-HSP card removal");
-            /* Needed in order to save the default sink/source */
-            if (setupVoiceCall() < 0)
-                return;
-            /* Enable the default handset output port  */
-            setCallMode(m_callstatus, AudioModeWiredOrEarpiece);
+        bool hspFound = false, hspA2dpFound = false;
+        for (std::map<uint32_t, PulseCard>::const_iterator it = m_cards.begin(); it != m_cards.end(); ++it) {
+            hspFound |= it->second.name == m_bt_hsp;
+            hspA2dpFound |= it->second.name == m_bt_hsp_a2dp;
         }
+        if ((m_bt_hsp != "" && !hspFound) || (m_bt_hsp_a2dp != "" && !hspA2dpFound))
+            unplugCardCallback();
+    }
+
+    pa_threaded_mainloop_unlock(m_mainLoop);
+
+    /* A plug or unplug decides the route, a plain change only needs the
+     * current one to be applied again */
+    if (m_handleevent && (evt != PA_SUBSCRIPTION_EVENT_CHANGE || m_pendingCardAction < 0))
+        m_pendingCardAction = evt;
+
+    if (!lastInBurst || m_pendingCardAction < 0)
+        return;
+
+    int action = m_pendingCardAction;
+    m_pendingCardAction = -1;
+
+    if (action == PA_SUBSCRIPTION_EVENT_NEW) {
+        qCDebug(lcAudio, "Adding new BT-HSP capable device");
+        /* In case A2DP is available, switch to HSP */
+        if (setupVoiceCall() < 0)
+            return;
+        /* Enable the HSP output port  */
+        setCallMode(m_callstatus, AudioModeBluetooth);
+    } else if (action == PA_SUBSCRIPTION_EVENT_CHANGE) {
+        /* In this case it means the handset state changed */
+        qCDebug(lcAudio, "Notifying card changes for the voicecall capable card");
+        setCallMode(m_callstatus, m_audiomodetoset);
+    } else if (action == PA_SUBSCRIPTION_EVENT_REMOVE) {
+        qCDebug(lcAudio, "Notifying about BT-HSP card removal");
+        /* Needed in order to save the default sink/source */
+        if (setupVoiceCall() < 0)
+            return;
+        /* Enable the default handset output port  */
+        setCallMode(m_callstatus, AudioModeWiredOrEarpiece);
     }
 }
 
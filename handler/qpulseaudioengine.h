@@ -22,8 +22,12 @@
 
 #include <QtCore/qmap.h>
 #include <QtCore/qbytearray.h>
+#include <QAtomicInt>
 #include <QThread>
 #include <pulse/pulseaudio.h>
+#include <map>
+#include <string>
+#include <vector>
 
 enum AudioMode {
     AudioModeEarpiece = 0x0001,
@@ -51,6 +55,36 @@ Q_DECLARE_METATYPE(CallStatus)
 
 QT_BEGIN_NAMESPACE
 
+class QPulseAudioEngineTestAccess;
+
+/* In-memory model of the PulseAudio objects we route calls with. It is filled
+ * once when the context connects and kept up to date from subscription events,
+ * so route changes don't need to query the server first. */
+struct PulsePort {
+    std::string name;
+    int available;
+};
+
+struct PulseProfile {
+    std::string name;
+    uint32_t priority;
+    int available;
+};
+
+struct PulseCard {
+    std::string name;
+    std::string activeProfile;
+    std::vector<PulseProfile> profiles;
+    std::vector<PulsePort> ports;
+};
+
+struct PulseDevice {
+    std::string name;
+    std::string activePort;
+    std::vector<PulsePort> ports;
+    bool isMonitor;
+};
+
 class QPulseAudioEngineWorker : public QObject
 {
     Q_OBJECT
@@ -64,14 +98,14 @@ public:
     bool createPulseContext(void);
     int setupVoiceCall(void);
     void restoreVoiceCall(void);
-    /* Callbacks to be used internally */
-    void cardInfoCallback(const pa_card_info *card);
-    void sinkInfoCallback(const pa_sink_info *sink);
-    void sourceInfoCallback(const pa_source_info *source);
-    void serverInfoCallback(const pa_server_info *server);
-    void plugCardCallback(const pa_card_info *card);
-    void updateCardCallback(const pa_card_info *card);
-    void unplugCardCallback();
+    /* Callbacks to be used internally, called with the mainloop locked */
+    void updateCardCache(const pa_card_info *card);
+    void updateSinkCache(const pa_sink_info *sink);
+    void updateSourceCache(const pa_source_info *source);
+    void updateServerCache(const pa_server_info *server);
+    void removeFromCache(pa_subscription_event_type_t facility, uint32_t idx);
+    /* Queues a card event to the worker thread, callable from any thread */
+    void postCardEvent(int evt, unsigned int idx);
 
 Q_SIGNALS:
     void audioModeChanged(const AudioMode mode);
@@ -96,10 +130,25 @@ private:
     std::string m_defaultsink, m_defaultsource;
     std::string m_bt_hsp, m_bt_hsp_a2dp;
     std::string m_default_bt_card_fallback;
+    QAtomicInt m_pendingCardEvents;
+    int m_pendingCardAction;
     std::string m_voicecallcard, m_voicecallhighest, m_voicecallprofile;
+    std::string m_currentsink, m_currentsource;
+    std::map<uint32_t, PulseCard> m_cards;
+    std::map<uint32_t, PulseDevice> m_sinks, m_sources;
 
     bool handleOperation(pa_operation *operation, const char *func_name);
+    bool queueOperation(std::vector<pa_operation*> &operations, pa_operation *operation, const char *func_name);
+    void waitForOperations(std::vector<pa_operation*> &operations);
+    bool refreshDevices(void);
     void releasePulseContext(void);
+
+    void cardInfoCallback(const PulseCard &card);
+    void sinkInfoCallback(const PulseDevice &sink);
+    void sourceInfoCallback(const PulseDevice &source);
+    void plugCardCallback(const PulseCard &card);
+    void updateCardCallback(const PulseCard &card);
+    void unplugCardCallback();
 };
 
 class QPulseAudioEngine : public QObject
@@ -117,6 +166,8 @@ Q_SIGNALS:
     void audioModeChanged(const AudioMode mode);
     void availableAudioModesChanged(const AudioModes modes);
 private:
+    friend class QPulseAudioEngineTestAccess;
+
     QPulseAudioEngineWorker *mWorker;
     QThread mThread;
 };
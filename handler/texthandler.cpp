@@ -27,6 +27,7 @@
 #include "dbustypes.h"
 #include "accountentry.h"
 #include "chatstartingjob.h"
+#include "telephonylogging.h"
 
 #include <QImage>
 #include <TelepathyQt/ContactManager>
@@ -147,17 +148,17 @@ bool TextHandler::destroyTextChannel(const QString &objectPath)
 
 bool TextHandler::changeRoomTitle(const QString &objectPath, const QString &title)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcHandlerText) << __PRETTY_FUNCTION__;
     Tp::TextChannelPtr channel = existingChannelFromObjectPath(objectPath);
     if (!channel) {
-        qWarning() << "Could not find channel for object path" << objectPath;
+        qCWarning(lcHandlerText) << "Could not find channel for object path" << objectPath;
         return false;
     }
 
     Tp::Client::ChannelInterfaceRoomConfigInterface *roomConfigInterface;
     roomConfigInterface = channel->optionalInterface<Tp::Client::ChannelInterfaceRoomConfigInterface>();
     if (!roomConfigInterface) {
-        qWarning() << "Could not find RoomConfig interface in the channel" << objectPath;
+        qCWarning(lcHandlerText) << "Could not find RoomConfig interface in the channel" << objectPath;
         return false;
     }
 
@@ -176,7 +177,7 @@ void TextHandler::onTextChannelInvalidated()
 
 void TextHandler::onTextChannelAvailable(Tp::TextChannelPtr channel)
 {
-    qDebug() << "TextHandler::onTextChannelAvailable" << channel;
+    qCDebug(lcHandlerText) << "TextHandler::onTextChannelAvailable" << channel;
     AccountEntry *account = TelepathyHelper::instance()->accountForConnection(channel->connection());
     if (!account) {
         return;
@@ -24,6 +24,7 @@
 #include "indicatordbus.h"
 #include "indicatoradaptor.h"
 #include "messagingmenu.h"
+#include "telephonylogging.h"
 
 // Qt
 #include <QtDBus/QDBusConnection>
@@ -58,3 +59,8 @@ void IndicatorDBus::ClearCallNotification(const QString &targetId, const QString
     MessagingMenu::instance()->removeCall(targetId, accountId);
 }
 
+void IndicatorDBus::SetLoggingRules(const QString &rules)
+{
+    setTelephonyLoggingRules(rules);
+}
+
@@ -44,6 +44,7 @@ public:
 public Q_SLOTS:
     Q_NOREPLY void ClearNotifications();
     Q_NOREPLY void ClearCallNotification(const QString &targetId, const QString &accountId);
+    Q_NOREPLY void SetLoggingRules(const QString &rules);
 
 Q_SIGNALS:
     void clearNotificationsRequested();
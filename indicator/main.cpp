@@ -32,6 +32,7 @@
 #include "voicemailindicator.h"
 #include "ussdindicator.h"
 #include "authhandler.h"
+#include "telephonylogging.h"
 #include <QCoreApplication>
 #include <TelepathyQt/ClientRegistrar>
 #include <TelepathyQt/AbstractClient>
@@ -56,7 +57,7 @@ int main(int argc, char **argv)
 
     // check if there is already an instance of the indicator running
     if (ApplicationUtils::checkApplicationRunning(TP_QT_IFACE_CLIENT + ".TelephonyServiceIndicator")) {
-        qDebug() << "Found another instance of the indicator. Quitting.";
+        qCInfo(lcIndicator) << "Found another instance of the indicator. Quitting.";
         return 1;
     }
 
@@ -29,6 +29,7 @@
 #include "telepathyhelper.h"
 #include "accountentry.h"
 #include "ofonoaccountentry.h"
+#include "telephonylogging.h"
 #include <QContactAvatar>
 #include <QContactFetchRequest>
 #include <QContactFilter>
@@ -245,7 +246,7 @@ void MessagingMenu::addMessage(NotificationData notificationData)
             icon = g_file_icon_new(file);
         }
 
-        qDebug() << "notify message received:" << notificationData.encodedEventId.toUtf8();
+        qCDebug(lcIndicator) << "notify message received:" << notificationData.encodedEventId.toUtf8();
         MessagingMenuMessage *message = messaging_menu_message_new(notificationData.encodedEventId.toUtf8().data(),
                                                                    icon,
                                                                    displayLabel.toUtf8().data(),
@@ -291,7 +292,7 @@ void MessagingMenu::removeMessage(const QString &messageId)
 
 void MessagingMenu::addCallToMessagingMenu(Call call, const QString &text, bool supportsTextReply)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcIndicator) << __PRETTY_FUNCTION__;
     GVariant *messages = NULL;
     GFile *file = g_file_new_for_uri(call.contactIcon.toString().toUtf8().data());
     GIcon *icon = g_file_icon_new(file);
@@ -337,7 +338,7 @@ void MessagingMenu::addCallToMessagingMenu(Call call, const QString &text, bool
 
 void MessagingMenu::addCall(const QString &targetId, const QString &accountId, const QDateTime &timestamp)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcIndicator) << __PRETTY_FUNCTION__;
     Call call;
     bool found = false;
     AccountEntry *account = TelepathyHelper::instance()->accountForId(accountId);
@@ -432,7 +433,7 @@ void MessagingMenu::removeCall(const QString &targetId, const QString &accountId
     bool found = false;
     AccountEntry *account = TelepathyHelper::instance()->accountForId(accountId);
     if (!account) {
-        qWarning() << "Account not found for id" << accountId;
+        qCWarning(lcIndicator) << "Account not found for id" << accountId;
         return;
     }
 
@@ -582,9 +583,9 @@ void MessagingMenu::callBack(const QString &messageId)
     Call call = callFromMessageId(messageId);
     AccountEntry *account = TelepathyHelper::instance()->accountForId(call.accountId);
     if (!account) {
-        qWarning() << "Could not find the account originating the call";
+        qCWarning(lcIndicator) << "Could not find the account originating the call";
     }
-    qDebug() << "TelephonyService/MessagingMenu: Calling back" << call.targetId;
+    qCDebug(lcIndicator) << "TelephonyService/MessagingMenu: Calling back" << call.targetId;
     // FIXME: support accounts not based on phone numbers
     // FIXME: hardcoding SIP protocol as using phone numbers, at some point it would be better to change the CM to report that
     // another idea is to use protocol-aware fields, like sip:// for example
@@ -596,7 +597,7 @@ void MessagingMenu::callBack(const QString &messageId)
 void MessagingMenu::replyWithMessage(const QString &messageId, const QString &reply)
 {
     Call call = callFromMessageId(messageId);
-    qDebug() << "TelephonyService/MessagingMenu: Replying to call" << call.targetId << "with text" << reply;
+    qCDebug(lcIndicator) << "TelephonyService/MessagingMenu: Replying to call" << call.targetId << "with text" << reply;
     NotificationData data;
     data.participantIds << call.targetId;
     data.accountId = call.accountId;
@@ -613,7 +614,7 @@ void MessagingMenu::callVoicemail(const QString &messageId)
         voicemailNumber = ofonoAccount->voicemailNumber();
     }
 
-    qDebug() << "TelephonyService/MessagingMenu: Calling voicemail for messageId" << messageId;
+    qCDebug(lcIndicator) << "TelephonyService/MessagingMenu: Calling voicemail for messageId" << messageId;
     if (!voicemailNumber.isEmpty()) {
         // FIXME: we need to specify which account to use
         ApplicationUtils::openUrl(QUrl(QString("tel:///%1").arg(voicemailNumber)));
@@ -21,6 +21,7 @@
  */
 
 #include "metrics.h"
+#include "telephonylogging.h"
 #include <QDebug>
 
 const QString APP_ID = QString("telephony-service");
@@ -50,7 +51,7 @@ Metrics::Metrics(QObject *parent) :
         mMetrics[CallDurations] = mMetricManager->add(MetricParameters(DIALER_CALL_DURATION_STATISTICS_ID).formatString(GettextMarkExtraction("Spent <b>%1</b> minutes in calls today"))
                                                       .emptyDataString(GettextMarkExtraction("No calls made today")).textDomain(APP_ID).minimum(0.0));
     } catch(std::exception &e) {
-        qWarning() << "Error connecting to metrics service:" << e.what();
+        qCWarning(lcIndicator) << "Error connecting to metrics service:" << e.what();
     }
 }
 
@@ -70,6 +71,6 @@ void Metrics::increment(Metrics::MetricType metric, double amount)
     try {
         metricPtr->increment(amount);
     } catch(std::exception &e) {
-        qWarning() << "Error incrementing telephony metric:" << e.what();
+        qCWarning(lcIndicator) << "Error incrementing telephony metric:" << e.what();
     }
 }
@@ -29,11 +29,13 @@
 #include "callmanager.h"
 #include "config.h"
 #include "contactutils.h"
+#include "flowtracer.h"
 #include "ringtone.h"
 #include "telepathyhelper.h"
 #include "phoneutils.h"
 #include "accountentry.h"
 #include "ofonoaccountentry.h"
+#include "telephonylogging.h"
 #include <TelepathyQt/AvatarData>
 #include <TelepathyQt/TextChannel>
 #include <TelepathyQt/ReceivedMessage>
@@ -137,7 +139,7 @@ QVariantMap getInterfaceProperties(const Tp::AbstractInterface *interface)
     QDBusInterface propsInterface(interface->service(), interface->path(), "org.freedesktop.DBus.Properties");
     QDBusReply<QVariantMap> reply = propsInterface.call("GetAll", interface->interface());
     if (!reply.isValid()) {
-        qWarning() << "Failed to fetch channel properties for interface" << interface->interface() << reply.error().message();
+        qCWarning(lcIndicator) << "Failed to fetch channel properties for interface" << interface->interface() << reply.error().message();
     }
     return reply.value();
 }
@@ -257,7 +259,7 @@ void TextChannelObserver::sendMessage(NotificationData notificationData)
 
         GError *error = NULL;
         if (!notify_notification_show(notification, &error)) {
-            qWarning() << "Failed to show message notification:" << error->message;
+            qCWarning(lcIndicator) << "Failed to show message notification:" << error->message;
             g_error_free (error);
         }
 
@@ -331,7 +333,7 @@ void TextChannelObserver::showNotificationForNewGroup(const History::Thread &thr
 
     GError *error = NULL;
     if (!notify_notification_show(notification, &error)) {
-        qWarning() << "Failed to show message notification:" << error->message;
+        qCWarning(lcIndicator) << "Failed to show message notification:" << error->message;
         g_error_free (error);
     }
 
@@ -384,7 +386,7 @@ void TextChannelObserver::showNotificationForFlashMessage(const Tp::ReceivedMess
 
     GError *error = NULL;
     if (!notify_notification_show(notification, &error)) {
-        qWarning() << "Failed to show message notification:" << error->message;
+        qCWarning(lcIndicator) << "Failed to show message notification:" << error->message;
         g_error_free (error);
     }
 
@@ -609,7 +611,7 @@ void TextChannelObserver::showNotificationForMessage(const Tp::TextChannelPtr ch
 
     GError *error = NULL;
     if (!notify_notification_show(notification, &error)) {
-        qWarning() << "Failed to show message notification:" << error->message;
+        qCWarning(lcIndicator) << "Failed to show message notification:" << error->message;
         g_error_free (error);
     }
 
@@ -646,7 +648,7 @@ void TextChannelObserver::updateNotifications(const QContact &contact)
 
                 GError *error = NULL;
                 if (!notify_notification_show(notification, &error)) {
-                    qWarning() << "Failed to show message notification:" << error->message;
+                    qCWarning(lcIndicator) << "Failed to show message notification:" << error->message;
                     g_error_free (error);
                 }
             }
@@ -706,7 +708,7 @@ void TextChannelObserver::onTextChannelInvalidated()
 void TextChannelObserver::processMessageReceived(const Tp::ReceivedMessage &message, const Tp::TextChannelPtr &textChannel)
 {
     if (textChannel.isNull()) {
-        qDebug() << "TextChannelObserver::processMessageReceived: no text channel";
+        qCDebug(lcIndicator) << "TextChannelObserver::processMessageReceived: no text channel";
         return;
     }
 
@@ -811,7 +813,7 @@ void TextChannelObserver::onReplyReceived(NotificationData notificationData)
 
         GError *error = NULL;
         if (!notify_notification_show(notification, &error)) {
-            qWarning() << "Failed to show message notification:" << error->message;
+            qCWarning(lcIndicator) << "Failed to show message notification:" << error->message;
             g_error_free (error);
         }
         return;
@@ -830,9 +832,13 @@ void TextChannelObserver::onMessageRead(NotificationData notificationData)
     ChatManager::instance()->acknowledgeMessage(properties);
 }
 
-void TextChannelObserver::onMessageSent(Tp::Message, Tp::MessageSendingFlags, QString)
+void TextChannelObserver::onMessageSent(Tp::Message message, Tp::MessageSendingFlags, QString)
 {
     Metrics::instance()->increment(Metrics::SentMessages);
+    if (FlowTracer::instance()->isEnabled()) {
+        QString traceId = message.header()[TRACE_ID_PROPERTY].variant().toString();
+        FlowTracer::instance()->instant(traceId, "message-sent-observed");
+    }
 }
 
 void TextChannelObserver::onThreadsAdded(History::Threads threads)
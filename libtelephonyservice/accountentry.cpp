@@ -20,8 +20,11 @@
  */
 
 #include <TelepathyQt/PendingOperation>
+#include <QDBusArgument>
+#include <QDBusConnection>
 #include <QTimer>
 #include "accountentry.h"
+#include "handlersnapshot.h"
 #include "phoneutils.h"
 #include "protocolmanager.h"
 #include "telepathyhelper.h"
@@ -257,17 +260,39 @@ void AccountEntry::initialize()
     QMetaObject::invokeMethod(this, "onConnectionChanged", Qt::QueuedConnection, Q_ARG(Tp::ConnectionPtr, mAccount->connection()));
     QMetaObject::invokeMethod(this, "accountReady", Qt::QueuedConnection);
 
-    // FIXME: change it to be asynchronous
     if (QCoreApplication::applicationName() != "telephony-service-handler") {
-        QDBusReply<QVariantMap> reply = TelepathyHelper::instance()->handlerInterface()->call("GetAccountProperties", mAccount->uniqueIdentifier());
+        // the account properties come in the handler snapshot, so creating the
+        // entries for all the accounts takes a single round trip
+        QDBusConnection::sessionBus().connect("com.canonical.TelephonyServiceHandler",
+                                              "/com/canonical/TelephonyServiceHandler",
+                                              "com.canonical.TelephonyServiceHandler",
+                                              "AccountPropertiesChanged",
+                                              this, SLOT(onAccountPropertiesChanged(QString,QVariantMap,qulonglong)));
+        connect(HandlerSnapshot::instance(), SIGNAL(loaded(QVariantMap)), SLOT(onHandlerSnapshotLoaded(QVariantMap)));
+        HandlerSnapshot::instance()->request();
+        return;
+    }
+    mReady = true;
+}
 
-        if (!reply.isValid()) {
-            return;
-        }
-        mAccountProperties = reply;
+void AccountEntry::onHandlerSnapshotLoaded(const QVariantMap &snapshot)
+{
+    QVariantMap allProperties = qdbus_cast<QVariantMap>(snapshot["accountProperties"]);
+    QVariantMap properties = qdbus_cast<QVariantMap>(allProperties[accountId()]);
+    mReady = true;
+    if (properties != mAccountProperties) {
+        mAccountProperties = properties;
         Q_EMIT accountPropertiesChanged();
     }
-    mReady = true;
+}
+
+void AccountEntry::onAccountPropertiesChanged(const QString &accountId, const QVariantMap &properties, qulonglong sequence)
+{
+    if (accountId != this->accountId() || !HandlerSnapshot::instance()->isNewer(sequence)) {
+        return;
+    }
+    mAccountProperties = properties;
+    Q_EMIT accountPropertiesChanged();
 }
 
 void AccountEntry::watchSelfContactPresence()
@@ -129,6 +129,8 @@ protected Q_SLOTS:
     virtual void watchSelfContactPresence();
     virtual void onConnectionChanged(Tp::ConnectionPtr connection);
     virtual void onSelfContactChanged();
+    void onHandlerSnapshotLoaded(const QVariantMap &snapshot);
+    void onAccountPropertiesChanged(const QString &accountId, const QVariantMap &properties, qulonglong sequence);
 
 protected:
     explicit AccountEntry(const Tp::AccountPtr &account, QObject *parent = 0);
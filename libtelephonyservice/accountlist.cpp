@@ -22,6 +22,7 @@
 #include "accountlist.h"
 #include "accountentry.h"
 #include "protocol.h"
+#include "protocolmanager.h"
 #include <QTimer>
 
 AccountList::AccountList(Protocol::Features features, const QString &protocol, QObject *parent)
@@ -60,25 +61,25 @@ AccountEntry *AccountList::allAccountsAt(QQmlListProperty<AccountEntry> *p, int
 int AccountList::activeAccountsCount(QQmlListProperty<AccountEntry> *p)
 {
     AccountList *accountList = qobject_cast<AccountList*>(p->object);
-    return accountList->activeAccounts().count();
+    return accountList->mActiveAccounts.count();
 }
 
 AccountEntry *AccountList::activeAccountsAt(QQmlListProperty<AccountEntry> *p, int index)
 {
     AccountList *accountList = qobject_cast<AccountList*>(p->object);
-    return accountList->activeAccounts()[index];
+    return accountList->mActiveAccounts[index];
 }
 
 int AccountList::displayedAccountsCount(QQmlListProperty<AccountEntry> *p)
 {
     AccountList *accountList = qobject_cast<AccountList*>(p->object);
-    return accountList->displayedAccounts().count();
+    return accountList->mDisplayedAccounts.count();
 }
 
 AccountEntry *AccountList::displayedAccountsAt(QQmlListProperty<AccountEntry> *p, int index)
 {
     AccountList *accountList = qobject_cast<AccountList*>(p->object);
-    return accountList->displayedAccounts()[index];
+    return accountList->mDisplayedAccounts[index];
 }
 
 QList<AccountEntry*> AccountList::accounts()
@@ -88,24 +89,12 @@ QList<AccountEntry*> AccountList::accounts()
 
 QList<AccountEntry*> AccountList::activeAccounts()
 {
-    QList<AccountEntry*> accounts;
-    for (auto account : mAccounts) {
-        if (account->active()) {
-            accounts << account;
-        }
-    }
-    return accounts;
+    return mActiveAccounts;
 }
 
 QList<AccountEntry*> AccountList::displayedAccounts()
 {
-    QList<AccountEntry*> accounts;
-    for (auto account : mAccounts) {
-        if (account->active() && account->protocolInfo()->showOnSelector()) {
-            accounts << account;
-        }
-    }
-    return accounts;
+    return mDisplayedAccounts;
 }
 
 void AccountList::init()
@@ -113,25 +102,89 @@ void AccountList::init()
     filterAccounts();
     connect(TelepathyHelper::instance(), &TelepathyHelper::accountsChanged,
             this, &AccountList::filterAccounts);
+    // queued, so that the accounts get their protocol info updated first
+    connect(ProtocolManager::instance(), &ProtocolManager::protocolsChanged,
+            this, &AccountList::refreshViews, Qt::QueuedConnection);
 }
 
 void AccountList::onActiveAccountsChanged()
 {
     AccountEntry *account = qobject_cast<AccountEntry*>(QObject::sender());
+    if (!account) {
+        return;
+    }
+
+    bool activeChanged = updateView(mActiveAccounts, account, account->active());
+    bool displayedChanged = updateView(mDisplayedAccounts, account, isDisplayed(account));
 
     Q_EMIT accountChanged(account, account->active());
-    Q_EMIT activeAccountsChanged();
-    Q_EMIT displayedAccountsChanged();
+    if (activeChanged) {
+        Q_EMIT activeAccountsChanged();
+    }
+    if (displayedChanged) {
+        Q_EMIT displayedAccountsChanged();
+    }
+}
+
+void AccountList::refreshViews()
+{
+    bool activeChanged = false;
+    bool displayedChanged = false;
+    for (auto account : mAccounts) {
+        activeChanged |= updateView(mActiveAccounts, account, account->active());
+        displayedChanged |= updateView(mDisplayedAccounts, account, isDisplayed(account));
+    }
+
+    if (activeChanged) {
+        Q_EMIT activeAccountsChanged();
+    }
+    if (displayedChanged) {
+        Q_EMIT displayedAccountsChanged();
+    }
+}
+
+bool AccountList::isDisplayed(AccountEntry *account) const
+{
+    return account->active() && account->protocolInfo() && account->protocolInfo()->showOnSelector();
+}
+
+bool AccountList::updateView(QList<AccountEntry*> &view, AccountEntry *account, bool include)
+{
+    int index = view.indexOf(account);
+    if (include == (index >= 0)) {
+        return false;
+    }
+
+    if (!include) {
+        view.removeAt(index);
+        return true;
+    }
+
+    // the view is an ordered subset of mAccounts, so find where the account goes
+    int position = 0;
+    for (auto entry : mAccounts) {
+        if (entry == account) {
+            break;
+        }
+        if (position < view.count() && view[position] == entry) {
+            position++;
+        }
+    }
+    view.insert(position, account);
+    return true;
 }
 
 void AccountList::filterAccounts()
 {
-    // FIXME: we need to watch for active changed on accounts
     for (auto account : mAccounts) {
         account->disconnect(this);
     }
 
+    QList<AccountEntry*> previousActive = mActiveAccounts;
+    QList<AccountEntry*> previousDisplayed = mDisplayedAccounts;
     mAccounts.clear();
+    mActiveAccounts.clear();
+    mDisplayedAccounts.clear();
     for (auto account : TelepathyHelper::instance()->accounts()) {
         // if the account doesn't have any of the required features, skip it
         if (!(account->protocolInfo()->features() & mFeatures)) {
@@ -146,9 +199,19 @@ void AccountList::filterAccounts()
         connect(account, &AccountEntry::activeChanged,
                 this, &AccountList::onActiveAccountsChanged);
         mAccounts << account;
+        if (account->active()) {
+            mActiveAccounts << account;
+        }
+        if (isDisplayed(account)) {
+            mDisplayedAccounts << account;
+        }
     }
 
     Q_EMIT allAccountsChanged();
-    Q_EMIT displayedAccountsChanged();
-    Q_EMIT activeAccountsChanged();
+    if (mDisplayedAccounts != previousDisplayed) {
+        Q_EMIT displayedAccountsChanged();
+    }
+    if (mActiveAccounts != previousActive) {
+        Q_EMIT activeAccountsChanged();
+    }
 }
@@ -61,11 +61,18 @@ protected Q_SLOTS:
     void init();
     void filterAccounts();
     void onActiveAccountsChanged();
+    void refreshViews();
 
 private:
+    bool isDisplayed(AccountEntry *account) const;
+    bool updateView(QList<AccountEntry*> &view, AccountEntry *account, bool include);
+
     Protocol::Features mFeatures;
     QString mProtocol;
     QList<AccountEntry*> mAccounts;
+    // filtered views of mAccounts, kept in the same order and updated incrementally
+    QList<AccountEntry*> mActiveAccounts;
+    QList<AccountEntry*> mDisplayedAccounts;
 };
 
 
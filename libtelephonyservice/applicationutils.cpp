@@ -20,6 +20,7 @@
  */
 
 #include "applicationutils.h"
+#include "telephonylogging.h"
 #include <QCoreApplication>
 #include <QDBusConnection>
 #include <QDBusConnectionInterface>
@@ -62,7 +63,7 @@ static void
 urlDispatchCallback (const gchar * url, gboolean success, gpointer user_data)
 {
     if (!success) {
-        qWarning() << "Fail to launch url:" << url;
+        qCWarning(lcTelephony) << "Fail to launch url:" << url;
     }
 }
 
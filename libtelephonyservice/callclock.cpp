@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "callclock.h"
+#include "callentry.h"
+
+#include <QDateTime>
+#include <QDBusConnection>
+
+CallClock *CallClock::instance()
+{
+    static CallClock *self = new CallClock();
+    return self;
+}
+
+CallClock::CallClock(QObject *parent) :
+    QObject(parent), mScreenOn(true)
+{
+    mTimer.setSingleShot(true);
+    mTimer.setTimerType(Qt::PreciseTimer);
+    connect(&mTimer, SIGNAL(timeout()), SLOT(onTick()));
+
+    QDBusConnection::systemBus().connect("com.canonical.Unity.Screen",
+                                         "/com/canonical/Unity/Screen",
+                                         "com.canonical.Unity.Screen",
+                                         "DisplayPowerStateChange",
+                                         this, SLOT(onDisplayPowerStateChanged(int,int)));
+}
+
+void CallClock::addCall(CallEntry *entry)
+{
+    mCalls.insert(entry);
+    refresh();
+}
+
+void CallClock::removeCall(CallEntry *entry)
+{
+    mCalls.remove(entry);
+    refresh();
+}
+
+void CallClock::refresh()
+{
+    bool watched = false;
+    Q_FOREACH(CallEntry *entry, mCalls) {
+        if (entry->isElapsedTimeWatched()) {
+            watched = true;
+            break;
+        }
+    }
+
+    bool run = mScreenOn && watched;
+    if (run == mTimer.isActive()) {
+        return;
+    }
+
+    if (!run) {
+        mTimer.stop();
+        return;
+    }
+
+    // the values shown might be stale after a pause
+    Q_FOREACH(CallEntry *entry, mCalls) {
+        Q_EMIT entry->elapsedTimeChanged();
+    }
+    scheduleTick();
+}
+
+void CallClock::onTick()
+{
+    Q_FOREACH(CallEntry *entry, mCalls) {
+        Q_EMIT entry->elapsedTimeChanged();
+    }
+    scheduleTick();
+}
+
+void CallClock::onDisplayPowerStateChanged(int state, int reason)
+{
+    Q_UNUSED(reason)
+
+    // state == 0 is power off
+    mScreenOn = state != 0;
+    refresh();
+}
+
+void CallClock::scheduleTick()
+{
+    // tick right after the next wall clock second
+    mTimer.start(1000 - QDateTime::currentMSecsSinceEpoch() % 1000);
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CALLCLOCK_H
+#define CALLCLOCK_H
+
+#include <QObject>
+#include <QSet>
+#include <QTimer>
+
+class CallEntry;
+
+/* Updates the elapsed time of all active calls from a single timer aligned
+ * to wall clock seconds. The timer only runs while the screen is on and some
+ * active call has its elapsed time watched, so it causes no wakeups otherwise. */
+class CallClock : public QObject
+{
+    Q_OBJECT
+
+public:
+    static CallClock *instance();
+
+    void addCall(CallEntry *entry);
+    void removeCall(CallEntry *entry);
+
+public Q_SLOTS:
+    // re-evaluates whether the clock needs to run
+    void refresh();
+
+private Q_SLOTS:
+    void onTick();
+    void onDisplayPowerStateChanged(int state, int reason);
+
+private:
+    explicit CallClock(QObject *parent = 0);
+    void scheduleTick();
+
+    QSet<CallEntry*> mCalls;
+    QTimer mTimer;
+    bool mScreenOn;
+};
+
+#endif // CALLCLOCK_H
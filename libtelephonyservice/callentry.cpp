@@ -20,30 +20,33 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "callclock.h"
 #include "callentry.h"
 #include "callmanager.h"
+#include "callstateproxy.h"
+#include "flowtracer.h"
 #include "telepathyhelper.h"
 #include "accountentry.h"
 #include "ofonoaccountentry.h"
+#include "telephonylogging.h"
 
-#include <QDBusReply>
+#include <QDBusConnection>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusVariant>
 #include <QTime>
 #include <TelepathyQt/Contact>
 #include <TelepathyQt/PendingReady>
 #include <TelepathyQt/Connection>
 
 #define TELEPATHY_MUTE_IFACE "org.freedesktop.Telepathy.Call1.Interface.Mute"
-#define TELEPATHY_CALL_IFACE "org.freedesktop.Telepathy.Channel.Type.Call1"
 #define DBUS_PROPERTIES_IFACE "org.freedesktop.DBus.Properties"
-#define PROPERTY_AUDIO_OUTPUTS "AudioOutputs"
-#define PROPERTY_ACTIVE_AUDIO_OUTPUT "ActiveAudioOutput"
 
 CallEntry::CallEntry(const Tp::CallChannelPtr &channel, QObject *parent) :
     QObject(parent),
     mChannel(channel),
     mVoicemail(false),
-    mLocalMuteState(false),
-    mMuteInterface(channel->busName(), channel->objectPath(), TELEPATHY_MUTE_IFACE)
+    mLocalMuteState(false)
 {
     qRegisterMetaType<AudioOutputDBus>();
     qRegisterMetaType<AudioOutputDBusList>();
@@ -52,27 +55,19 @@ CallEntry::CallEntry(const Tp::CallChannelPtr &channel, QObject *parent) :
     qDBusRegisterMetaType<AudioOutputDBusList>();
 
     mAccount = TelepathyHelper::instance()->accountForConnection(mChannel->connection());
-    setupCallChannel();
-
-    // connect to the DBus signal
-    connect(TelepathyHelper::instance()->handlerInterface(),
-            SIGNAL(CallPropertiesChanged(QString, QVariantMap)),
-            SLOT(onCallPropertiesChanged(QString,QVariantMap)));
-
-    connect(TelepathyHelper::instance()->handlerInterface(),
-            SIGNAL(CallHoldingFailed(QString)),
-            SLOT(onCallHoldingFailed(QString)));
 
-    connect(TelepathyHelper::instance()->handlerInterface(),
-            SIGNAL(ActiveAudioOutputChanged(QString)),
+    // the handler signals are routed to this entry by the proxy, which also
+    // has the audio outputs cached
+    CallStateProxy *proxy = CallStateProxy::instance();
+    proxy->registerCall(this);
+    connect(proxy,
+            SIGNAL(activeAudioOutputChanged(QString)),
             SLOT(onActiveAudioOutputChanged(QString)));
+    connect(proxy,
+            SIGNAL(audioOutputsChanged(AudioOutputDBusList)),
+            SLOT(onAudioOutputsChanged(AudioOutputDBusList)));
 
-    QDBusConnection::sessionBus().connect(TelepathyHelper::instance()->handlerInterface()->service(),
-                                          TelepathyHelper::instance()->handlerInterface()->path(),
-                                          TelepathyHelper::instance()->handlerInterface()->interface(),
-                                          "AudioOutputsChanged",
-                                          this,
-                                          SLOT(onAudioOutputsChanged(AudioOutputDBusList)));
+    setupCallChannel();
 
     // in case the account is an ofono account, we can check the voicemail number
     OfonoAccountEntry *ofonoAccount = qobject_cast<OfonoAccountEntry*>(mAccount);
@@ -80,18 +75,18 @@ CallEntry::CallEntry(const Tp::CallChannelPtr &channel, QObject *parent) :
         setVoicemail(phoneNumber() == ofonoAccount->voicemailNumber());
     }
 
-    QDBusInterface *phoneAppHandler = TelepathyHelper::instance()->handlerInterface();
-
-    QDBusMessage reply = phoneAppHandler->call(PROPERTY_AUDIO_OUTPUTS);
-    AudioOutputDBusList audioOutputList = qdbus_cast<AudioOutputDBusList>(reply.arguments().first());
-    onAudioOutputsChanged(audioOutputList);
-
-    QString activeAudioOutput = phoneAppHandler->property(PROPERTY_ACTIVE_AUDIO_OUTPUT).toString();
-    onActiveAudioOutputChanged(activeAudioOutput);
+    onAudioOutputsChanged(proxy->audioOutputs());
+    onActiveAudioOutputChanged(proxy->activeAudioOutput());
 
     Q_EMIT incomingChanged();
 }
 
+CallEntry::~CallEntry()
+{
+    CallStateProxy::instance()->unregisterCall(this);
+    CallClock::instance()->removeCall(this);
+}
+
 void CallEntry::onAudioOutputsChanged(const AudioOutputDBusList &outputs)
 {
     mAudioOutputs.clear();
@@ -111,8 +106,7 @@ QString CallEntry::activeAudioOutput() const
 
 void CallEntry::setActiveAudioOutput(const QString &id)
 {
-    QDBusInterface *phoneAppHandler = TelepathyHelper::instance()->handlerInterface();
-    phoneAppHandler->setProperty("ActiveAudioOutput", id);
+    CallStateProxy::instance()->setActiveAudioOutput(id);
 }
 
 void CallEntry::onActiveAudioOutputChanged(const QString &id)
@@ -121,19 +115,11 @@ void CallEntry::onActiveAudioOutputChanged(const QString &id)
     Q_EMIT activeAudioOutputChanged();
 }
 
-void CallEntry::onCallPropertiesChanged(const QString &objectPath, const QVariantMap &properties)
-{
-    if (objectPath != mChannel->objectPath()) {
-        return;
-    }
-    updateChannelProperties(properties);
-}
-
 void CallEntry::onConferenceChannelMerged(const Tp::ChannelPtr &channel)
 {
     QList<CallEntry*> entries = CallManager::instance()->takeCalls(QList<Tp::ChannelPtr>() << channel);
     if (entries.isEmpty()) {
-        qWarning() << "Could not find the call that was just merged.";
+        qCWarning(lcCall) << "Could not find the call that was just merged.";
         return;
     }
 
@@ -167,12 +153,8 @@ void CallEntry::onInternalCallEnded()
     entry->deleteLater();
 }
 
-void CallEntry::onCallHoldingFailed(const QString &objectPath)
+void CallEntry::onCallHoldingFailed()
 {
-    if (objectPath != mChannel->objectPath()) {
-        return;
-    }
-
     // make sure we get the hold state again
     Q_EMIT heldChanged();
 }
@@ -189,10 +171,15 @@ void CallEntry::setupCallChannel()
             SIGNAL(localHoldStateChanged(Tp::LocalHoldState,Tp::LocalHoldStateReason)),
             SLOT(onCallLocalHoldStateChanged(Tp::LocalHoldState,Tp::LocalHoldStateReason)));
 
-    mLocalMuteState = mMuteInterface.property("LocalMuteState") == 1;
-    connect(&mMuteInterface,
-            SIGNAL(MuteStateChanged(uint)),
-            SLOT(onMutedChanged(uint)));
+    // watch the mute state without introspecting the channel, and fetch the
+    // current value asynchronously
+    QDBusConnection::sessionBus().connect(mChannel->busName(), mChannel->objectPath(), TELEPATHY_MUTE_IFACE,
+                                          "MuteStateChanged", this, SLOT(onMutedChanged(uint)));
+    QDBusMessage message = QDBusMessage::createMethodCall(mChannel->busName(), mChannel->objectPath(),
+                                                          DBUS_PROPERTIES_IFACE, "Get");
+    message << TELEPATHY_MUTE_IFACE << "LocalMuteState";
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(message), this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(onMuteStateReply(QDBusPendingCallWatcher*)));
 
     if (mChannel->isConference()) {
         connect(mChannel.data(),
@@ -203,8 +190,6 @@ void CallEntry::setupCallChannel()
                 SLOT(onConferenceChannelRemoved(Tp::ChannelPtr,Tp::Channel::GroupMemberChangeDetails)));
     }
 
-    refreshProperties();
-
     onCallStateChanged(mChannel->callState());
 
     Q_EMIT heldChanged();
@@ -214,51 +199,33 @@ void CallEntry::setupCallChannel()
 
 void CallEntry::updateChannelProperties(const QVariantMap &properties)
 {
-    QVariantMap props = properties;
-    // fetch the properties if the map is empty
-    if (props.isEmpty()) {
-        QDBusInterface *phoneAppHandler = TelepathyHelper::instance()->handlerInterface();
-        QDBusReply<QVariantMap> reply = phoneAppHandler->call("GetCallProperties", mChannel->objectPath());
-        if (!reply.isValid()) {
-            return;
-        }
-
-        props = reply.value();
+    // the handler only sends the properties that changed
+    if (properties.contains("activeTimestamp")) {
+        properties["activeTimestamp"].value<QDBusArgument>() >> mActiveTimestamp;
     }
 
-    QDateTime timestamp;
-    if (props.contains("timestamp")) {
-        props["timestamp"].value<QDBusArgument>() >> timestamp;
-    }
-    if (props.contains("activeTimestamp")) {
-        props["activeTimestamp"].value<QDBusArgument>() >> mActiveTimestamp;
+    if (properties.contains("dtmfString")) {
+        mDtmfString = properties["dtmfString"].toString();
+        Q_EMIT dtmfStringChanged();
     }
 
-    mChannel->setProperty("dtmfString", props["dtmfString"]);
-    mChannel->setProperty("timestamp", timestamp);
-    mChannel->setProperty("activeTimestamp", mActiveTimestamp);
-
-    Q_EMIT dtmfStringChanged();
+    if (properties.contains(TRACE_ID_PROPERTY)) {
+        FlowTracer::instance()->instant(properties[TRACE_ID_PROPERTY].toString(), "call-entry-updated");
+    }
 }
 
-void CallEntry::timerEvent(QTimerEvent *event)
+void CallEntry::connectNotify(const QMetaMethod &signal)
 {
-    Q_EMIT elapsedTimeChanged();
+    if (signal == QMetaMethod::fromSignal(&CallEntry::elapsedTimeChanged)) {
+        QMetaObject::invokeMethod(CallClock::instance(), "refresh", Qt::QueuedConnection);
+    }
 }
 
-void CallEntry::refreshProperties()
+void CallEntry::disconnectNotify(const QMetaMethod &signal)
 {
-    QDBusInterface callChannelIface(mChannel->busName(), mChannel->objectPath(), DBUS_PROPERTIES_IFACE);
-
-    QDBusMessage reply = callChannelIface.call("GetAll", TELEPATHY_CALL_IFACE);
-    QVariantList args = reply.arguments();
-    QMap<QString, QVariant> map = qdbus_cast<QMap<QString, QVariant> >(args[0]);
-
-    mProperties.clear();
-    QMapIterator<QString, QVariant> i(map);
-    while(i.hasNext()) {
-        i.next();
-        mProperties[i.key()] = i.value();
+    // an invalid method means everything was disconnected
+    if (!signal.isValid() || signal == QMetaMethod::fromSignal(&CallEntry::elapsedTimeChanged)) {
+        QMetaObject::invokeMethod(CallClock::instance(), "refresh", Qt::QueuedConnection);
     }
 }
 
@@ -310,7 +277,7 @@ bool CallEntry::isConference() const
 
 QString CallEntry::dtmfString() const
 {
-    return mChannel->property("dtmfString").toString();
+    return mDtmfString;
 }
 
 void CallEntry::sendDTMF(const QString &key)
@@ -409,6 +376,16 @@ void CallEntry::onMutedChanged(uint state)
     Q_EMIT mutedChanged();
 }
 
+void CallEntry::onMuteStateReply(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+    QDBusPendingReply<QDBusVariant> reply = *watcher;
+    if (reply.isError()) {
+        return;
+    }
+    onMutedChanged(reply.value().variant().toUInt());
+}
+
 bool CallEntry::isMuted() const
 {
     // Replace this by a Mute interface method call when it
@@ -431,16 +408,17 @@ void CallEntry::setMute(bool value)
 
 void CallEntry::onCallStateChanged(Tp::CallState state)
 {
-    qDebug() << __PRETTY_FUNCTION__ << state;
+    qCDebug(lcCall) << __PRETTY_FUNCTION__ << state;
     // fetch the channel properties from the handler
-    updateChannelProperties();
+    CallStateProxy::instance()->requestCallProperties(mChannel->objectPath());
 
     switch (state) {
     case Tp::CallStateEnded:
+        CallClock::instance()->removeCall(this);
         Q_EMIT callEnded();
         break;
     case Tp::CallStateActive:
-        startTimer(1000);
+        CallClock::instance()->addCall(this);
         Q_EMIT callActive();
         Q_EMIT activeChanged();
         break;
@@ -488,3 +466,8 @@ bool CallEntry::isActive() const
     return (mChannel->callState() == Tp::CallStateActive);
 }
 
+bool CallEntry::isElapsedTimeWatched() const
+{
+    return isSignalConnected(QMetaMethod::fromSignal(&CallEntry::elapsedTimeChanged));
+}
+
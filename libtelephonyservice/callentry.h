@@ -31,6 +31,7 @@
 
 
 class AccountEntry;
+class QDBusPendingCallWatcher;
 
 class CallEntry : public QObject
 {
@@ -91,7 +92,7 @@ class CallEntry : public QObject
  
 public:
     explicit CallEntry(const Tp::CallChannelPtr &channel, QObject *parent = 0);
-    void timerEvent(QTimerEvent *event);
+    ~CallEntry();
 
     bool isHeld() const;
     void setHold(bool hold);
@@ -104,6 +105,8 @@ public:
 
     int elapsedTime() const;
     bool isActive() const;
+    // true if anything is bound to the elapsed time
+    bool isElapsedTimeWatched() const;
 
     void setActiveAudioOutput(const QString &id);
     QString activeAudioOutput() const;
@@ -139,7 +142,7 @@ protected Q_SLOTS:
     void onCallFlagsChanged(Tp::CallFlags flags);
     void onCallLocalHoldStateChanged(Tp::LocalHoldState state, Tp::LocalHoldStateReason reason);
     void onMutedChanged(uint state);
-    void onCallPropertiesChanged(const QString &objectPath, const QVariantMap &properties);
+    void onMuteStateReply(QDBusPendingCallWatcher *watcher);
     void onAudioOutputsChanged(const AudioOutputDBusList &outputs);
     void onActiveAudioOutputChanged(const QString &id);
 
@@ -149,11 +152,13 @@ protected Q_SLOTS:
     void onInternalCallEnded();
 
     // handler error notification
-    void onCallHoldingFailed(const QString &objectPath);
+    void onCallHoldingFailed();
 
 protected:
+    void connectNotify(const QMetaMethod &signal);
+    void disconnectNotify(const QMetaMethod &signal);
     void setupCallChannel();
-    void updateChannelProperties(const QVariantMap &properties = QVariantMap());
+    void updateChannelProperties(const QVariantMap &properties);
 
 Q_SIGNALS:
     void callEnded();
@@ -175,15 +180,14 @@ Q_SIGNALS:
     void callHoldingFailed();
     
 private:
-    void refreshProperties();
+    friend class CallStateProxy;
 
     AccountEntry *mAccount;
     Tp::CallChannelPtr mChannel;
-    QDBusInterface mMuteInterface;
-    QMap<QString, QVariant> mProperties;
     bool mVoicemail;
     bool mLocalMuteState;
     QDateTime mActiveTimestamp;
+    QString mDtmfString;
     QList<CallEntry*> mCalls;
     QList<AudioOutput*> mAudioOutputs;
     QString mActiveAudioOutput;
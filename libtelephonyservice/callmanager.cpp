@@ -24,10 +24,25 @@
 #include "callentry.h"
 #include "telepathyhelper.h"
 #include "accountentry.h"
+#include "handlersnapshot.h"
+#include "telephonylogging.h"
 
 #include <TelepathyQt/ContactManager>
 #include <TelepathyQt/PendingContacts>
+#include <QDBusArgument>
 #include <QDBusInterface>
+#include <QDBusMessage>
+#include <QDBusPendingReply>
+#include <QDBusVariant>
+#include <QElapsedTimer>
+
+#define HANDLER_SERVICE "com.canonical.TelephonyServiceHandler"
+#define HANDLER_OBJECT "/com/canonical/TelephonyServiceHandler"
+#define HANDLER_IFACE "com.canonical.TelephonyServiceHandler"
+#define DBUS_PROPERTIES_IFACE "org.freedesktop.DBus.Properties"
+#define PROPERTY_CALL_INDICATOR_VISIBLE "CallIndicatorVisible"
+
+static QElapsedTimer sStartupTimer;
 
 typedef QMap<QString, QVariant> dbusQMap;
 Q_DECLARE_METATYPE(dbusQMap)
@@ -39,7 +54,7 @@ CallManager *CallManager::instance()
 }
 
 CallManager::CallManager(QObject *parent)
-: QObject(parent), mNeedsUpdate(false), mConferenceCall(0)
+: QObject(parent), mNeedsUpdate(false), mConferenceCall(0), mHandlerHasCalls(false), mSnapshotHasCalls(false)
 {
     connect(TelepathyHelper::instance(), SIGNAL(channelObserverUnregistered()), SLOT(onChannelObserverUnregistered()));
     connect(this, SIGNAL(hasCallsChanged()), SIGNAL(callsChanged()));
@@ -47,52 +62,107 @@ CallManager::CallManager(QObject *parent)
         Q_EMIT this->callIndicatorVisibleChanged(this->callIndicatorVisible());
     });
 
-    refreshProperties();
-
     // connect the dbus signal
     QDBusConnection connection = QDBusConnection::sessionBus();
-    connection.connect("com.canonical.TelephonyServiceHandler",
-                       "/com/canonical/TelephonyServiceHandler",
-                       "com.canonical.TelephonyServiceHandler",
+    connection.connect(HANDLER_SERVICE, HANDLER_OBJECT, DBUS_PROPERTIES_IFACE, "PropertiesChanged",
+                       this, SLOT(onHandlerPropertiesChanged(QString,QVariantMap,QStringList)));
+    connection.connect(HANDLER_SERVICE, HANDLER_OBJECT, HANDLER_IFACE,
                        "CallIndicatorVisibleChanged",
-                       this, SLOT(onCallIndicatorVisibleChanged(bool)));
-    connection.connect("com.canonical.TelephonyServiceHandler",
-                       "/com/canonical/TelephonyServiceHandler",
-                       "com.canonical.TelephonyServiceHandler",
+                       this, SLOT(onCallIndicatorVisibleChanged(bool,qulonglong)));
+    connection.connect(HANDLER_SERVICE, HANDLER_OBJECT, HANDLER_IFACE,
                        "ConferenceCallRequestFinished",
                        this, SLOT(onConferenceCallRequestFinished(bool)));
+
+    connect(HandlerSnapshot::instance(), SIGNAL(loaded(QVariantMap)), SLOT(onSnapshotLoaded(QVariantMap)));
+    refreshProperties();
 }
 
 void CallManager::refreshProperties()
 {
-    QDBusInterface handlerPropertiesInterface("com.canonical.TelephonyServiceHandler",
-                                              "/com/canonical/TelephonyServiceHandler",
-                                              "org.freedesktop.DBus.Properties");
-    QDBusReply<QVariantMap> reply = handlerPropertiesInterface.call("GetAll",
-                                                                    "com.canonical.TelephonyServiceHandler");
-    if (!reply.isValid()) {
-        qWarning() << "Failed to refresh the properties from the handler";
+    // this runs while the QML plugin is being loaded, so nothing here can wait
+    // for the handler (or for its dbus activation): the replies fill the mirror
+    // and the change signals update the bindings once they arrive.
+    // TelepathyHelper::handlerInterface() is not used because QDBusInterface
+    // introspects the remote object synchronously when created.
+    sStartupTimer.start();
+
+    // see hasCalls() for why we care about the calls the handler already has
+    mSnapshotHasCalls = qgetenv("XDG_SESSION_CLASS") != "greeter" && mCallEntries.isEmpty() && !mConferenceCall;
+
+    // the properties and the existing calls come in the snapshot shared with
+    // the other client side objects
+    HandlerSnapshot::instance()->request();
+}
+
+void CallManager::setDBusProperty(const QString &name, const QVariant &value)
+{
+    QDBusMessage message = QDBusMessage::createMethodCall(HANDLER_SERVICE, HANDLER_OBJECT,
+                                                          DBUS_PROPERTIES_IFACE, "Set");
+    message << HANDLER_IFACE << name << QVariant::fromValue(QDBusVariant(value));
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(message), this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(onSetPropertyReply(QDBusPendingCallWatcher*)));
+}
+
+void CallManager::updateProperty(const QString &name, const QVariant &value)
+{
+    if (mHandlerProperties.contains(name) && mHandlerProperties[name] == value) {
         return;
     }
+    mHandlerProperties[name] = value;
 
-    QVariantMap map = reply.value();
-    mCallIndicatorVisible = map["CallIndicatorVisible"].toBool();
-    Q_EMIT callIndicatorVisibleChanged(mCallIndicatorVisible);
+    if (name == PROPERTY_CALL_INDICATOR_VISIBLE) {
+        Q_EMIT callIndicatorVisibleChanged(callIndicatorVisible());
+    }
 }
 
-void CallManager::setDBusProperty(const QString &name, const QVariant &value)
+void CallManager::onHandlerPropertiesChanged(const QString &interface, const QVariantMap &changed, const QStringList &invalidated)
+{
+    if (interface != HANDLER_IFACE) {
+        return;
+    }
+
+    QMapIterator<QString, QVariant> it(changed);
+    while (it.hasNext()) {
+        it.next();
+        updateProperty(it.key(), it.value());
+    }
+
+    if (!invalidated.isEmpty()) {
+        refreshProperties();
+    }
+}
+
+void CallManager::onSnapshotLoaded(const QVariantMap &snapshot)
 {
-    QDBusInterface handlerPropertiesInterface("com.canonical.TelephonyServiceHandler",
-                                              "/com/canonical/TelephonyServiceHandler",
-                                              "org.freedesktop.DBus.Properties");
-    handlerPropertiesInterface.call("Set",
-                                    "com.canonical.TelephonyServiceHandler",
-                                    name, QVariant::fromValue(QDBusVariant(value)));
+    qCDebug(lcCall) << "CallManager: handler snapshot synced" << sStartupTimer.elapsed() << "ms after the request";
+    QVariantMap properties = qdbus_cast<QVariantMap>(snapshot["properties"]);
+    QMapIterator<QString, QVariant> it(properties);
+    while (it.hasNext()) {
+        it.next();
+        updateProperty(it.key(), it.value());
+    }
+
+    bool handlerHasCalls = snapshot["hasCalls"].toBool();
+    if (mSnapshotHasCalls && handlerHasCalls != mHandlerHasCalls) {
+        mHandlerHasCalls = handlerHasCalls;
+        Q_EMIT hasCallsChanged();
+    }
+}
+
+void CallManager::onSetPropertyReply(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+    QDBusPendingReply<> reply = *watcher;
+    if (reply.isError()) {
+        qCWarning(lcCall) << "Failed to set the handler property:" << reply.error().message();
+        // the value we assumed is not valid, so get the real one back
+        refreshProperties();
+    }
 }
 
 QList<CallEntry *> CallManager::takeCalls(const QList<Tp::ChannelPtr> callChannels)
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcCall) << __PRETTY_FUNCTION__;
     QList<CallEntry*> entries;
 
     // run through the current calls and check which ones we find
@@ -131,12 +201,14 @@ void CallManager::addCalls(const QList<CallEntry *> entries)
 
 bool CallManager::callIndicatorVisible() const
 {
-    return hasCalls() && mCallIndicatorVisible;
+    return hasCalls() && mHandlerProperties[PROPERTY_CALL_INDICATOR_VISIBLE].toBool();
 }
 
 void CallManager::setCallIndicatorVisible(bool visible)
 {
-    setDBusProperty("CallIndicatorVisible", visible);
+    // assume the change goes through, the handler signals confirm it later
+    updateProperty(PROPERTY_CALL_INDICATOR_VISIBLE, visible);
+    setDBusProperty(PROPERTY_CALL_INDICATOR_VISIBLE, visible);
 }
 
 void CallManager::setupCallEntry(CallEntry *entry)
@@ -188,10 +260,12 @@ void CallManager::startCall(const QString &phoneNumber, const QString &accountId
     phoneAppHandler->call("StartCall", phoneNumber, account->accountId());
 }
 
-void CallManager::onCallIndicatorVisibleChanged(bool visible)
+void CallManager::onCallIndicatorVisibleChanged(bool visible, qulonglong sequence)
 {
-    mCallIndicatorVisible = visible;
-    Q_EMIT callIndicatorVisibleChanged(visible);
+    if (!HandlerSnapshot::instance()->isNewer(sequence)) {
+        return;
+    }
+    updateProperty(PROPERTY_CALL_INDICATOR_VISIBLE, visible);
 }
 
 void CallManager::onConferenceCallRequestFinished(bool succeeded)
@@ -268,21 +342,13 @@ bool CallManager::hasCalls() const
         return true;
     }
 
-    // if that's not the case, and if not in greeter mode, query the telephony-service-handler
-    // for the availability of calls.
+    // if that's not the case, and if not in greeter mode, use what the telephony-service-handler
+    // reported about the availability of calls when we started (see refreshProperties()).
     // this is done only to get the live call view on clients as soon as possible, even before the
     // telepathy observer is configured
     // Also, we have to avoid creating instances of GreeterContacts here to query if we are in greeter mode,
     // otherwise we might end up with a deadlock: unity -> telephony-service -> unity
-    if (qgetenv("XDG_SESSION_CLASS") != "greeter") {
-        QDBusInterface *phoneAppHandler = TelepathyHelper::instance()->handlerInterface();
-        QDBusReply<bool> reply = phoneAppHandler->call("HasCalls");
-        if (reply.isValid()) {
-            return reply.value();
-        }
-    }
-
-    return false;
+    return mHandlerHasCalls;
 }
 
 bool CallManager::hasBackgroundCall() const
@@ -315,6 +381,11 @@ void CallManager::onCallChannelAvailable(Tp::CallChannelPtr channel)
         mNeedsUpdate = false;
     }
 
+    // from now on the observer is the one tracking the calls, so a late
+    // answer from the handler is of no use anymore
+    mHandlerHasCalls = false;
+    mSnapshotHasCalls = false;
+
     CallEntry *entry = new CallEntry(channel, this);
     if (entry->isConference()) {
         // assume there can be only one conference call at any time for now
@@ -344,7 +415,7 @@ void CallManager::onCallChannelAvailable(Tp::CallChannelPtr channel)
 
 void CallManager::onCallEnded()
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcCall) << __PRETTY_FUNCTION__;
     // FIXME: handle multiple calls
     CallEntry *entry = qobject_cast<CallEntry*>(sender());
     if (!entry) {
@@ -357,6 +428,7 @@ void CallManager::onCallEnded()
     } else {
         mCallEntries.removeAll(entry);
     }
+    mHandlerHasCalls = false;
 
     Q_EMIT callEnded(entry);
     Q_EMIT hasCallsChanged();
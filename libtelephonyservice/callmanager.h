@@ -26,6 +26,7 @@
 #include <QQmlListProperty>
 #include <QtCore/QMap>
 #include <QDBusInterface>
+#include <QDBusPendingCallWatcher>
 #include <TelepathyQt/CallChannel>
 #include <TelepathyQt/ReceivedMessage>
 
@@ -98,19 +99,30 @@ public Q_SLOTS:
     void onCallChannelAvailable(Tp::CallChannelPtr channel);
     void onChannelObserverUnregistered();
     void onCallEnded();
-    void onCallIndicatorVisibleChanged(bool visible);
+    void onCallIndicatorVisibleChanged(bool visible, qulonglong sequence);
     void onConferenceCallRequestFinished(bool succeeded);
 
+private Q_SLOTS:
+    void onHandlerPropertiesChanged(const QString &interface, const QVariantMap &changed, const QStringList &invalidated);
+    void onSnapshotLoaded(const QVariantMap &snapshot);
+    void onSetPropertyReply(QDBusPendingCallWatcher *watcher);
+
 private:
     explicit CallManager(QObject *parent = 0);
     void refreshProperties();
     void setDBusProperty(const QString &name, const QVariant &value);
+    void updateProperty(const QString &name, const QVariant &value);
     void setupCallEntry(CallEntry *entry);
 
     mutable QList<CallEntry*> mCallEntries;
     bool mNeedsUpdate;
     CallEntry *mConferenceCall;
-    bool mCallIndicatorVisible;
+    // mirror of the handler properties, kept up to date from its signals
+    QVariantMap mHandlerProperties;
+    // whether the handler had calls before our observer got any channel
+    bool mHandlerHasCalls;
+    // whether the pending snapshot should update mHandlerHasCalls
+    bool mSnapshotHasCalls;
 };
 
 #endif // CALLMANAGER_H
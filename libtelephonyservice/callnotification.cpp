@@ -21,6 +21,7 @@
 
 #include "callnotification.h"
 #include "config.h"
+#include "telephonylogging.h"
 
 namespace C {
 #include <libintl.h>
@@ -96,7 +97,7 @@ void CallNotification::showNotificationForCall(const QStringList &participants,
 
         GError *error = NULL;
         if (!notify_notification_show(notification, &error)) {
-            qWarning() << "Failed to show message notification:" << error->message;
+            qCWarning(lcCall) << "Failed to show message notification:" << error->message;
             g_error_free (error);
         }
     });
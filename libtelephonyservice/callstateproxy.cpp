@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "callstateproxy.h"
+#include "callentry.h"
+#include "handlersnapshot.h"
+#include "telephonylogging.h"
+
+#include <QDBusArgument>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusMetaType>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusVariant>
+
+#define HANDLER_SERVICE "com.canonical.TelephonyServiceHandler"
+#define HANDLER_OBJECT "/com/canonical/TelephonyServiceHandler"
+#define HANDLER_IFACE "com.canonical.TelephonyServiceHandler"
+#define DBUS_PROPERTIES_IFACE "org.freedesktop.DBus.Properties"
+#define PROPERTY_ACTIVE_AUDIO_OUTPUT "ActiveAudioOutput"
+
+CallStateProxy *CallStateProxy::instance()
+{
+    static CallStateProxy *self = new CallStateProxy();
+    return self;
+}
+
+CallStateProxy::CallStateProxy(QObject *parent) :
+    QObject(parent), mAudioOutputsLoaded(false)
+{
+    qRegisterMetaType<AudioOutputDBus>();
+    qRegisterMetaType<AudioOutputDBusList>();
+
+    qDBusRegisterMetaType<AudioOutputDBus>();
+    qDBusRegisterMetaType<AudioOutputDBusList>();
+
+    // the first call entry creates the proxy, so nothing here can wait for
+    // the handler. TelepathyHelper::handlerInterface() is not used because
+    // QDBusInterface introspects the remote object synchronously when created.
+    QDBusConnection connection = QDBusConnection::sessionBus();
+    connection.connect(HANDLER_SERVICE, HANDLER_OBJECT, HANDLER_IFACE,
+                       "CallPropertiesChanged",
+                       this, SLOT(onCallPropertiesChanged(QString,QVariantMap,qulonglong)));
+    connection.connect(HANDLER_SERVICE, HANDLER_OBJECT, HANDLER_IFACE,
+                       "CallHoldingFailed",
+                       this, SLOT(onCallHoldingFailed(QString)));
+    connection.connect(HANDLER_SERVICE, HANDLER_OBJECT, HANDLER_IFACE,
+                       "ActiveAudioOutputChanged",
+                       this, SLOT(onActiveAudioOutputChanged(QString,qulonglong)));
+    connection.connect(HANDLER_SERVICE, HANDLER_OBJECT, HANDLER_IFACE,
+                       "AudioOutputsChanged",
+                       this, SLOT(onAudioOutputsChanged(AudioOutputDBusList,qulonglong)));
+
+    connect(HandlerSnapshot::instance(), SIGNAL(loaded(QVariantMap)), SLOT(onSnapshotLoaded(QVariantMap)));
+    HandlerSnapshot::instance()->request();
+}
+
+void CallStateProxy::registerCall(CallEntry *entry)
+{
+    mCalls.insert(entry->channel()->objectPath(), entry);
+
+    // in case the handler was not reachable when we first asked
+    if (!mAudioOutputsLoaded) {
+        HandlerSnapshot::instance()->request();
+    }
+}
+
+void CallStateProxy::unregisterCall(CallEntry *entry)
+{
+    mCalls.remove(entry->channel()->objectPath(), entry);
+}
+
+void CallStateProxy::requestCallProperties(const QString &objectPath)
+{
+    QDBusMessage message = QDBusMessage::createMethodCall(HANDLER_SERVICE, HANDLER_OBJECT, HANDLER_IFACE, "GetCallProperties");
+    message << objectPath;
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(message), this);
+    watcher->setProperty("objectPath", objectPath);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(onCallPropertiesReply(QDBusPendingCallWatcher*)));
+}
+
+AudioOutputDBusList CallStateProxy::audioOutputs() const
+{
+    return mAudioOutputs;
+}
+
+QString CallStateProxy::activeAudioOutput() const
+{
+    return mActiveAudioOutput;
+}
+
+void CallStateProxy::setActiveAudioOutput(const QString &id)
+{
+    // the handler notifies the change back through ActiveAudioOutputChanged
+    QDBusMessage message = QDBusMessage::createMethodCall(HANDLER_SERVICE, HANDLER_OBJECT,
+                                                          DBUS_PROPERTIES_IFACE, "Set");
+    message << HANDLER_IFACE << PROPERTY_ACTIVE_AUDIO_OUTPUT << QVariant::fromValue(QDBusVariant(id));
+    QDBusConnection::sessionBus().asyncCall(message);
+}
+
+void CallStateProxy::onCallPropertiesChanged(const QString &objectPath, const QVariantMap &properties, qulonglong sequence)
+{
+    if (!HandlerSnapshot::instance()->isNewer(sequence)) {
+        return;
+    }
+    updateCallProperties(objectPath, properties);
+}
+
+void CallStateProxy::onCallHoldingFailed(const QString &objectPath)
+{
+    Q_FOREACH(CallEntry *entry, mCalls.values(objectPath)) {
+        entry->onCallHoldingFailed();
+    }
+}
+
+void CallStateProxy::onAudioOutputsChanged(const AudioOutputDBusList &outputs, qulonglong sequence)
+{
+    if (!HandlerSnapshot::instance()->isNewer(sequence)) {
+        return;
+    }
+    updateAudioOutputs(outputs);
+}
+
+void CallStateProxy::onActiveAudioOutputChanged(const QString &id, qulonglong sequence)
+{
+    if (!HandlerSnapshot::instance()->isNewer(sequence)) {
+        return;
+    }
+    updateActiveAudioOutput(id);
+}
+
+void CallStateProxy::onSnapshotLoaded(const QVariantMap &snapshot)
+{
+    updateAudioOutputs(qdbus_cast<AudioOutputDBusList>(snapshot["audioOutputs"]));
+    QVariantMap properties = qdbus_cast<QVariantMap>(snapshot["properties"]);
+    updateActiveAudioOutput(properties[PROPERTY_ACTIVE_AUDIO_OUTPUT].toString());
+
+    QVariantMap calls = qdbus_cast<QVariantMap>(snapshot["calls"]);
+    Q_FOREACH(const QString &objectPath, mCalls.uniqueKeys()) {
+        if (calls.contains(objectPath)) {
+            updateCallProperties(objectPath, qdbus_cast<QVariantMap>(calls[objectPath]));
+        }
+    }
+}
+
+void CallStateProxy::updateCallProperties(const QString &objectPath, const QVariantMap &properties)
+{
+    Q_FOREACH(CallEntry *entry, mCalls.values(objectPath)) {
+        entry->updateChannelProperties(properties);
+    }
+}
+
+void CallStateProxy::updateAudioOutputs(const AudioOutputDBusList &outputs)
+{
+    mAudioOutputsLoaded = true;
+    mAudioOutputs = outputs;
+    Q_EMIT audioOutputsChanged(mAudioOutputs);
+}
+
+void CallStateProxy::updateActiveAudioOutput(const QString &id)
+{
+    if (id == mActiveAudioOutput) {
+        return;
+    }
+    mActiveAudioOutput = id;
+    Q_EMIT activeAudioOutputChanged(mActiveAudioOutput);
+}
+
+void CallStateProxy::onCallPropertiesReply(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+    QDBusPendingReply<QVariantMap> reply = *watcher;
+    if (reply.isError()) {
+        qCWarning(lcCall) << "Failed to get the call properties:" << reply.error().message();
+        return;
+    }
+    updateCallProperties(watcher->property("objectPath").toString(), reply.value());
+}
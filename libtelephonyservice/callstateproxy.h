@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CALLSTATEPROXY_H
+#define CALLSTATEPROXY_H
+
+#include <QObject>
+#include <QMultiHash>
+#include <QVariantMap>
+#include "audiooutput.h"
+
+class CallEntry;
+class QDBusPendingCallWatcher;
+
+/* Client side view of the call state kept by the handler: it subscribes to
+ * the handler signals once, routes the per call ones to the entries
+ * registered for that object path and keeps the audio outputs cached, so
+ * call entries never need to query the handler synchronously. */
+class CallStateProxy : public QObject
+{
+    Q_OBJECT
+
+public:
+    static CallStateProxy *instance();
+
+    void registerCall(CallEntry *entry);
+    void unregisterCall(CallEntry *entry);
+
+    // fetches the call properties from the handler and delivers them to the
+    // entries registered for the object path
+    void requestCallProperties(const QString &objectPath);
+
+    AudioOutputDBusList audioOutputs() const;
+    QString activeAudioOutput() const;
+    void setActiveAudioOutput(const QString &id);
+
+Q_SIGNALS:
+    void audioOutputsChanged(const AudioOutputDBusList &outputs);
+    void activeAudioOutputChanged(const QString &id);
+
+private Q_SLOTS:
+    void onCallPropertiesChanged(const QString &objectPath, const QVariantMap &properties, qulonglong sequence);
+    void onCallHoldingFailed(const QString &objectPath);
+    void onAudioOutputsChanged(const AudioOutputDBusList &outputs, qulonglong sequence);
+    void onActiveAudioOutputChanged(const QString &id, qulonglong sequence);
+    void onSnapshotLoaded(const QVariantMap &snapshot);
+
+    void onCallPropertiesReply(QDBusPendingCallWatcher *watcher);
+
+private:
+    explicit CallStateProxy(QObject *parent = 0);
+    void updateCallProperties(const QString &objectPath, const QVariantMap &properties);
+    void updateAudioOutputs(const AudioOutputDBusList &outputs);
+    void updateActiveAudioOutput(const QString &id);
+
+    QMultiHash<QString, CallEntry*> mCalls;
+    AudioOutputDBusList mAudioOutputs;
+    QString mActiveAudioOutput;
+    bool mAudioOutputsLoaded;
+};
+
+#endif // CALLSTATEPROXY_H
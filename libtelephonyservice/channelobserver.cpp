@@ -20,8 +20,10 @@
  */
 
 #include "channelobserver.h"
+#include "latencytracer.h"
 #include "protocolmanager.h"
 #include "telepathyhelper.h"
+#include "telephonylogging.h"
 #include <TelepathyQt/CallChannel>
 #include <TelepathyQt/ChannelClassSpecList>
 #include <TelepathyQt/MethodInvocationContext>
@@ -73,6 +75,7 @@ void ChannelObserver::observeChannels(const Tp::MethodInvocationContextPtr<> &co
 
         Tp::CallChannelPtr callChannel = Tp::CallChannelPtr::dynamicCast(channel);
         if (callChannel) {
+            LatencyTracer::instance()->trace(callChannel->objectPath(), "observer");
             Tp::PendingReady *ready = callChannel->becomeReady(Tp::Features()
                                                                << Tp::CallChannel::FeatureCore
                                                                << Tp::CallChannel::FeatureCallMembers
@@ -105,12 +108,12 @@ void ChannelObserver::onCallChannelReady(Tp::PendingOperation *op)
 {
     Tp::PendingReady *ready = qobject_cast<Tp::PendingReady*>(op);
     if (!ready) {
-        qCritical() << "Pending operation is not a pending ready:" << op;
+        qCCritical(lcTelephony) << "Pending operation is not a pending ready:" << op;
         return;
     }
 
     if (!mReadyMap.contains(ready)) {
-        qWarning() << "Pending ready finished but not on the map:" << ready;
+        qCWarning(lcTelephony) << "Pending ready finished but not on the map:" << ready;
         return;
     }
 
@@ -118,15 +121,10 @@ void ChannelObserver::onCallChannelReady(Tp::PendingOperation *op)
     mReadyMap.remove(ready);
 
     if (!callChannel) {
-        qWarning() << "Ready channel is not a call channel:" << callChannel;
+        qCWarning(lcTelephony) << "Ready channel is not a call channel:" << callChannel;
         return;
     }
-
-    // save the timestamp as a property in the call channel
-    callChannel->setProperty("timestamp", QDateTime::currentDateTime());
-    if (callChannel->callState() == Tp::CallStateActive) {
-        callChannel->setProperty("activeTimestamp", QDateTime::currentDateTime());
-    }
+    LatencyTracer::instance()->trace(callChannel->objectPath(), "observer-ready");
 
     Q_EMIT callChannelAvailable(callChannel);
 
@@ -143,12 +141,12 @@ void ChannelObserver::onTextChannelReady(Tp::PendingOperation *op)
 {
     Tp::PendingReady *ready = qobject_cast<Tp::PendingReady*>(op);
     if (!ready) {
-        qCritical() << "Pending operation is not a pending ready:" << op;
+        qCCritical(lcTelephony) << "Pending operation is not a pending ready:" << op;
         return;
     }
 
     if (!mReadyMap.contains(ready)) {
-        qWarning() << "Pending ready finished but not on the map:" << ready;
+        qCWarning(lcTelephony) << "Pending ready finished but not on the map:" << ready;
         return;
     }
 
@@ -156,7 +154,7 @@ void ChannelObserver::onTextChannelReady(Tp::PendingOperation *op)
     mReadyMap.remove(ready);
 
     if (!textChannel) {
-        qWarning() << "Ready channel is not a call channel:" << textChannel;
+        qCWarning(lcTelephony) << "Ready channel is not a call channel:" << textChannel;
         return;
     }
 
@@ -168,7 +166,7 @@ void ChannelObserver::onTextChannelReady(Tp::PendingOperation *op)
 void ChannelObserver::checkContextFinished(Tp::Channel *channel)
 {
     if (!mContexts.contains(channel)) {
-        qWarning() << "Context for channel not available:" << channel;
+        qCWarning(lcTelephony) << "Context for channel not available:" << channel;
         return;
     }
 
@@ -28,6 +28,7 @@
 
 // FIXME: move this class to libtelephonyservice
 #include "handler/messagejob.h"
+#include "telephonylogging.h"
 
 #include <TelepathyQt/Contact>
 #include <TelepathyQt/PendingReady>
@@ -99,7 +100,7 @@ void ChatEntry::onSendingMessageFinished()
     QString messageId = job->property("messageId").toString();
     QString channelObjectPath = job->property("channelObjectPath").toString();
     QVariantMap properties = job->property("properties").toMap();
-    qDebug() << accountId << messageId << channelObjectPath << properties;
+    qCDebug(lcChat) << accountId << messageId << channelObjectPath << properties;
     Tp::TextChannelPtr channel = ChatManager::instance()->channelForObjectPath(channelObjectPath);
 
     if (channel.isNull()) {
@@ -134,7 +135,7 @@ void ChatEntry::onGroupMembersChanged(const Tp::Contacts &groupMembersAdded,
     }
 
     if (!account) {
-        qWarning() << "Could not find account";
+        qCWarning(lcChat) << "Could not find account";
         return;
     }
 
@@ -306,7 +307,7 @@ void ChatEntry::setTitle(const QString &title)
     QDBusInterface *handlerIface = TelepathyHelper::instance()->handlerInterface();
     Q_FOREACH(const Tp::TextChannelPtr channel, mChannels) {
         if (!channel->hasInterface(TP_QT_IFACE_CHANNEL_INTERFACE_ROOM_CONFIG)) {
-            qWarning() << "Channel doesn't have the RoomConfig interface";
+            qCWarning(lcChat) << "Channel doesn't have the RoomConfig interface";
             return;
         }
 
@@ -535,7 +536,7 @@ void ChatEntry::setChannels(const QList<Tp::TextChannelPtr> &channels)
 
 void ChatEntry::addChannel(const Tp::TextChannelPtr &channel)
 {
-    qDebug() << "adding channel" << channel->objectPath();
+    qCDebug(lcChat) << "adding channel" << channel->objectPath();
     if (mChannels.contains(channel)) {
         return;
     }
@@ -634,20 +635,20 @@ void ChatEntry::setChatState(ChatState state)
 bool ChatEntry::destroyRoom()
 {
     if (mChannels.isEmpty()) {
-        qWarning() << "Cannot destroy group. No channels available";
+        qCWarning(lcChat) << "Cannot destroy group. No channels available";
         return false;
     }
 
     QDBusInterface *handlerIface = TelepathyHelper::instance()->handlerInterface();
     Q_FOREACH(const Tp::TextChannelPtr channel, mChannels) {
         if (!channel->hasInterface(TP_QT_IFACE_CHANNEL_INTERFACE_DESTROYABLE)) {
-            qWarning() << "Text channel doesn't have the destroyable interface";
+            qCWarning(lcChat) << "Text channel doesn't have the destroyable interface";
             return false;
         }
 
         QDBusReply<bool> reply = handlerIface->call("DestroyTextChannel", channel->objectPath());
         if (!reply.isValid() || !reply.value()) {
-            qWarning() << "Failed to destroy text channel.";
+            qCWarning(lcChat) << "Failed to destroy text channel.";
             return false;
         }
     }
@@ -786,7 +787,7 @@ void ChatEntry::startChat()
 
 void ChatEntry::onChannelInvalidated()
 {
-    qDebug() << __PRETTY_FUNCTION__;
+    qCDebug(lcChat) << __PRETTY_FUNCTION__;
     Tp::TextChannelPtr channel(qobject_cast<Tp::TextChannel*>(sender()));
     mChannels.removeAll(channel);
 
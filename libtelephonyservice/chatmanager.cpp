@@ -27,6 +27,8 @@
 #include "config.h"
 #include "dbustypes.h"
 #include "accountentry.h"
+#include "flowtracer.h"
+#include "telephonylogging.h"
 
 #include <TelepathyQt/Contact>
 #include <TelepathyQt/ContactManager>
@@ -111,6 +113,13 @@ QString ChatManager::sendMessage(const QString &accountId, const QString &messag
 
     QVariantMap propMap = convertPropertiesForDBus(properties);
 
+    // tag the message so that it can be followed through the other processes
+    QString traceId = FlowTracer::instance()->newTraceId();
+    if (!traceId.isEmpty()) {
+        propMap[TRACE_ID_PROPERTY] = traceId;
+        FlowTracer::instance()->begin(traceId, "send-message");
+    }
+
     // check if files should be copied to a temporary location before passing them to handler
     bool tmpFiles = (properties.contains("x-canonical-tmp-files") && properties["x-canonical-tmp-files"].toBool());
 
@@ -128,16 +137,16 @@ QString ChatManager::sendMessage(const QString &accountId, const QString &messag
             QTemporaryFile tmpFile("/tmp/XXXXX");
             tmpFile.setAutoRemove(false);
             if (!tmpFile.open()) {
-                qWarning() << "Unable to create a temporary file";
+                qCWarning(lcChat) << "Unable to create a temporary file";
                 return QString();
             }
             QFile originalFile(list.at(2).toString());
             if (!originalFile.open(QIODevice::ReadOnly)) {
-                qWarning() << "Attachment file not found";
+                qCWarning(lcChat) << "Attachment file not found";
                 return QString();
             }
             if (tmpFile.write(originalFile.readAll()) == -1) {
-                qWarning() << "Failed to write attachment to a temporary file";
+                qCWarning(lcChat) << "Failed to write attachment to a temporary file";
                 return QString();
             }
             newAttachment.filePath = tmpFile.fileName();
@@ -149,11 +158,14 @@ QString ChatManager::sendMessage(const QString &accountId, const QString &messag
         newAttachments << newAttachment;
     }
 
+    FlowTracer::Scope traceScope("ChatManager::sendMessage", traceId);
     QDBusInterface *phoneAppHandler = TelepathyHelper::instance()->handlerInterface();
     QDBusReply<QString> reply = phoneAppHandler->call("SendMessage", account->accountId(), message, QVariant::fromValue(newAttachments), propMap);
     if (reply.isValid()) {
         return reply.value();
     }
+    // the handler never got the message, so the flow ends here
+    FlowTracer::instance()->end(traceId, "send-message");
     return QString();
 }
 
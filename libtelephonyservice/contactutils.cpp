@@ -22,19 +22,52 @@
 #include "contactutils.h"
 #include <QContactName>
 #include <QContactDisplayLabel>
+#include <QContactPhoneNumber>
 
 QTCONTACTS_USE_NAMESPACE
 
 namespace ContactUtils
 {
 
-QContactManager *sharedManager(const QString &engine)
+// tests can fill the memory backend of a process with the contacts listed in
+// TELEPHONY_SERVICE_TEST_CONTACTS, as "name=number" entries separated by ';'
+static void loadTestContacts(QContactManager *manager)
+{
+    QString contacts = QString::fromUtf8(qgetenv("TELEPHONY_SERVICE_TEST_CONTACTS"));
+    Q_FOREACH(const QString &entry, contacts.split(';', QString::SkipEmptyParts)) {
+        QStringList fields = entry.split('=');
+        if (fields.count() != 2) {
+            continue;
+        }
+
+        QContact contact;
+        QContactDisplayLabel label;
+        label.setLabel(fields[0]);
+        contact.saveDetail(&label);
+        QContactName name;
+        name.setFirstName(fields[0]);
+        contact.saveDetail(&name);
+        QContactPhoneNumber number;
+        number.setNumber(fields[1]);
+        contact.saveDetail(&number);
+        manager->saveContact(&contact);
+    }
+}
+
+static QContactManager *createManager(const QString &engine)
 {
-    QString finalEngine = engine;
-    if (!qgetenv("TELEPHONY_SERVICE_TEST").isEmpty()) {
-        finalEngine = "memory";
+    if (qgetenv("TELEPHONY_SERVICE_TEST").isEmpty()) {
+        return new QContactManager(engine);
     }
-    static QContactManager *instance = new QContactManager(finalEngine);
+
+    QContactManager *manager = new QContactManager("memory");
+    loadTestContacts(manager);
+    return manager;
+}
+
+QContactManager *sharedManager(const QString &engine)
+{
+    static QContactManager *instance = createManager(engine);
     return instance;
 }
 
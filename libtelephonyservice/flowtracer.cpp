@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flowtracer.h"
+#include "telephonylogging.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <time.h>
+
+#define TRACE_CATEGORY "telephony"
+
+FlowTracer::Scope::Scope(const char *name, const QString &traceId)
+: mName(name), mStart(-1)
+{
+    if (FlowTracer::instance()->isEnabled()) {
+        mTraceId = traceId;
+        mStart = timestamp();
+    }
+}
+
+FlowTracer::Scope::~Scope()
+{
+    if (mStart >= 0) {
+        FlowTracer::instance()->write("X", mTraceId, mName, QVariantMap(), mStart, timestamp() - mStart);
+    }
+}
+
+FlowTracer *FlowTracer::instance()
+{
+    static FlowTracer *self = new FlowTracer();
+    return self;
+}
+
+FlowTracer::FlowTracer()
+: mFile(0), mPid(QCoreApplication::applicationPid()), mNextId(0)
+{
+    QString path = QString::fromLocal8Bit(qgetenv("TELEPHONY_SERVICE_TRACE_FILE"));
+    if (path.isEmpty()) {
+        return;
+    }
+
+    // all the traced processes append to the same file, and each event is a
+    // single write so that they do not get mixed up
+    QFile *file = new QFile(path);
+    if (!file->open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)) {
+        qCWarning(lcTelephony) << "Failed to open the trace file" << path << ":" << file->errorString();
+        delete file;
+        return;
+    }
+    mFile = file;
+    qCDebug(lcTelephony) << "Writing trace events to" << path;
+
+    // the closing bracket is optional in the trace event format, which is
+    // what allows appending to the file from many processes
+    if (mFile->size() == 0) {
+        mFile->write("[\n");
+    }
+
+    QVariantMap args;
+    args["name"] = QCoreApplication::applicationName();
+    write("M", QString(), "process_name", args, timestamp());
+}
+
+QString FlowTracer::newTraceId()
+{
+    if (!isEnabled()) {
+        return QString();
+    }
+    return QString("%1.%2").arg(mPid).arg(++mNextId);
+}
+
+void FlowTracer::begin(const QString &traceId, const QString &name, const QVariantMap &args)
+{
+    if (isEnabled() && !traceId.isEmpty()) {
+        write("b", traceId, name, args, timestamp());
+    }
+}
+
+void FlowTracer::end(const QString &traceId, const QString &name, const QVariantMap &args)
+{
+    if (isEnabled() && !traceId.isEmpty()) {
+        write("e", traceId, name, args, timestamp());
+    }
+}
+
+void FlowTracer::instant(const QString &traceId, const QString &name, const QVariantMap &args)
+{
+    if (isEnabled() && !traceId.isEmpty()) {
+        write("n", traceId, name, args, timestamp());
+    }
+}
+
+qint64 FlowTracer::timestamp()
+{
+    // microseconds, the same clock in every process
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+void FlowTracer::write(const char *phase, const QString &traceId, const QString &name,
+                       const QVariantMap &args, qint64 time, qint64 duration)
+{
+    QJsonObject event;
+    event["name"] = name;
+    event["cat"] = QString(TRACE_CATEGORY);
+    event["ph"] = QString(phase);
+    event["ts"] = time;
+    event["pid"] = mPid;
+    event["tid"] = mPid;
+    if (duration >= 0) {
+        event["dur"] = duration;
+    }
+
+    QJsonObject eventArgs = QJsonObject::fromVariantMap(args);
+    if (!traceId.isEmpty()) {
+        eventArgs["traceId"] = traceId;
+        // async events with the same global id end up on the same track,
+        // no matter which process recorded them
+        if (duration < 0) {
+            QJsonObject id;
+            id["global"] = traceId;
+            event["id2"] = id;
+        }
+    }
+    event["args"] = eventArgs;
+
+    mFile->write(QJsonDocument(event).toJson(QJsonDocument::Compact) + ",\n");
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLOWTRACER_H
+#define FLOWTRACER_H
+
+#include <QString>
+#include <QVariantMap>
+
+class QFile;
+
+// the message and call property carrying the trace id between processes
+#define TRACE_ID_PROPERTY "x-canonical-trace-id"
+
+/* Writes Chrome trace events (chrome://tracing, about:tracing or Perfetto)
+ * following a message or a call through the client, the handler and the
+ * indicator. Every flow gets a trace id that is passed along in the message
+ * or call properties, and the events of all processes tagged with the same
+ * id show up together on a single track.
+ *
+ * Tracing is enabled by pointing TELEPHONY_SERVICE_TRACE_FILE to a file in
+ * every process to trace: they all append to it, and timestamps come from
+ * the system wide monotonic clock so they line up. When it is not set,
+ * every call here returns right after checking isEnabled(). */
+class FlowTracer
+{
+public:
+    // records a complete event covering the lifetime of the scope
+    class Scope
+    {
+    public:
+        Scope(const char *name, const QString &traceId);
+        ~Scope();
+
+    private:
+        const char *mName;
+        QString mTraceId;
+        qint64 mStart;
+    };
+
+    static FlowTracer *instance();
+
+    bool isEnabled() const { return mFile != 0; }
+    // a new id to tag a flow with, empty when tracing is disabled
+    QString newTraceId();
+
+    // start and end of a flow step, these can happen in different processes
+    void begin(const QString &traceId, const QString &name, const QVariantMap &args = QVariantMap());
+    void end(const QString &traceId, const QString &name, const QVariantMap &args = QVariantMap());
+    // something that happened at a point in time
+    void instant(const QString &traceId, const QString &name, const QVariantMap &args = QVariantMap());
+
+private:
+    FlowTracer();
+    static qint64 timestamp();
+    void write(const char *phase, const QString &traceId, const QString &name,
+               const QVariantMap &args, qint64 time, qint64 duration = -1);
+
+    QFile *mFile;
+    qint64 mPid;
+    quint64 mNextId;
+};
+
+#endif // FLOWTRACER_H
@@ -22,6 +22,7 @@
  */
 
 #include "greetercontacts.h"
+#include "telephonylogging.h"
 
 #include <pwd.h>
 #include <QContactAvatar>
@@ -324,7 +325,7 @@ QVariant GreeterContacts::getUserValue(const QString &interface, const QString &
     if (reply.isValid()) {
         return reply.value();
     } else {
-        qWarning() << "Failed to get user property " << propName << " from AccountsService:" << reply.error().message();
+        qCWarning(lcContacts) << "Failed to get user property " << propName << " from AccountsService:" << reply.error().message();
     }
     return QVariant();
 }
@@ -388,7 +389,7 @@ void GreeterContacts::greeterGetEntryReply(QDBusPendingCallWatcher *watcher)
     if (!reply.isError()) {
         updateActiveUser(reply.argumentAt<0>().toString());
     } else {
-        qWarning() << "Failed to get active entry from Unity Greeter:" << reply.error().message();
+        qCWarning(lcContacts) << "Failed to get active entry from Unity Greeter:" << reply.error().message();
     }
     watcher->deleteLater();
 }
@@ -401,7 +402,7 @@ void GreeterContacts::accountsGetUsersReply(QDBusPendingCallWatcher *watcher)
             queryContact(user.path());
         }
     } else {
-        qWarning() << "Failed to get user list from AccountsService:" << reply.error().message();
+        qCWarning(lcContacts) << "Failed to get user list from AccountsService:" << reply.error().message();
     }
     watcher->deleteLater();
 }
@@ -413,7 +414,7 @@ void GreeterContacts::accountsGetContactReply(QDBusPendingCallWatcher *watcher)
         mContacts.insert(watcher->property("telepathyPath").toString(), qdbus_cast<QVariantMap>(reply.argumentAt<0>()));
         signalIfNeeded();
     } else {
-        qWarning() << "Failed to get user's contact from AccountsService:" << reply.error().message();
+        qCWarning(lcContacts) << "Failed to get user's contact from AccountsService:" << reply.error().message();
     }
     watcher->deleteLater();
 }
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "handlersnapshot.h"
+#include "telephonylogging.h"
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusServiceWatcher>
+
+#define HANDLER_SERVICE "com.canonical.TelephonyServiceHandler"
+#define HANDLER_OBJECT "/com/canonical/TelephonyServiceHandler"
+#define HANDLER_IFACE "com.canonical.TelephonyServiceHandler"
+
+HandlerSnapshot *HandlerSnapshot::instance()
+{
+    static HandlerSnapshot *self = new HandlerSnapshot();
+    return self;
+}
+
+HandlerSnapshot::HandlerSnapshot(QObject *parent) :
+    QObject(parent), mWatcher(0), mLoaded(false), mSequence(0)
+{
+    // a restarted handler counts its changes from zero again
+    QDBusServiceWatcher *serviceWatcher = new QDBusServiceWatcher(HANDLER_SERVICE,
+                                                                  QDBusConnection::sessionBus(),
+                                                                  QDBusServiceWatcher::WatchForUnregistration,
+                                                                  this);
+    connect(serviceWatcher, SIGNAL(serviceUnregistered(QString)), SLOT(onHandlerUnregistered()));
+}
+
+void HandlerSnapshot::request()
+{
+    if (mWatcher) {
+        // the reply on its way is recent enough
+        return;
+    }
+
+    // createMethodCall() is used instead of TelepathyHelper::handlerInterface()
+    // because QDBusInterface introspects the remote object synchronously
+    QDBusMessage message = QDBusMessage::createMethodCall(HANDLER_SERVICE, HANDLER_OBJECT, HANDLER_IFACE, "GetSnapshot");
+    mWatcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(message), this);
+    connect(mWatcher, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(onSnapshotReply(QDBusPendingCallWatcher*)));
+}
+
+bool HandlerSnapshot::isLoaded() const
+{
+    return mLoaded;
+}
+
+qulonglong HandlerSnapshot::sequence() const
+{
+    return mSequence;
+}
+
+bool HandlerSnapshot::isNewer(qulonglong sequence) const
+{
+    return !mLoaded || sequence > mSequence;
+}
+
+void HandlerSnapshot::onSnapshotReply(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+    mWatcher = 0;
+    QDBusPendingReply<QVariantMap> reply = *watcher;
+    if (reply.isError()) {
+        qCWarning(lcTelephony) << "Failed to get the handler snapshot:" << reply.error().message();
+        Q_EMIT failed();
+        return;
+    }
+
+    QVariantMap snapshot = reply.value();
+    mSequence = snapshot["sequence"].toULongLong();
+    mLoaded = true;
+    Q_EMIT loaded(snapshot);
+}
+
+void HandlerSnapshot::onHandlerUnregistered()
+{
+    mLoaded = false;
+    mSequence = 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HANDLERSNAPSHOT_H
+#define HANDLERSNAPSHOT_H
+
+#include <QObject>
+#include <QVariantMap>
+
+class QDBusPendingCallWatcher;
+
+/* Shares the handler GetSnapshot call between the client side objects, so
+ * that whatever is created while the application starts gets its initial
+ * state from a single round trip. The change signals of the handler carry a
+ * sequence number, and isNewer() tells whether one of them still has to be
+ * applied on top of the last snapshot. */
+class HandlerSnapshot : public QObject
+{
+    Q_OBJECT
+
+public:
+    static HandlerSnapshot *instance();
+
+    // asks the handler for a new snapshot, unless one is already on its way
+    void request();
+
+    bool isLoaded() const;
+    qulonglong sequence() const;
+    bool isNewer(qulonglong sequence) const;
+
+Q_SIGNALS:
+    void loaded(const QVariantMap &snapshot);
+    void failed();
+
+private Q_SLOTS:
+    void onSnapshotReply(QDBusPendingCallWatcher *watcher);
+    void onHandlerUnregistered();
+
+private:
+    explicit HandlerSnapshot(QObject *parent = 0);
+
+    QDBusPendingCallWatcher *mWatcher;
+    bool mLoaded;
+    qulonglong mSequence;
+};
+
+#endif // HANDLERSNAPSHOT_H
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "histogram.h"
+
+// percentiles are computed over the most recent samples only
+#define MAX_SAMPLES 256
+
+Histogram::Histogram(const QVector<qint64> &bucketLimits)
+: mBucketLimits(bucketLimits), mBuckets(bucketLimits.count() + 1, 0), mCount(0), mMax(0)
+{
+}
+
+void Histogram::add(qint64 sample)
+{
+    int bucket = 0;
+    while (bucket < mBucketLimits.count() && sample > mBucketLimits[bucket]) {
+        bucket++;
+    }
+    mBuckets[bucket]++;
+
+    mSamples << sample;
+    if (mSamples.count() > MAX_SAMPLES) {
+        mSamples.removeFirst();
+    }
+    mCount++;
+    mMax = qMax(mMax, sample);
+}
+
+QVariantMap Histogram::toMap() const
+{
+    QVariantList limits;
+    Q_FOREACH(qint64 limit, mBucketLimits) {
+        limits << limit;
+    }
+    QVariantList buckets;
+    Q_FOREACH(uint count, mBuckets) {
+        buckets << count;
+    }
+
+    QVariantMap map;
+    map["count"] = mCount;
+    map["max"] = mMax;
+    map["bucketLimits"] = limits;
+    map["buckets"] = buckets;
+    if (mSamples.isEmpty()) {
+        return map;
+    }
+
+    QList<qint64> samples = mSamples;
+    qSort(samples);
+    map["p50"] = samples[samples.count() * 50 / 100];
+    map["p95"] = samples[samples.count() * 95 / 100];
+    map["p99"] = samples[samples.count() * 99 / 100];
+    return map;
+}
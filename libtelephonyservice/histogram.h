@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <QList>
+#include <QVariantMap>
+#include <QVector>
+
+/* Counts samples into buckets with the given upper limits (the last bucket
+ * takes everything above them) and keeps the most recent samples to compute
+ * percentiles from. */
+class Histogram
+{
+public:
+    explicit Histogram(const QVector<qint64> &bucketLimits = QVector<qint64>());
+    void add(qint64 sample);
+    // count, p50, p95, p99, max, bucketLimits and buckets
+    QVariantMap toMap() const;
+
+private:
+    QVector<qint64> mBucketLimits;
+    QVector<uint> mBuckets;
+    QList<qint64> mSamples;
+    uint mCount;
+    qint64 mMax;
+};
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "latencytracer.h"
+#include "telephonylogging.h"
+#include <QDebug>
+#include <QElapsedTimer>
+
+// upper limits of the histogram buckets in milliseconds, the last bucket
+// takes everything above
+static const qint64 BUCKET_LIMITS[] = { 10, 25, 50, 100, 250, 500, 1000, 2500, 5000 };
+// traces are dropped if they are never finished (calls that stay unanswered)
+#define MAX_OPEN_TRACES 16
+#define TRACE_TIMEOUT 120000
+
+LatencyTracer *LatencyTracer::instance()
+{
+    static LatencyTracer *self = new LatencyTracer();
+    return self;
+}
+
+LatencyTracer::LatencyTracer()
+{
+}
+
+qint64 LatencyTracer::timestamp()
+{
+    QElapsedTimer timer;
+    timer.start();
+    return timer.msecsSinceReference();
+}
+
+void LatencyTracer::trace(const QString &key, const QString &point, qint64 time)
+{
+    if (time < 0) {
+        time = timestamp();
+    }
+
+    for (int i = 0; i < mTraces.count(); i++) {
+        if (mTraces[i].key == key) {
+            record(mTraces[i], point, time);
+            return;
+        }
+    }
+
+    // drop whatever was left behind before starting a new trace
+    while (!mTraces.isEmpty() &&
+           (mTraces.count() >= MAX_OPEN_TRACES || time - mTraces.first().start > TRACE_TIMEOUT)) {
+        mTraces.removeFirst();
+    }
+
+    Trace trace;
+    trace.key = key;
+    trace.start = time;
+    trace.last = time;
+    mTraces << trace;
+    record(mTraces.last(), point, time);
+}
+
+void LatencyTracer::append(const QString &key, const QString &point, qint64 time)
+{
+    for (int i = 0; i < mTraces.count(); i++) {
+        if (mTraces[i].key == key) {
+            record(mTraces[i], point, time < 0 ? timestamp() : time);
+            return;
+        }
+    }
+}
+
+void LatencyTracer::finish(const QString &key)
+{
+    for (int i = 0; i < mTraces.count(); i++) {
+        if (mTraces[i].key == key) {
+            qCDebug(lcTelephony) << "Incoming call trace for" << key << ":" << mTraces[i].log.join(", ");
+            mTraces.removeAt(i);
+            return;
+        }
+    }
+}
+
+QVariantMap LatencyTracer::histograms() const
+{
+    QVariantMap map;
+    QMap<QString, Histogram>::const_iterator it = mHistograms.constBegin();
+    for (; it != mHistograms.constEnd(); ++it) {
+        map[it.key()] = it.value().toMap();
+    }
+    return map;
+}
+
+void LatencyTracer::reset()
+{
+    mHistograms.clear();
+}
+
+void LatencyTracer::record(Trace &trace, const QString &point, qint64 time)
+{
+    // only the first time a point is reached counts
+    if (trace.points.contains(point)) {
+        return;
+    }
+
+    qint64 latency = qMax(qint64(0), time - trace.start);
+    addSample(point, latency);
+
+    // points do not always arrive in the same order (the contact lookup runs
+    // in parallel with the channel becoming ready), so the stage is named
+    // after both of its ends
+    if (!trace.points.isEmpty()) {
+        qint64 stageLatency = qMax(qint64(0), time - trace.last);
+        addSample(QString("%1->%2").arg(trace.points.last(), point), stageLatency);
+        trace.log << QString("%1 +%2ms (+%3ms)").arg(point).arg(latency).arg(stageLatency);
+    } else {
+        trace.log << QString("%1 +%2ms").arg(point).arg(latency);
+    }
+
+    trace.points << point;
+    trace.last = qMax(trace.last, time);
+}
+
+void LatencyTracer::addSample(const QString &name, qint64 latency)
+{
+    QMap<QString, Histogram>::iterator it = mHistograms.find(name);
+    if (it == mHistograms.end()) {
+        QVector<qint64> limits;
+        for (uint i = 0; i < sizeof(BUCKET_LIMITS) / sizeof(BUCKET_LIMITS[0]); i++) {
+            limits << BUCKET_LIMITS[i];
+        }
+        it = mHistograms.insert(name, Histogram(limits));
+    }
+    it.value().add(latency);
+}
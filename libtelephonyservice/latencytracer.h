@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LATENCYTRACER_H
+#define LATENCYTRACER_H
+
+#include "histogram.h"
+#include <QList>
+#include <QMap>
+#include <QStringList>
+#include <QVariantMap>
+
+/* Collects trace points along the path of an incoming call (dispatch,
+ * channel ready, contact lookup, snap decision, ringtone) and aggregates
+ * into histograms both the time from the start of each trace to every point
+ * and the time each stage took, from the previous point of the same trace.
+ * A trace is identified by the channel object path and starts with the
+ * first point recorded for it. Times come from the monotonic clock, in
+ * milliseconds. */
+class LatencyTracer
+{
+public:
+    static LatencyTracer *instance();
+    static qint64 timestamp();
+
+    // a time of -1 means now
+    void trace(const QString &key, const QString &point, qint64 time = -1);
+    // records the point only if the trace is still open, for the points that
+    // can be reached after the call was already answered or rejected
+    void append(const QString &key, const QString &point, qint64 time = -1);
+    void finish(const QString &key);
+
+    // point name for the time since the start of the trace, and
+    // "previous->point" for the time of each stage, -> count, p50, p95, p99,
+    // max, bucketLimits and buckets
+    QVariantMap histograms() const;
+    void reset();
+
+private:
+    struct Trace {
+        QString key;
+        qint64 start;
+        qint64 last;
+        QStringList points;
+        QStringList log;
+    };
+
+    LatencyTracer();
+    void record(Trace &trace, const QString &point, qint64 time);
+    void addSample(const QString &name, qint64 latency);
+
+    QList<Trace> mTraces;
+    QMap<QString, Histogram> mHistograms;
+};
+
+#endif // LATENCYTRACER_H
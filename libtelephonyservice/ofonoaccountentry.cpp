@@ -22,6 +22,7 @@
 #include "ofonoaccountentry.h"
 #include "phoneutils.h"
 #include "telepathyhelper.h"
+#include "telephonylogging.h"
 
 OfonoAccountEntry::OfonoAccountEntry(const Tp::AccountPtr &account, QObject *parent) :
     AccountEntry(account, parent), mVoicemailCount(0), mVoicemailIndicator(false)
@@ -163,7 +164,7 @@ void OfonoAccountEntry::onVoicemailCountChanged(uint count)
 
 void OfonoAccountEntry::onVoicemailIndicatorChanged(bool visible)
 {
-    qDebug() << __PRETTY_FUNCTION__ << visible;
+    qCDebug(lcAccounts) << __PRETTY_FUNCTION__ << visible;
     mVoicemailIndicator = visible;
     Q_EMIT voicemailIndicatorChanged();
 }
@@ -240,7 +241,7 @@ void OfonoAccountEntry::onConnectionChanged(Tp::ConnectionPtr connection)
                 Q_EMIT voicemailNumberChanged();
             }
         } else {
-            qWarning() << "Could not get voicemail number!";
+            qCWarning(lcAccounts) << "Could not get voicemail number!";
         }
 
         // connect the voicemail count changed signal
@@ -22,6 +22,7 @@
  */
 
 #include "phoneutils.h"
+#include "telephonylogging.h"
 
 #include <phonenumbers/phonenumbermatch.h>
 #include <phonenumbers/phonenumbermatcher.h>
@@ -100,15 +101,15 @@ bool PhoneUtils::isPhoneNumber(const QString &phoneNumber)
 
     switch(error) {
     case i18n::phonenumbers::PhoneNumberUtil::INVALID_COUNTRY_CODE_ERROR:
-        qWarning() << "Invalid country code for:" << phoneNumber;
+        qCWarning(lcContacts) << "Invalid country code for:" << phoneNumber;
         return false;
     case i18n::phonenumbers::PhoneNumberUtil::NOT_A_NUMBER:
-        qWarning() << "The phone number is not a valid number:" << phoneNumber;
+        qCWarning(lcContacts) << "The phone number is not a valid number:" << phoneNumber;
         return false;
     case i18n::phonenumbers::PhoneNumberUtil::TOO_SHORT_AFTER_IDD:
     case i18n::phonenumbers::PhoneNumberUtil::TOO_SHORT_NSN:
     case i18n::phonenumbers::PhoneNumberUtil::TOO_LONG_NSN:
-        qWarning() << "Invalid phone number" << phoneNumber;
+        qCWarning(lcContacts) << "Invalid phone number" << phoneNumber;
         return false;
     default:
         break;
@@ -20,10 +20,11 @@
  */
 
 #include "protocolmanager.h"
-#include "telepathyhelper.h"
+#include "handlersnapshot.h"
 #include "config.h"
 #include "dbustypes.h"
 #include <QDir>
+#include <QDBusConnection>
 #include <QDBusMetaType>
 
 QDBusArgument &operator<<(QDBusArgument &argument, const ProtocolStruct &protocol)
@@ -63,26 +64,14 @@ ProtocolManager::ProtocolManager(const QString &dir, QObject *parent) :
         qDBusRegisterMetaType<ProtocolList>();
         qDBusRegisterMetaType<ProtocolStruct>();
 
-        //TODO make DBus call to get the protocols
-        QDBusInterface *interface = TelepathyHelper::instance()->handlerInterface();
-
-        if (!interface) {
-            return;
-        }
-
-        connect(interface,
-                SIGNAL(ProtocolsChanged(ProtocolList)),
-                SLOT(onProtocolsChanged(ProtocolList)));
-
-        QDBusReply<ProtocolList> reply = interface->call("GetProtocols");
-        if (!reply.isValid()) {
-            return;
-        }
-
-        mProtocols.clear();
-        Q_FOREACH (const ProtocolStruct& protocol, reply.value()) {
-            mProtocols << new Protocol(protocol);
-        }
+        // the protocols come with the rest of the handler state in its snapshot
+        QDBusConnection::sessionBus().connect("com.canonical.TelephonyServiceHandler",
+                                              "/com/canonical/TelephonyServiceHandler",
+                                              "com.canonical.TelephonyServiceHandler",
+                                              "ProtocolsChanged",
+                                              this, SLOT(onProtocolsChanged(ProtocolList,qulonglong)));
+        connect(HandlerSnapshot::instance(), SIGNAL(loaded(QVariantMap)), SLOT(onSnapshotLoaded(QVariantMap)));
+        HandlerSnapshot::instance()->request();
     }
 }
 
@@ -217,7 +206,20 @@ void ProtocolManager::loadSupportedProtocols()
     Q_EMIT protocolsChanged();
 }
 
-void ProtocolManager::onProtocolsChanged(const ProtocolList &protocolList)
+void ProtocolManager::onProtocolsChanged(const ProtocolList &protocolList, qulonglong sequence)
+{
+    if (!HandlerSnapshot::instance()->isNewer(sequence)) {
+        return;
+    }
+    setProtocols(protocolList);
+}
+
+void ProtocolManager::onSnapshotLoaded(const QVariantMap &snapshot)
+{
+    setProtocols(qdbus_cast<ProtocolList>(snapshot["protocols"]));
+}
+
+void ProtocolManager::setProtocols(const ProtocolList &protocolList)
 {
     mProtocols.clear();
     Q_FOREACH (const ProtocolStruct &protocol, protocolList) {
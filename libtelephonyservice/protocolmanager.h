@@ -90,12 +90,15 @@ Q_SIGNALS:
 
 protected Q_SLOTS:
     void loadSupportedProtocols();
-    void onProtocolsChanged(const ProtocolList &protocolList);
+    void onProtocolsChanged(const ProtocolList &protocolList, qulonglong sequence);
+    void onSnapshotLoaded(const QVariantMap &snapshot);
 
 protected:
     explicit ProtocolManager(const QString &dir, QObject *parent = 0);
 
 private:
+    void setProtocols(const ProtocolList &protocolList);
+
     Protocols mProtocols;
     QFileSystemWatcher mFileWatcher;
     QString mProtocolsDir;
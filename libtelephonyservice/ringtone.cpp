@@ -20,72 +20,154 @@
  */
 
 #include "greetercontacts.h"
+#include "latencytracer.h"
 #include "ringtone.h"
+#include "telephonylogging.h"
+#include <QElapsedTimer>
+
+// position updates are only needed often while waiting for the first frame
+#define FIRST_FRAME_NOTIFY_INTERVAL 20
+#define DEFAULT_NOTIFY_INTERVAL 1000
 
 RingtoneWorker::RingtoneWorker(QObject *parent) :
     QObject(parent), mCallAudioPlayer(NULL), mCallAudioPlaylist(this),
-    mMessageAudioPlayer(NULL)
+    mCallSoundChanged(false), mCallRequestTime(-1),
+    mMessageAudioPlayer(NULL), mMessageRequestTime(-1)
 {
     mCallAudioPlaylist.setPlaybackMode(QMediaPlaylist::Loop);
     mCallAudioPlaylist.setCurrentIndex(0);
 }
 
-void RingtoneWorker::playIncomingCallSound()
+void RingtoneWorker::preload()
 {
     if (!qgetenv("PA_DISABLED").isEmpty()) {
         return;
     }
 
-    if (GreeterContacts::instance()->silentMode()) {
-        return;
-    }
-
-    // force delete all media player instances
-    stopIncomingCallSound();
+    // keep both players around with their sounds loaded, so that an incoming
+    // call or message only needs to start playback
+    loadCallSound();
+    loadMessageSound();
+}
 
-    // pick up the new ringtone in case it changed in the meantime
-    mCallAudioPlaylist.addMedia(QUrl::fromLocalFile(GreeterContacts::instance()->incomingCallSound()));
-    mCallAudioPlayer = new QMediaPlayer(this);
-    mCallAudioPlayer->setAudioRole(QAudio::RingtoneRole);
-    mCallAudioPlayer->setPlaylist(&mCallAudioPlaylist);
-    mCallAudioPlayer->play();
+void RingtoneWorker::onSoundSettingsChanged(const QString &key)
+{
+    if (key == "IncomingCallSound") {
+        // do not change the sound under a ringing call, it is reloaded once stopped
+        if (mCallAudioPlayer && mCallAudioPlayer->state() == QMediaPlayer::PlayingState) {
+            mCallSoundChanged = true;
+        } else {
+            mCallAudioPlaylist.clear();
+            if (mCallAudioPlayer) {
+                loadCallSound();
+            }
+        }
+    } else if (key == "IncomingMessageSound") {
+        mMessageSound.clear();
+        if (mMessageAudioPlayer && mMessageAudioPlayer->state() != QMediaPlayer::PlayingState) {
+            loadMessageSound();
+        }
+    }
 }
 
-void RingtoneWorker::stopIncomingCallSound()
+void RingtoneWorker::loadCallSound()
 {
-    if (mCallAudioPlayer) {
-        // WORKAROUND: if we call stop and the stream is already over, qmediaplayer plays again.
-        mCallAudioPlayer->pause();
+    // Re-create if in error state. A typical case is when media-hub-server has
+    // crashed and we need to start from a clean slate.
+    if (mCallAudioPlayer && mCallAudioPlayer->error()) {
+        qCDebug(lcAudio) << "mCallAudioPlayer in error state ("
+                 << mCallAudioPlayer->error() << "), recreating";
         mCallAudioPlayer->deleteLater();
         mCallAudioPlayer = NULL;
     }
-    mCallAudioPlaylist.clear();
-}
 
-void RingtoneWorker::playIncomingMessageSound()
-{
-    if (!qgetenv("PA_DISABLED").isEmpty()) {
-        return;
+    if (!mCallAudioPlayer) {
+        mCallAudioPlayer = new QMediaPlayer(this);
+        mCallAudioPlayer->setAudioRole(QAudio::RingtoneRole);
+        connect(mCallAudioPlayer, SIGNAL(positionChanged(qint64)), SLOT(onCallPositionChanged(qint64)));
+        mCallAudioPlayer->setPlaylist(&mCallAudioPlaylist);
     }
 
-    if (GreeterContacts::instance()->silentMode()) {
-        return;
+    if (mCallAudioPlaylist.isEmpty()) {
+        mCallAudioPlaylist.addMedia(QUrl::fromLocalFile(GreeterContacts::instance()->incomingCallSound()));
+        mCallAudioPlaylist.setCurrentIndex(0);
     }
+}
 
+void RingtoneWorker::loadMessageSound()
+{
     // Re-create if in error state. A typical case is when media-hub-server has
     // crashed and we need to start from a clean slate.
     if (mMessageAudioPlayer && mMessageAudioPlayer->error()) {
-        qDebug() << "mMessageAudioPlayer in error state ("
+        qCDebug(lcAudio) << "mMessageAudioPlayer in error state ("
                  << mMessageAudioPlayer->error() << "), recreating";
 
         mMessageAudioPlayer->deleteLater();
         mMessageAudioPlayer = NULL;
+        mMessageSound.clear();
     }
 
     if (!mMessageAudioPlayer) {
         mMessageAudioPlayer = new QMediaPlayer(this);
         mMessageAudioPlayer->setAudioRole(QAudio::NotificationRole);
+        connect(mMessageAudioPlayer, SIGNAL(positionChanged(qint64)), SLOT(onMessagePositionChanged(qint64)));
+    }
+
+    if (mMessageSound.isEmpty()) {
+        mMessageSound = QUrl::fromLocalFile(GreeterContacts::instance()->incomingMessageSound());
+        mMessageAudioPlayer->setMedia(mMessageSound);
     }
+}
+
+void RingtoneWorker::playIncomingCallSound(qint64 requestTime)
+{
+    if (!qgetenv("PA_DISABLED").isEmpty()) {
+        return;
+    }
+
+    if (GreeterContacts::instance()->silentMode()) {
+        return;
+    }
+
+    loadCallSound();
+    if (mCallAudioPlayer->state() == QMediaPlayer::PlayingState) {
+        return;
+    }
+
+    mCallRequestTime = requestTime;
+    mCallAudioPlayer->setNotifyInterval(FIRST_FRAME_NOTIFY_INTERVAL);
+    mCallAudioPlaylist.setCurrentIndex(0);
+    mCallAudioPlayer->setPosition(0);
+    mCallAudioPlayer->play();
+}
+
+void RingtoneWorker::stopIncomingCallSound()
+{
+    if (mCallAudioPlayer) {
+        // WORKAROUND: if we call stop and the stream is already over, qmediaplayer plays again.
+        mCallAudioPlayer->pause();
+        mCallAudioPlayer->setPosition(0);
+    }
+    mCallRequestTime = -1;
+
+    if (mCallSoundChanged) {
+        mCallSoundChanged = false;
+        mCallAudioPlaylist.clear();
+        loadCallSound();
+    }
+}
+
+void RingtoneWorker::playIncomingMessageSound(qint64 requestTime)
+{
+    if (!qgetenv("PA_DISABLED").isEmpty()) {
+        return;
+    }
+
+    if (GreeterContacts::instance()->silentMode()) {
+        return;
+    }
+
+    loadMessageSound();
 
     // WORKAROUND: there is a bug in qmediaplayer/(media-hub?) that never goes into Stopped mode.
     if (mMessageAudioPlayer->duration() == mMessageAudioPlayer->position()) {
@@ -96,7 +178,9 @@ void RingtoneWorker::playIncomingMessageSound()
         return;
     }
 
-    mMessageAudioPlayer->setMedia(QUrl::fromLocalFile(GreeterContacts::instance()->incomingMessageSound()));
+    mMessageRequestTime = requestTime;
+    mMessageAudioPlayer->setNotifyInterval(FIRST_FRAME_NOTIFY_INTERVAL);
+    mMessageAudioPlayer->setPosition(0);
     mMessageAudioPlayer->play();
 }
 
@@ -104,17 +188,48 @@ void RingtoneWorker::stopIncomingMessageSound()
 {
     if (mMessageAudioPlayer) {
         mMessageAudioPlayer->pause();
-        mMessageAudioPlayer->deleteLater();
-        mMessageAudioPlayer = NULL;
+        mMessageAudioPlayer->setPosition(0);
+    }
+    mMessageRequestTime = -1;
+}
+
+void RingtoneWorker::onCallPositionChanged(qint64 position)
+{
+    if (mCallRequestTime < 0 || position <= 0) {
+        return;
+    }
+
+    qint64 latency = Ringtone::timestamp() - mCallRequestTime;
+    mCallRequestTime = -1;
+    mCallAudioPlayer->setNotifyInterval(DEFAULT_NOTIFY_INTERVAL);
+    qCDebug(lcAudio) << "Incoming call sound playing" << latency << "ms after the request";
+    Q_EMIT incomingCallSoundStarted(latency);
+}
+
+void RingtoneWorker::onMessagePositionChanged(qint64 position)
+{
+    if (mMessageRequestTime < 0 || position <= 0) {
+        return;
     }
+
+    qint64 latency = Ringtone::timestamp() - mMessageRequestTime;
+    mMessageRequestTime = -1;
+    mMessageAudioPlayer->setNotifyInterval(DEFAULT_NOTIFY_INTERVAL);
+    qCDebug(lcAudio) << "Incoming message sound playing" << latency << "ms after the request";
+    Q_EMIT incomingMessageSoundStarted(latency);
 }
 
 Ringtone::Ringtone(QObject *parent) :
-    QObject(parent)
+    QObject(parent), mCallRequestTime(-1)
 {
     mWorker = new RingtoneWorker();
     mWorker->moveToThread(&mThread);
+    connect(GreeterContacts::instance(), SIGNAL(soundSettingsChanged(QString)),
+            mWorker, SLOT(onSoundSettingsChanged(QString)));
+    connect(mWorker, SIGNAL(incomingCallSoundStarted(qint64)), SLOT(onIncomingCallSoundStarted(qint64)));
+    connect(mWorker, SIGNAL(incomingMessageSoundStarted(qint64)), SIGNAL(incomingMessageSoundStarted(qint64)));
     mThread.start();
+    QMetaObject::invokeMethod(mWorker, "preload", Qt::QueuedConnection);
     mVibrateEffect.setDuration(500);
 }
 
@@ -130,9 +245,29 @@ Ringtone *Ringtone::instance()
     return self;
 }
 
-void Ringtone::playIncomingCallSound()
+qint64 Ringtone::timestamp()
+{
+    QElapsedTimer timer;
+    timer.start();
+    return timer.msecsSinceReference();
+}
+
+void Ringtone::playIncomingCallSound(const QString &traceKey)
 {
-    QMetaObject::invokeMethod(mWorker, "playIncomingCallSound", Qt::QueuedConnection);
+    mCallRequestTime = timestamp();
+    mCallTraceKey = traceKey;
+    QMetaObject::invokeMethod(mWorker, "playIncomingCallSound", Qt::QueuedConnection,
+                              Q_ARG(qint64, mCallRequestTime));
+}
+
+void Ringtone::onIncomingCallSoundStarted(qint64 latency)
+{
+    // the sound started on the worker thread, so use the time it actually
+    // started rather than the time this got delivered
+    if (mCallRequestTime >= 0 && !mCallTraceKey.isEmpty()) {
+        LatencyTracer::instance()->append(mCallTraceKey, "ringtone", mCallRequestTime + latency);
+    }
+    Q_EMIT incomingCallSoundStarted(latency);
 }
 
 void Ringtone::stopIncomingCallSound()
@@ -146,7 +281,8 @@ void Ringtone::playIncomingMessageSound()
         mVibrateEffect.start();
     }
 
-    QMetaObject::invokeMethod(mWorker, "playIncomingMessageSound", Qt::QueuedConnection);
+    QMetaObject::invokeMethod(mWorker, "playIncomingMessageSound", Qt::QueuedConnection,
+                              Q_ARG(qint64, timestamp()));
 }
 
 void Ringtone::stopIncomingMessageSound()
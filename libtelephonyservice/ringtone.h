@@ -29,6 +29,7 @@
 #include <QFile>
 #include <QFeedbackHapticsEffect>
 #include <QDBusReply>
+#include <QUrl>
 #include <QDBusServiceWatcher>
 #include <QtDBus/QDBusInterface>
 #include <unistd.h>
@@ -42,16 +43,36 @@ public:
     RingtoneWorker(QObject *parent = 0);
 
 public Q_SLOTS:
-    void playIncomingCallSound();
+    // the request time is a monotonic timestamp in milliseconds, used to
+    // measure how long it takes until the sound is actually playing
+    void playIncomingCallSound(qint64 requestTime);
     void stopIncomingCallSound();
-    void playIncomingMessageSound();
+    void playIncomingMessageSound(qint64 requestTime);
     void stopIncomingMessageSound();
 
+    void preload();
+    void onSoundSettingsChanged(const QString &key);
+
+Q_SIGNALS:
+    void incomingCallSoundStarted(qint64 latency);
+    void incomingMessageSoundStarted(qint64 latency);
+
+private Q_SLOTS:
+    void onCallPositionChanged(qint64 position);
+    void onMessagePositionChanged(qint64 position);
+
 private:
+    void loadCallSound();
+    void loadMessageSound();
+
     QMediaPlayer *mCallAudioPlayer;
     QMediaPlaylist mCallAudioPlaylist;
+    bool mCallSoundChanged;
+    qint64 mCallRequestTime;
 
     QMediaPlayer *mMessageAudioPlayer;
+    QUrl mMessageSound;
+    qint64 mMessageRequestTime;
 };
 
 class Ringtone : public QObject
@@ -61,15 +82,31 @@ public:
     ~Ringtone();
     static Ringtone *instance();
 
+    // monotonic timestamp in milliseconds, shared with the worker thread
+    static qint64 timestamp();
+
 public Q_SLOTS:
-    void playIncomingCallSound();
+    // the trace key is the object path of the call, used to record in the
+    // LatencyTracer when the sound starts playing
+    void playIncomingCallSound(const QString &traceKey = QString());
     void stopIncomingCallSound();
 
     void playIncomingMessageSound();
     void stopIncomingMessageSound();
 
+Q_SIGNALS:
+    // emitted once the sound is playing, with the time it took since it was
+    // requested, in milliseconds
+    void incomingCallSoundStarted(qint64 latency);
+    void incomingMessageSoundStarted(qint64 latency);
+
+private Q_SLOTS:
+    void onIncomingCallSoundStarted(qint64 latency);
+
 private:
     explicit Ringtone(QObject *parent = 0);
+    qint64 mCallRequestTime;
+    QString mCallTraceKey;
     QFeedbackHapticsEffect mVibrateEffect;
     RingtoneWorker *mWorker;
     QThread mThread;
@@ -29,7 +29,12 @@
 #include "callmanager.h"
 #include "config.h"
 #include "greetercontacts.h"
+#include "handlersnapshot.h"
 #include "protocolmanager.h"
+#include "telephonylogging.h"
+
+#include <QDBusMessage>
+#include <QDBusPendingReply>
 
 #include <TelepathyQt/AccountSet>
 #include <TelepathyQt/ChannelClassSpec>
@@ -37,6 +42,10 @@
 #include <TelepathyQt/PendingReady>
 #include <TelepathyQt/PendingAccount>
 
+#define URFKILL_SERVICE "org.freedesktop.URfkill"
+#define URFKILL_OBJECT_PATH "/org/freedesktop/URfkill"
+#define URFKILL_INTERFACE "org.freedesktop.URfkill"
+
 template<> bool qMapLessThanKey<QStringList>(const QStringList &key1, const QStringList &key2) 
 { 
     return key1.size() > key2.size();  // sort by operator> !
@@ -56,10 +65,8 @@ TelepathyHelper::TelepathyHelper(QObject *parent)
       mChannelObserverPtr(NULL),
       mHandlerInterface(0),
       mApproverInterface(0),
-      mFlightModeInterface("org.freedesktop.URfkill",
-                           "/org/freedesktop/URfkill",
-                           "org.freedesktop.URfkill",
-                           QDBusConnection::systemBus())
+      mFlightMode(false),
+      mHandlerAccountIdsRequested(false)
 {
     mQmlAccounts = new AccountList(Protocol::AllFeatures, QString::null, this);
     mQmlVoiceAccounts = new AccountList(Protocol::VoiceCalls, QString::null, this);
@@ -97,7 +104,16 @@ TelepathyHelper::TelepathyHelper(QObject *parent)
     mClientRegistrar = Tp::ClientRegistrar::create(mAccountManager);
     connect(GreeterContacts::instance(), SIGNAL(phoneSettingsChanged(QString)), this, SLOT(onPhoneSettingsChanged(QString)));
     connect(GreeterContacts::instance(), SIGNAL(soundSettingsChanged(QString)), this, SLOT(onPhoneSettingsChanged(QString)));
-    connect(&mFlightModeInterface, SIGNAL(FlightModeChanged(bool)), this, SIGNAL(flightModeChanged()));
+
+    // flight mode is read often (from QML bindings too), so keep it cached and
+    // follow the changes instead of querying URfkill every time
+    QDBusConnection::systemBus().connect(URFKILL_SERVICE, URFKILL_OBJECT_PATH, URFKILL_INTERFACE,
+                                         "FlightModeChanged", this, SLOT(onFlightModeChanged(bool)));
+    QDBusMessage flightModeCall = QDBusMessage::createMethodCall(URFKILL_SERVICE, URFKILL_OBJECT_PATH,
+                                                                 URFKILL_INTERFACE, "IsFlightMode");
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(QDBusConnection::systemBus().asyncCall(flightModeCall), this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onFlightModeReply(QDBusPendingCallWatcher*)));
 
     mMmsEnabled = GreeterContacts::instance()->mmsEnabled();
 }
@@ -121,16 +137,52 @@ QStringList TelepathyHelper::accountIds()
             ids << account->accountId();
         }
     } else if (!GreeterContacts::instance()->isGreeterMode()) {
-        // if we are in greeter mode, we should not initialize the handler to get the account IDs
-        QDBusReply<QStringList> reply = handlerInterface()->call("AccountIds");
-        if (reply.isValid()) {
-            ids = reply.value();
+        // if we are in greeter mode, we should not initialize the handler to get the account IDs.
+        // Otherwise, take them from the handler snapshot and notify when it arrives.
+        if (!mHandlerAccountIdsRequested) {
+            mHandlerAccountIdsRequested = true;
+            QDBusConnection::sessionBus().connect("com.canonical.TelephonyServiceHandler",
+                                                  "/com/canonical/TelephonyServiceHandler",
+                                                  "com.canonical.TelephonyServiceHandler",
+                                                  "AccountIdsChanged",
+                                                  this, SLOT(onHandlerAccountIdsChanged(QStringList,qulonglong)));
+            connect(HandlerSnapshot::instance(), SIGNAL(loaded(QVariantMap)), SLOT(onHandlerSnapshotLoaded(QVariantMap)));
+            connect(HandlerSnapshot::instance(), SIGNAL(failed()), SLOT(onHandlerSnapshotFailed()));
+            HandlerSnapshot::instance()->request();
         }
+        ids = mHandlerAccountIds;
     }
 
     return ids;
 }
 
+void TelepathyHelper::onHandlerSnapshotLoaded(const QVariantMap &snapshot)
+{
+    mHandlerAccountIds = snapshot["accountIds"].toStringList();
+    Q_EMIT accountIdsChanged();
+}
+
+void TelepathyHelper::onHandlerSnapshotFailed()
+{
+    // ask again the next time the IDs are needed
+    HandlerSnapshot::instance()->disconnect(this);
+    QDBusConnection::sessionBus().disconnect("com.canonical.TelephonyServiceHandler",
+                                             "/com/canonical/TelephonyServiceHandler",
+                                             "com.canonical.TelephonyServiceHandler",
+                                             "AccountIdsChanged",
+                                             this, SLOT(onHandlerAccountIdsChanged(QStringList,qulonglong)));
+    mHandlerAccountIdsRequested = false;
+}
+
+void TelepathyHelper::onHandlerAccountIdsChanged(const QStringList &accountIds, qulonglong sequence)
+{
+    if (!HandlerSnapshot::instance()->isNewer(sequence) || accountIds == mHandlerAccountIds) {
+        return;
+    }
+    mHandlerAccountIds = accountIds;
+    Q_EMIT accountIdsChanged();
+}
+
 void TelepathyHelper::setMmsEnabled(bool enable)
 {
     GreeterContacts::instance()->setMmsEnabled(enable);
@@ -141,18 +193,37 @@ bool TelepathyHelper::mmsEnabled()
     return mMmsEnabled;
 }
 
-bool TelepathyHelper::flightMode()
+bool TelepathyHelper::flightMode() const
 {
-    QDBusReply<bool> reply = mFlightModeInterface.call("IsFlightMode");
-    if (reply.isValid()) {
-        return reply;
-    }
-    return false;
+    return mFlightMode;
 }
 
 void TelepathyHelper::setFlightMode(bool value)
 {
-    mFlightModeInterface.asyncCall("FlightMode", value);
+    QDBusMessage message = QDBusMessage::createMethodCall(URFKILL_SERVICE, URFKILL_OBJECT_PATH,
+                                                          URFKILL_INTERFACE, "FlightMode");
+    message << value;
+    QDBusConnection::systemBus().asyncCall(message);
+}
+
+void TelepathyHelper::onFlightModeChanged(bool flightMode)
+{
+    if (mFlightMode == flightMode) {
+        return;
+    }
+    mFlightMode = flightMode;
+    Q_EMIT flightModeChanged();
+}
+
+void TelepathyHelper::onFlightModeReply(QDBusPendingCallWatcher *watcher)
+{
+    QDBusPendingReply<bool> reply = *watcher;
+    if (!reply.isError()) {
+        onFlightModeChanged(reply.argumentAt<0>());
+    } else {
+        qCWarning(lcAccounts) << "Failed to get the flight mode state from URfkill:" << reply.error().message();
+    }
+    watcher->deleteLater();
 }
 
 QList<AccountEntry*> TelepathyHelper::accounts() const
@@ -502,7 +573,7 @@ void TelepathyHelper::onAccountManagerReady(Tp::PendingOperation *op)
 {
     // if the account manager ready job returns an error, just fail silently
     if (op->isError()) {
-        qCritical() << "Failed to prepare Tp::AccountManager" << op->errorName() << op->errorMessage();
+        qCCritical(lcAccounts) << "Failed to prepare Tp::AccountManager" << op->errorName() << op->errorMessage();
         return;
     }
 
@@ -24,6 +24,7 @@
 #define TELEPATHYHELPER_H
 
 #include <QObject>
+#include <QDBusPendingCallWatcher>
 #include <QQmlListProperty>
 #include <TelepathyQt/AccountManager>
 #include <TelepathyQt/Contact>
@@ -109,7 +110,7 @@ public:
     bool mmsEnabled();
     QVariantMap simNames() const;
     void setMmsEnabled(bool value);
-    bool flightMode();
+    bool flightMode() const;
     void setFlightMode(bool value);
     bool ready() const;
     QStringList accountIds();
@@ -155,6 +156,11 @@ private Q_SLOTS:
     void onNewAccount(const Tp::AccountPtr &account);
     void onAccountRemoved();
     void onPhoneSettingsChanged(const QString&);
+    void onFlightModeChanged(bool flightMode);
+    void onFlightModeReply(QDBusPendingCallWatcher *watcher);
+    void onHandlerSnapshotLoaded(const QVariantMap &snapshot);
+    void onHandlerSnapshotFailed();
+    void onHandlerAccountIdsChanged(const QStringList &accountIds, qulonglong sequence);
 
 private:
     Tp::AccountManagerPtr mAccountManager;
@@ -178,7 +184,9 @@ private:
     QVariantMap mSimNames;
     mutable QDBusInterface *mHandlerInterface;
     mutable QDBusInterface *mApproverInterface;
-    QDBusInterface mFlightModeInterface;
+    bool mFlightMode;
+    bool mHandlerAccountIdsRequested;
+    QStringList mHandlerAccountIds;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(TelepathyHelper::AccountTypes)
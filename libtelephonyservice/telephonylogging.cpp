@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "telephonylogging.h"
+
+Q_LOGGING_CATEGORY(lcTelephony, "telephony", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcAccounts, "telephony.accounts", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcAudio, "telephony.audio", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcCall, "telephony.call", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcChat, "telephony.chat", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcContacts, "telephony.contacts", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcHandler, "telephony.handler", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcHandlerCall, "telephony.handler.call", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcHandlerText, "telephony.handler.text", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcIndicator, "telephony.indicator", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcApprover, "telephony.approver", QtInfoMsg)
+
+void setTelephonyLoggingRules(const QString &rules)
+{
+    // QT_LOGGING_RULES is applied after these, so it still wins
+    QString filterRules = rules;
+    filterRules.replace(';', '\n');
+    QLoggingCategory::setFilterRules(filterRules);
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TELEPHONYLOGGING_H
+#define TELEPHONYLOGGING_H
+
+#include <QLoggingCategory>
+
+/* The logging categories of all the telephony-service components. Debug
+ * messages are off by default and cost a single check when disabled; they
+ * can be turned on with the usual Qt logging rules, for example
+ *   QT_LOGGING_RULES="telephony.handler.*.debug=true"
+ * or at runtime through the SetLoggingRules method of the handler and the
+ * indicator. Building with DISABLE_DEBUG_LOGGING removes them entirely. */
+Q_DECLARE_LOGGING_CATEGORY(lcTelephony)
+Q_DECLARE_LOGGING_CATEGORY(lcAccounts)
+Q_DECLARE_LOGGING_CATEGORY(lcAudio)
+Q_DECLARE_LOGGING_CATEGORY(lcCall)
+Q_DECLARE_LOGGING_CATEGORY(lcChat)
+Q_DECLARE_LOGGING_CATEGORY(lcContacts)
+Q_DECLARE_LOGGING_CATEGORY(lcHandler)
+Q_DECLARE_LOGGING_CATEGORY(lcHandlerCall)
+Q_DECLARE_LOGGING_CATEGORY(lcHandlerText)
+Q_DECLARE_LOGGING_CATEGORY(lcIndicator)
+Q_DECLARE_LOGGING_CATEGORY(lcApprover)
+
+#ifdef TELEPHONY_NO_DEBUG_LOGGING
+// neither the message nor its arguments get compiled in
+#undef qCDebug
+#define qCDebug(category, ...) QT_NO_QDEBUG_MACRO()
+#endif
+
+// replaces the rules set through this function before, the rules are
+// separated by new lines or semicolons
+void setTelephonyLoggingRules(const QString &rules);
+
+#endif // TELEPHONYLOGGING_H
@@ -0,0 +1,407 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "toneengine.h"
+#include "tonegenerator.h"
+#include "telephonylogging.h"
+
+#include <QDebug>
+#include <math.h>
+
+#define TONE_SAMPLE_RATE 48000
+/* the amount of audio queued ahead in the stream, which bounds the latency */
+#define TONE_TARGET_LATENCY 20000 /* in microseconds */
+#define SINE_TABLE_BITS 11
+#define SINE_TABLE_SIZE (1 << SINE_TABLE_BITS)
+/* each component of a dual tone uses at most this amplitude */
+#define TONE_AMPLITUDE 0.35
+/* call progress tones, following the CEPT recommendation */
+#define PROGRESS_FREQUENCY 425
+
+static qint16 sineTable[SINE_TABLE_SIZE];
+
+/* DTMF row and column frequencies for keys 0..9, * and # */
+static const uint dtmfFrequencies[12][2] = {
+    { 941, 1336 }, { 697, 1209 }, { 697, 1336 }, { 697, 1477 },
+    { 770, 1209 }, { 770, 1336 }, { 770, 1477 }, { 852, 1209 },
+    { 852, 1336 }, { 852, 1477 }, { 941, 1209 }, { 941, 1477 }
+};
+
+static void contextStateCallback(pa_context *context, void *userdata)
+{
+    Q_UNUSED(context);
+    static_cast<ToneEngine*>(userdata)->contextStateChanged();
+}
+
+static void streamStateCallback(pa_stream *stream, void *userdata)
+{
+    Q_UNUSED(stream);
+    static_cast<ToneEngine*>(userdata)->streamStateChanged();
+}
+
+static void streamWriteCallback(pa_stream *stream, size_t bytes, void *userdata)
+{
+    Q_UNUSED(stream);
+    static_cast<ToneEngine*>(userdata)->writeSamples(bytes);
+}
+
+ToneEngine::ToneEngine()
+    : m_mainLoop(0), m_context(0), m_stream(0), m_available(false), m_corked(true),
+      m_loop(false), m_segment(0), m_segmentPosition(0), m_phase1(0), m_phase2(0),
+      m_silentBytes(0), m_requestTime(0), m_waitingFirstSamples(false), m_lastStartLatency(-1)
+{
+    if (sineTable[SINE_TABLE_SIZE / 4] == 0) {
+        for (int i = 0; i < SINE_TABLE_SIZE; ++i) {
+            sineTable[i] = qRound(sin(2 * M_PI * i / SINE_TABLE_SIZE) * TONE_AMPLITUDE * 32767);
+        }
+    }
+
+    m_mainLoop = pa_threaded_mainloop_new();
+    if (!m_mainLoop || pa_threaded_mainloop_start(m_mainLoop) != 0) {
+        qCWarning(lcAudio) << "Unable to start the pulseaudio mainloop for tones";
+        return;
+    }
+
+    pa_threaded_mainloop_lock(m_mainLoop);
+    pa_proplist *proplist = pa_proplist_new();
+    pa_proplist_sets(proplist, PA_PROP_APPLICATION_NAME, "telephony-service tones");
+    m_context = pa_context_new_with_proplist(pa_threaded_mainloop_get_api(m_mainLoop), NULL, proplist);
+    pa_proplist_free(proplist);
+    if (m_context) {
+        // the connection is completed asynchronously, tonegend is used until then
+        pa_context_set_state_callback(m_context, contextStateCallback, this);
+        if (pa_context_connect(m_context, NULL, PA_CONTEXT_NOAUTOSPAWN, NULL) < 0) {
+            qCWarning(lcAudio) << "Unable to connect to pulseaudio for tones";
+        }
+    }
+    pa_threaded_mainloop_unlock(m_mainLoop);
+}
+
+ToneEngine::~ToneEngine()
+{
+    if (!m_mainLoop) {
+        return;
+    }
+
+    pa_threaded_mainloop_stop(m_mainLoop);
+    if (m_stream) {
+        pa_stream_disconnect(m_stream);
+        pa_stream_unref(m_stream);
+    }
+    if (m_context) {
+        pa_context_disconnect(m_context);
+        pa_context_unref(m_context);
+    }
+    pa_threaded_mainloop_free(m_mainLoop);
+}
+
+bool ToneEngine::isAvailable()
+{
+    if (!m_mainLoop) {
+        return false;
+    }
+    pa_threaded_mainloop_lock(m_mainLoop);
+    bool available = m_available;
+    pa_threaded_mainloop_unlock(m_mainLoop);
+    return available;
+}
+
+bool ToneEngine::startEventTone(uint event, uint duration)
+{
+    if (!m_mainLoop) {
+        return false;
+    }
+
+    pa_threaded_mainloop_lock(m_mainLoop);
+    if (!m_available) {
+        pa_threaded_mainloop_unlock(m_mainLoop);
+        return false;
+    }
+
+    buildPattern(event, duration);
+    if (m_pattern.isEmpty()) {
+        pa_threaded_mainloop_unlock(m_mainLoop);
+        return false;
+    }
+
+    m_silentBytes = 0;
+    m_requestTime = pa_rtclock_now();
+    m_waitingFirstSamples = true;
+    m_lastStartLatency = -1;
+
+    // drop whatever is still queued so the new tone starts right away
+    pa_operation *o = pa_stream_flush(m_stream, NULL, NULL);
+    if (o) {
+        pa_operation_unref(o);
+    }
+    if (m_corked) {
+        o = pa_stream_cork(m_stream, 0, NULL, NULL);
+        if (o) {
+            pa_operation_unref(o);
+        }
+        m_corked = false;
+    }
+    pa_threaded_mainloop_unlock(m_mainLoop);
+    return true;
+}
+
+void ToneEngine::stopTone()
+{
+    if (!m_mainLoop) {
+        return;
+    }
+
+    pa_threaded_mainloop_lock(m_mainLoop);
+    m_pattern.clear();
+    m_waitingFirstSamples = false;
+    if (m_available && !m_corked) {
+        pa_operation *o = pa_stream_cork(m_stream, 1, NULL, NULL);
+        if (o) {
+            pa_operation_unref(o);
+        }
+        o = pa_stream_flush(m_stream, NULL, NULL);
+        if (o) {
+            pa_operation_unref(o);
+        }
+        m_corked = true;
+    }
+    pa_threaded_mainloop_unlock(m_mainLoop);
+}
+
+qint64 ToneEngine::lastStartLatency()
+{
+    if (!m_mainLoop) {
+        return -1;
+    }
+    pa_threaded_mainloop_lock(m_mainLoop);
+    qint64 latency = m_lastStartLatency;
+    pa_threaded_mainloop_unlock(m_mainLoop);
+    return latency;
+}
+
+void ToneEngine::contextStateChanged()
+{
+    switch (pa_context_get_state(m_context)) {
+    case PA_CONTEXT_READY:
+        createStream();
+        break;
+    case PA_CONTEXT_FAILED:
+    case PA_CONTEXT_TERMINATED:
+        qCWarning(lcAudio) << "Lost the pulseaudio connection for tones, falling back to tonegend";
+        m_available = false;
+        break;
+    default:
+        break;
+    }
+}
+
+void ToneEngine::streamStateChanged()
+{
+    switch (pa_stream_get_state(m_stream)) {
+    case PA_STREAM_READY:
+        m_available = true;
+        break;
+    case PA_STREAM_FAILED:
+    case PA_STREAM_TERMINATED:
+        qCWarning(lcAudio) << "The tone stream failed, falling back to tonegend";
+        m_available = false;
+        break;
+    default:
+        break;
+    }
+}
+
+void ToneEngine::createStream()
+{
+    pa_sample_spec spec;
+    spec.format = PA_SAMPLE_S16NE;
+    spec.rate = TONE_SAMPLE_RATE;
+    spec.channels = 1;
+
+    pa_proplist *proplist = pa_proplist_new();
+    pa_proplist_sets(proplist, PA_PROP_MEDIA_ROLE, "phone");
+    m_stream = pa_stream_new_with_proplist(m_context, "Tones", &spec, NULL, proplist);
+    pa_proplist_free(proplist);
+    if (!m_stream) {
+        qCWarning(lcAudio) << "Unable to create the tone stream";
+        return;
+    }
+
+    pa_stream_set_state_callback(m_stream, streamStateCallback, this);
+    pa_stream_set_write_callback(m_stream, streamWriteCallback, this);
+
+    // keep just a few milliseconds queued and start playing as soon as there is data
+    pa_buffer_attr attr;
+    attr.maxlength = (uint32_t) -1;
+    attr.tlength = pa_usec_to_bytes(TONE_TARGET_LATENCY, &spec);
+    attr.prebuf = 0;
+    attr.minreq = (uint32_t) -1;
+    attr.fragsize = (uint32_t) -1;
+
+    pa_stream_flags_t flags = pa_stream_flags_t(PA_STREAM_START_CORKED |
+                                                PA_STREAM_ADJUST_LATENCY |
+                                                PA_STREAM_INTERPOLATE_TIMING |
+                                                PA_STREAM_AUTO_TIMING_UPDATE);
+    if (pa_stream_connect_playback(m_stream, NULL, &attr, flags, NULL, NULL) < 0) {
+        qCWarning(lcAudio) << "Unable to connect the tone stream";
+    }
+}
+
+void ToneEngine::addSegment(uint freq1, uint freq2, uint duration)
+{
+    // phase steps for a 32 bit accumulator walking the sine table
+    Segment segment;
+    segment.step1 = (uint)(((quint64)freq1 << 32) / TONE_SAMPLE_RATE);
+    segment.step2 = (uint)(((quint64)freq2 << 32) / TONE_SAMPLE_RATE);
+    segment.samples = (quint64)duration * TONE_SAMPLE_RATE / 1000;
+    m_pattern << segment;
+}
+
+void ToneEngine::buildPattern(uint event, uint duration)
+{
+    m_pattern.clear();
+    m_loop = false;
+    m_segment = 0;
+    m_segmentPosition = 0;
+    m_phase1 = 0;
+    m_phase2 = 0;
+
+    if (event < 12) {
+        addSegment(dtmfFrequencies[event][0], dtmfFrequencies[event][1], duration);
+        return;
+    }
+
+    switch (event) {
+    case DIALING_TONE:
+        addSegment(PROGRESS_FREQUENCY, 0, 0);
+        break;
+    case RINGING_TONE:
+        addSegment(PROGRESS_FREQUENCY, 0, 1000);
+        addSegment(0, 0, 4000);
+        m_loop = true;
+        break;
+    case WAITING_TONE:
+        addSegment(PROGRESS_FREQUENCY, 0, 200);
+        addSegment(0, 0, 200);
+        addSegment(PROGRESS_FREQUENCY, 0, 200);
+        addSegment(0, 0, WAITING_PLAYBACK_DURATION - 400);
+        m_loop = true;
+        break;
+    case CALL_ENDED_TONE:
+        for (int i = 0; i < 3; ++i) {
+            addSegment(PROGRESS_FREQUENCY, 0, 200);
+            addSegment(0, 0, 200);
+        }
+        break;
+    default:
+        return;
+    }
+
+    // a duration overrides the pattern's own length
+    if (duration > 0 && !m_pattern.isEmpty()) {
+        uint total = 0;
+        Q_FOREACH(const Segment &segment, m_pattern) {
+            total += segment.samples;
+        }
+        uint wanted = (quint64)duration * TONE_SAMPLE_RATE / 1000;
+        if (m_loop || total == 0 || total > wanted) {
+            m_loop = false;
+            QVector<Segment> pattern;
+            for (int i = 0; wanted > 0; i = (i + 1) % m_pattern.count()) {
+                Segment segment = m_pattern[i];
+                if (segment.samples == 0 || segment.samples > wanted) {
+                    segment.samples = wanted;
+                }
+                wanted -= segment.samples;
+                pattern << segment;
+            }
+            m_pattern = pattern;
+        }
+    }
+}
+
+void ToneEngine::writeSamples(size_t bytes)
+{
+    void *data = NULL;
+    if (pa_stream_begin_write(m_stream, &data, &bytes) < 0 || !data) {
+        return;
+    }
+
+    qint16 *samples = static_cast<qint16*>(data);
+    size_t count = bytes / sizeof(qint16);
+    bool audible = false;
+
+    for (size_t i = 0; i < count; ++i) {
+        if (m_segment >= m_pattern.count()) {
+            samples[i] = 0;
+            continue;
+        }
+
+        const Segment &segment = m_pattern[m_segment];
+        int value = 0;
+        if (segment.step1) {
+            value += sineTable[m_phase1 >> (32 - SINE_TABLE_BITS)];
+            m_phase1 += segment.step1;
+        }
+        if (segment.step2) {
+            value += sineTable[m_phase2 >> (32 - SINE_TABLE_BITS)];
+            m_phase2 += segment.step2;
+        }
+        samples[i] = value;
+        audible |= value != 0;
+
+        if (segment.samples != 0 && ++m_segmentPosition >= segment.samples) {
+            m_segmentPosition = 0;
+            m_phase1 = 0;
+            m_phase2 = 0;
+            if (++m_segment >= m_pattern.count() && m_loop) {
+                m_segment = 0;
+            }
+        }
+    }
+
+    if (m_waitingFirstSamples && audible) {
+        // what was already queued was flushed, so these samples play after
+        // the current stream latency
+        pa_usec_t latency = 0;
+        int negative = 0;
+        if (pa_stream_get_latency(m_stream, &latency, &negative) < 0 || negative) {
+            latency = 0;
+        }
+        m_lastStartLatency = (pa_rtclock_now() - m_requestTime) + latency;
+        m_waitingFirstSamples = false;
+    }
+
+    pa_stream_write(m_stream, data, bytes, NULL, 0, PA_SEEK_RELATIVE);
+
+    // once the tone is over and the silence after it was queued, stop
+    // feeding the stream so the sink can suspend
+    if (m_segment >= m_pattern.count()) {
+        m_silentBytes += bytes;
+        if (m_silentBytes >= pa_usec_to_bytes(TONE_TARGET_LATENCY, pa_stream_get_sample_spec(m_stream))) {
+            pa_operation *o = pa_stream_cork(m_stream, 1, NULL, NULL);
+            if (o) {
+                pa_operation_unref(o);
+            }
+            m_corked = true;
+            m_silentBytes = 0;
+        }
+    } else {
+        m_silentBytes = 0;
+    }
+}
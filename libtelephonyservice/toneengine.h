@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TONEENGINE_H
+#define TONEENGINE_H
+
+#include <QVector>
+#include <pulse/pulseaudio.h>
+
+/* Synthesizes DTMF and call progress tones in process into a PulseAudio
+ * playback stream that is kept open (and corked while idle), so starting a
+ * tone is only a matter of swapping the pattern the stream is fed from.
+ * The events are the same ones used by tonegend, so ToneGenerator can fall
+ * back to it for anything the engine does not know or while the stream is
+ * not ready. All the audio work happens on the PulseAudio thread. */
+class ToneEngine
+{
+public:
+    ToneEngine();
+    ~ToneEngine();
+
+    /* true once the playback stream is connected */
+    bool isAvailable();
+
+    /* Starts the given tonegend event (0..11 for DTMF keys), replacing
+     * whatever is playing. A duration of 0 plays the tone's own pattern,
+     * otherwise the tone stops by itself after duration milliseconds.
+     * Returns false if the event is not supported or the stream is not ready */
+    bool startEventTone(uint event, uint duration = 0);
+    void stopTone();
+
+    /* Time between the last startEventTone() call and its first samples
+     * reaching the speaker, estimated from the stream latency. In microseconds,
+     * -1 if not known yet */
+    qint64 lastStartLatency();
+
+    /* Callbacks to be used internally, called with the mainloop locked */
+    void contextStateChanged();
+    void streamStateChanged();
+    void writeSamples(size_t bytes);
+
+private:
+    struct Segment {
+        uint step1;
+        uint step2;
+        uint samples; /* 0 means forever */
+    };
+
+    void createStream();
+    void buildPattern(uint event, uint duration);
+    void addSegment(uint freq1, uint freq2, uint duration);
+
+    pa_threaded_mainloop *m_mainLoop;
+    pa_context *m_context;
+    pa_stream *m_stream;
+    bool m_available;
+    bool m_corked;
+
+    /* current tone, only touched with the mainloop locked */
+    QVector<Segment> m_pattern;
+    bool m_loop;
+    int m_segment;
+    uint m_segmentPosition;
+    uint m_phase1, m_phase2;
+    size_t m_silentBytes;
+
+    pa_usec_t m_requestTime;
+    bool m_waitingFirstSamples;
+    qint64 m_lastStartLatency;
+};
+
+#endif // TONEENGINE_H
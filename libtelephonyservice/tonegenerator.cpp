@@ -21,20 +21,32 @@
  */
 
 #include "tonegenerator.h"
+#include "telephonylogging.h"
+#ifdef USE_PULSEAUDIO
+#include "toneengine.h"
+#endif
 
 #include <QDebug>
 #include <QTimer>
 #include <QDBusMessage>
 #include <QDBusConnection>
 
-/* Use tone-generator (tonegend) via D-Bus */
+/* Tones are synthesized in process when possible, tone-generator (tonegend)
+ * is used via D-Bus otherwise */
 #define TONEGEN_DBUS_SERVICE_NAME "com.Nokia.Telephony.Tones"
 #define TONEGEN_DBUS_OBJ_PATH "/com/Nokia/Telephony/Tones"
 #define TONEGEN_DBUS_IFACE_NAME TONEGEN_DBUS_SERVICE_NAME
 
 ToneGenerator::ToneGenerator(QObject *parent) :
-    QObject(parent), mDTMFPlaybackTimer(nullptr), mWaitingPlaybackTimer(new QTimer(this))
+    QObject(parent), mDTMFPlaybackTimer(nullptr), mWaitingPlaybackTimer(new QTimer(this)),
+    mToneEngine(nullptr), mToneGendPlaying(false)
 {
+#ifdef USE_PULSEAUDIO
+    if (qgetenv("PA_DISABLED").isEmpty()) {
+        mToneEngine = new ToneEngine();
+    }
+#endif
+
     // the waiting tone is played in loop
     connect(mWaitingPlaybackTimer, SIGNAL(timeout()), this, SLOT(playWaitingTone()));
     mWaitingPlaybackTimer->setSingleShot(true);
@@ -44,6 +56,9 @@ ToneGenerator::~ToneGenerator()
 {
     this->stopDTMFTone();
     this->stopWaitingTone();
+#ifdef USE_PULSEAUDIO
+    delete mToneEngine;
+#endif
 }
 
 ToneGenerator *ToneGenerator::instance()
@@ -52,6 +67,16 @@ ToneGenerator *ToneGenerator::instance()
     return self;
 }
 
+qint64 ToneGenerator::lastToneLatency() const
+{
+#ifdef USE_PULSEAUDIO
+    if (mToneEngine) {
+        return mToneEngine->lastStartLatency();
+    }
+#endif
+    return -1;
+}
+
 bool ToneGenerator::startEventTone(uint key)
 {
     QDBusMessage startMsg = QDBusMessage::createMethodCall(
@@ -64,17 +89,25 @@ bool ToneGenerator::startEventTone(uint key)
     toneArgs << QVariant((int)0);  // volume is ignored
     toneArgs << QVariant((uint)0); // duration is ignored
     startMsg.setArguments(toneArgs);
-    return QDBusConnection::sessionBus().send(startMsg);
+    mToneGendPlaying = QDBusConnection::sessionBus().send(startMsg);
+    return mToneGendPlaying;
 }
 
 void ToneGenerator::playDTMFTone(uint key)
 {
-    qDebug() << __PRETTY_FUNCTION__ << key;
+    qCDebug(lcAudio) << __PRETTY_FUNCTION__ << key;
     if (key > 11) {
-        qDebug() << "Invalid DTMF tone, ignore.";
+        qCDebug(lcAudio) << "Invalid DTMF tone, ignore.";
         return;
     }
 
+#ifdef USE_PULSEAUDIO
+    // the engine stops the tone by itself
+    if (mToneEngine && mToneEngine->startEventTone(key, DTMF_LOCAL_PLAYBACK_DURATION)) {
+        return;
+    }
+#endif
+
     if (startEventTone(key)) {
         if (!mDTMFPlaybackTimer) {
             mDTMFPlaybackTimer = new QTimer(this);
@@ -87,6 +120,15 @@ void ToneGenerator::playDTMFTone(uint key)
 
 void ToneGenerator::stopTone()
 {
+#ifdef USE_PULSEAUDIO
+    if (mToneEngine) {
+        mToneEngine->stopTone();
+    }
+#endif
+    if (!mToneGendPlaying) {
+        return;
+    }
+    mToneGendPlaying = false;
     QDBusConnection::sessionBus().send(
         QDBusMessage::createMethodCall(
             TONEGEN_DBUS_SERVICE_NAME,
@@ -105,6 +147,13 @@ void ToneGenerator::stopDTMFTone()
 
 void ToneGenerator::playWaitingTone()
 {
+#ifdef USE_PULSEAUDIO
+    // the synthesized waiting tone repeats by itself
+    if (mToneEngine && mToneEngine->startEventTone(WAITING_TONE)) {
+        return;
+    }
+#endif
+
     if (mWaitingPlaybackTimer->isActive()) {
         stopTone();
     }
@@ -122,16 +171,32 @@ void ToneGenerator::stopWaitingTone()
 
 void ToneGenerator::playCallEndedTone()
 {
+#ifdef USE_PULSEAUDIO
+    if (mToneEngine && mToneEngine->startEventTone(CALL_ENDED_TONE)) {
+        return;
+    }
+#endif
+
     startEventTone(CALL_ENDED_TONE);
     QTimer::singleShot(2000, this, SLOT(stopTone()));
 }
 
 void ToneGenerator::playDialingTone()
 {
+#ifdef USE_PULSEAUDIO
+    if (mToneEngine && mToneEngine->startEventTone(DIALING_TONE)) {
+        return;
+    }
+#endif
     startEventTone(DIALING_TONE);
 }
 
 void ToneGenerator::playRingingTone()
 {
+#ifdef USE_PULSEAUDIO
+    if (mToneEngine && mToneEngine->startEventTone(RINGING_TONE)) {
+        return;
+    }
+#endif
     startEventTone(RINGING_TONE);
 }
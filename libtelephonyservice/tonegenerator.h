@@ -26,6 +26,7 @@
 #include <QObject>
 
 class QTimer;
+class ToneEngine;
 
 static const int DTMF_LOCAL_PLAYBACK_DURATION = 200; /* in milliseconds */
 static const int WAITING_PLAYBACK_DURATION = 8000; /* in milliseconds */
@@ -41,6 +42,10 @@ public:
     ~ToneGenerator();
     static ToneGenerator *instance();
 
+    /* Key-to-audio latency of the last tone synthesized in process, in
+     * microseconds, or -1 if tones are played by tonegend */
+    qint64 lastToneLatency() const;
+
 public Q_SLOTS:
     /**
      * Valid tones: 0..9 (number keys), 10 (*), 11 (#)
@@ -61,6 +66,8 @@ private:
     explicit ToneGenerator(QObject *parent = 0);
     QTimer* mDTMFPlaybackTimer;
     QTimer* mWaitingPlaybackTimer;
+    ToneEngine *mToneEngine;
+    bool mToneGendPlaying;
 };
 
 #endif // TONEGENERATOR_H
@@ -23,6 +23,7 @@
 #include "ussdmanager.h"
 #include "telepathyhelper.h"
 #include "accountentry.h"
+#include "telephonylogging.h"
 
 #include <TelepathyQt/ContactManager>
 #include <QDBusInterface>
@@ -103,7 +104,7 @@ void USSDManager::onConnectionChanged()
     disconnectAllSignals();
 
     if (mAccount->account()->connection().isNull()) {
-        qDebug() << "USSDManager: Failed to connect signals";
+        qCDebug(lcCall) << "USSDManager: Failed to connect signals";
         return;
     }
 
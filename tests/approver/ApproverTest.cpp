@@ -18,6 +18,7 @@
 
 #include <QtCore/QObject>
 #include <QtTest/QtTest>
+#include <QDBusArgument>
 #include "telepathytest.h"
 #include "approvercontroller.h"
 #include "mockcontroller.h"
@@ -25,6 +26,15 @@
 #include "accountentryfactory.h"
 #include "telepathyhelper.h"
 
+// number of incoming calls used to measure the latency
+#define LATENCY_CALLS 20
+// default p95 budget for the snap decision, can be overridden with the
+// INCOMING_CALL_BUDGET_MS environment variable
+#define DEFAULT_INCOMING_CALL_BUDGET_MS 1000
+// the contact the approver is started with, see CMakeLists.txt
+#define KNOWN_CALLER_NAME "Alice"
+#define KNOWN_CALLER_NUMBER "5557777"
+
 class ApproverTest : public TelepathyTest
 {
     Q_OBJECT
@@ -35,8 +45,13 @@ private Q_SLOTS:
     void cleanup();
     void testSnapDecisionTimeout();
     void testAcceptCall();
+    void testTwoIncomingCalls_data();
+    void testTwoIncomingCalls();
     void testCarKitOutgoingCall();
     void testCarKitIncomingCall();
+    void testKnownCaller();
+    void testUnknownCaller();
+    void testIncomingCallLatency();
 
 private:
     void waitForCallActive(const QString &callerId);
@@ -106,6 +121,60 @@ void ApproverTest::testAcceptCall()
     mMockController->HangupCall(callerId);
 }
 
+void ApproverTest::testTwoIncomingCalls_data()
+{
+    QTest::addColumn<bool>("accept");
+    QTest::addColumn<QString>("expectedState");
+
+    QTest::newRow("accept") << true << "accepted";
+    QTest::newRow("reject") << false << "disconnected";
+}
+
+void ApproverTest::testTwoIncomingCalls()
+{
+    QFETCH(bool, accept);
+    QFETCH(QString, expectedState);
+
+    // two calls ringing at the same time on the same account
+    QString firstCallerId("4561111");
+    QString secondCallerId("4562222");
+
+    QVariantMap properties;
+    properties["State"] = "incoming";
+
+    QDBusInterface notificationsMock("org.freedesktop.Notifications", "/org/freedesktop/Notifications", "org.freedesktop.Notifications");
+    QSignalSpy notificationSpy(&notificationsMock, SIGNAL(MockNotificationReceived(QString, uint, QString, QString, QString, QStringList, QVariantMap, int)));
+    properties["Caller"] = firstCallerId;
+    QString firstObjectPath = mMockController->placeCall(properties);
+    TRY_COMPARE(notificationSpy.count(), 1);
+    properties["Caller"] = secondCallerId;
+    QString secondObjectPath = mMockController->placeCall(properties);
+    TRY_COMPARE(notificationSpy.count(), 2);
+    QVERIFY(notificationSpy.last()[4].toString().contains(secondCallerId));
+
+    // the snap decision on screen is the one for the second call, so that is
+    // the call that has to be answered or rejected
+    QSignalSpy callStateSpy(mMockController, SIGNAL(CallStateChanged(QString,QString,QString)));
+    if (accept) {
+        ApproverController::instance()->acceptCall();
+    } else {
+        ApproverController::instance()->rejectCall();
+    }
+    TRY_VERIFY(callStateSpy.count() > 0);
+    QCOMPARE(callStateSpy.first()[0].toString(), secondCallerId);
+    QCOMPARE(callStateSpy.first()[1].toString(), secondObjectPath);
+    QCOMPARE(callStateSpy.first()[2].toString(), expectedState);
+
+    // and the first call is left alone
+    QTest::qWait(1000);
+    Q_FOREACH(const QList<QVariant> &args, callStateSpy) {
+        QVERIFY(args[1].toString() != firstObjectPath);
+    }
+
+    mMockController->HangupCall(firstCallerId);
+    mMockController->HangupCall(secondCallerId);
+}
+
 void ApproverTest::testCarKitOutgoingCall()
 {
     // make sure that an outgoing call placed outside of telepathy is handle correctly
@@ -165,5 +234,95 @@ void ApproverTest::testCarKitIncomingCall()
     mMockController->HangupCall(callerId);
 }
 
+void ApproverTest::testKnownCaller()
+{
+    QString callerId(KNOWN_CALLER_NUMBER);
+    QVariantMap properties;
+    properties["Caller"] = callerId;
+    properties["State"] = "incoming";
+
+    QDBusInterface notificationsMock("org.freedesktop.Notifications", "/org/freedesktop/Notifications", "org.freedesktop.Notifications");
+    QSignalSpy notificationSpy(&notificationsMock, SIGNAL(MockNotificationReceived(QString, uint, QString, QString, QString, QStringList, QVariantMap, int)));
+    mMockController->placeCall(properties);
+    TRY_COMPARE(notificationSpy.count(), 1);
+
+    // the contact was resolved before the snap decision was shown, so the
+    // very first notification already has the name
+    QCOMPARE(notificationSpy.first()[3].toString(), QString(KNOWN_CALLER_NAME));
+    mMockController->HangupCall(callerId);
+}
+
+void ApproverTest::testUnknownCaller()
+{
+    QString callerId("5558888");
+    QVariantMap properties;
+    properties["Caller"] = callerId;
+    properties["State"] = "incoming";
+
+    QDBusInterface notificationsMock("org.freedesktop.Notifications", "/org/freedesktop/Notifications", "org.freedesktop.Notifications");
+    QSignalSpy notificationSpy(&notificationsMock, SIGNAL(MockNotificationReceived(QString, uint, QString, QString, QString, QStringList, QVariantMap, int)));
+    mMockController->placeCall(properties);
+    TRY_COMPARE(notificationSpy.count(), 1);
+
+    // no contact matches, so the snap decision falls back to the number
+    QCOMPARE(notificationSpy.first()[3].toString(), QString("Unknown caller"));
+    QVERIFY(notificationSpy.first()[4].toString().contains(callerId));
+    mMockController->HangupCall(callerId);
+}
+
+void ApproverTest::testIncomingCallLatency()
+{
+    bool ok;
+    int budget = qgetenv("INCOMING_CALL_BUDGET_MS").toInt(&ok);
+    if (!ok || budget <= 0) {
+        budget = DEFAULT_INCOMING_CALL_BUDGET_MS;
+    }
+
+    ApproverController::instance()->resetIncomingCallLatencies();
+
+    QDBusInterface notificationsMock("org.freedesktop.Notifications", "/org/freedesktop/Notifications", "org.freedesktop.Notifications");
+    QSignalSpy notificationSpy(&notificationsMock, SIGNAL(MockNotificationReceived(QString, uint, QString, QString, QString, QStringList, QVariantMap, int)));
+    for (int i = 0; i < LATENCY_CALLS; i++) {
+        QString callerId = QString("55500%1").arg(i);
+        QVariantMap properties;
+        properties["Caller"] = callerId;
+        properties["State"] = "incoming";
+        mMockController->placeCall(properties);
+        TRY_COMPARE(notificationSpy.count(), i + 1);
+        mMockController->HangupCall(callerId);
+        // let the approver see the call ending before the next one arrives
+        QTest::qWait(200);
+    }
+
+    QVariantMap latencies = ApproverController::instance()->incomingCallLatencies();
+    Q_FOREACH(const QString &point, latencies.keys()) {
+        QVariantMap histogram = qdbus_cast<QVariantMap>(latencies[point]);
+        qDebug() << point << "count" << histogram["count"].toUInt()
+                 << "p50" << histogram["p50"].toLongLong() << "ms"
+                 << "p95" << histogram["p95"].toLongLong() << "ms"
+                 << "max" << histogram["max"].toLongLong() << "ms";
+    }
+
+    // the snap decision is what the user waits for, the ringtone is not
+    // played in the test environment
+    QVERIFY(latencies.contains("dispatch"));
+    QVERIFY(latencies.contains("channel-ready"));
+    QVERIFY(latencies.contains("snap-decision"));
+    QVariantMap snapDecision = qdbus_cast<QVariantMap>(latencies["snap-decision"]);
+    QCOMPARE(snapDecision["count"].toInt(), LATENCY_CALLS);
+    QVERIFY2(snapDecision["p95"].toLongLong() <= budget,
+             qPrintable(QString("snap decision p95 of %1 ms is over the %2 ms budget")
+                        .arg(snapDecision["p95"].toLongLong()).arg(budget)));
+
+    // every call also has the stage that leads to the snap decision
+    int snapDecisionStages = 0;
+    Q_FOREACH(const QString &point, latencies.keys()) {
+        if (point.endsWith("->snap-decision")) {
+            snapDecisionStages += qdbus_cast<QVariantMap>(latencies[point])["count"].toInt();
+        }
+    }
+    QCOMPARE(snapDecisionStages, LATENCY_CALLS);
+}
+
 QTEST_MAIN(ApproverTest)
 #include "ApproverTest.moc"
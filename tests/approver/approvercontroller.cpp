@@ -47,3 +47,19 @@ void ApproverController::hangUpAndAcceptCall()
 {
     mApproverInterface.call("HangUpAndAcceptCall");
 }
+
+void ApproverController::rejectCall()
+{
+    mApproverInterface.call("RejectCall");
+}
+
+QVariantMap ApproverController::incomingCallLatencies()
+{
+    QDBusReply<QVariantMap> reply = mApproverInterface.call("GetIncomingCallLatencies");
+    return reply.value();
+}
+
+void ApproverController::resetIncomingCallLatencies()
+{
+    mApproverInterface.call("ResetIncomingCallLatencies");
+}
@@ -32,6 +32,9 @@ public:
 public Q_SLOTS:
     void acceptCall();
     void hangUpAndAcceptCall();
+    void rejectCall();
+    QVariantMap incomingCallLatencies();
+    void resetIncomingCallLatencies();
 
 private:
     explicit ApproverController(QObject *parent = 0);
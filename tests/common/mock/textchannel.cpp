@@ -36,6 +36,30 @@ const QDBusArgument &operator>>(const QDBusArgument &argument, AttachmentStruct
     return argument;
 }
 
+static Tp::MessagePartList attachmentParts(const QVariant &attachments)
+{
+    Tp::MessagePartList parts;
+    AttachmentList mmsdAttachments = qdbus_cast<AttachmentList>(attachments);
+    Q_FOREACH(const AttachmentStruct &attachment, mmsdAttachments) {
+        QFile attachmentFile(attachment.filePath);
+        if (!attachmentFile.open(QIODevice::ReadOnly)) {
+            qWarning() << "fail to load attachment" << attachmentFile.errorString() << attachment.filePath;
+            continue;
+        }
+        // FIXME check if we managed to read the total attachment file
+        attachmentFile.seek(attachment.offset);
+        QByteArray fileData = attachmentFile.read(attachment.length);
+        Tp::MessagePart part;
+        part["content-type"] =  QDBusVariant(attachment.contentType);
+        part["identifier"] = QDBusVariant(attachment.id);
+        part["content"] = QDBusVariant(fileData);
+        part["size"] = QDBusVariant(attachment.length);
+
+        parts << part;
+    }
+    return parts;
+}
+
 MockTextChannel::MockTextChannel(MockConnection *conn, QStringList recipients, uint targetHandle, QObject *parent):
     QObject(parent),
     mConnection(conn),
@@ -198,6 +222,10 @@ void MockTextChannel::messageReceived(const QString &message, const QVariantMap
     header["message-sender-id"] = QDBusVariant(mRecipients.first());
     header["message-type"] = QDBusVariant(Tp::ChannelTextMessageTypeNormal);
     partList << header << body;
+    // incoming MMS, same format as the mmsd attachments
+    if (info.contains("Attachments")) {
+        partList << attachmentParts(info["Attachments"]);
+    }
 
     mTextChannel->addReceivedMessage(partList);
 }
@@ -218,24 +246,7 @@ void MockTextChannel::mmsReceived(const QString &id, const QVariantMap &properti
         header["subject"] = QDBusVariant(subject);
     }
     message << header;
-    AttachmentList mmsdAttachments = qdbus_cast<AttachmentList>(properties["Attachments"]);
-    Q_FOREACH(const AttachmentStruct &attachment, mmsdAttachments) {
-        QFile attachmentFile(attachment.filePath);
-        if (!attachmentFile.open(QIODevice::ReadOnly)) {
-            qWarning() << "fail to load attachment" << attachmentFile.errorString() << attachment.filePath;
-            continue;
-        }
-        // FIXME check if we managed to read the total attachment file
-        attachmentFile.seek(attachment.offset);
-        QByteArray fileData = attachmentFile.read(attachment.length);
-        Tp::MessagePart part;
-        part["content-type"] =  QDBusVariant(attachment.contentType);
-        part["identifier"] = QDBusVariant(attachment.id);
-        part["content"] = QDBusVariant(fileData);
-        part["size"] = QDBusVariant(attachment.length);
-
-        message << part;
-    }
+    message << attachmentParts(properties["Attachments"]);
 
     if (!smil.isEmpty()) {
         Tp::MessagePart part;
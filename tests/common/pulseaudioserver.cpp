@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pulseaudioserver.h"
+
+#include <QStandardPaths>
+#include <QThread>
+
+PulseAudioServer::~PulseAudioServer()
+{
+    stop();
+}
+
+bool PulseAudioServer::isSupported()
+{
+    return !QStandardPaths::findExecutable("pulseaudio").isEmpty() &&
+           !QStandardPaths::findExecutable("pactl").isEmpty();
+}
+
+bool PulseAudioServer::start()
+{
+    if (!isSupported() || !mRuntimeDir.isValid()) {
+        return false;
+    }
+
+    // make sure neither this process nor pactl talk to the user's daemon
+    QString socket = mRuntimeDir.path() + "/native";
+    qputenv("PULSE_RUNTIME_PATH", mRuntimeDir.path().toUtf8());
+    qputenv("PULSE_STATE_PATH", mRuntimeDir.path().toUtf8());
+    qputenv("PULSE_SERVER", QString("unix:%1").arg(socket).toUtf8());
+
+    mDaemon.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    mDaemon.start("pulseaudio", QStringList() << "--daemonize=no"
+                                              << "--system=no"
+                                              << "--exit-idle-time=-1"
+                                              << "--use-pid-file=no"
+                                              << "--disable-shm"
+                                              << "-n"
+                                              << "--load=module-native-protocol-unix auth-anonymous=1 socket=" + socket);
+    if (!mDaemon.waitForStarted()) {
+        return false;
+    }
+
+    // wait for the daemon to accept connections
+    bool ready = false;
+    for (int i = 0; i < 50 && !ready; i++) {
+        ready = pactl(QStringList() << "info");
+        if (!ready) {
+            QThread::msleep(100);
+        }
+    }
+
+    return ready &&
+           pactl(QStringList() << "load-module" << "module-null-sink" << "sink_name=sink.primary") &&
+           pactl(QStringList() << "load-module" << "module-null-source" << "source_name=source.primary") &&
+           pactl(QStringList() << "set-default-sink" << "sink.primary") &&
+           pactl(QStringList() << "set-default-source" << "source.primary");
+}
+
+void PulseAudioServer::stop()
+{
+    if (mDaemon.state() == QProcess::NotRunning) {
+        return;
+    }
+    mDaemon.terminate();
+    if (!mDaemon.waitForFinished(5000)) {
+        mDaemon.kill();
+        mDaemon.waitForFinished();
+    }
+}
+
+bool PulseAudioServer::pactl(const QStringList &arguments, QString *output)
+{
+    QProcess process;
+    process.start("pactl", arguments);
+    if (!process.waitForFinished(5000)) {
+        process.kill();
+        return false;
+    }
+    if (output) {
+        *output = QString::fromUtf8(process.readAllStandardOutput());
+    }
+    return process.exitStatus() == QProcess::NormalExit && process.exitCode() == 0;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PULSEAUDIOSERVER_H
+#define PULSEAUDIOSERVER_H
+
+#include <QProcess>
+#include <QStringList>
+#include <QTemporaryDir>
+
+/* Runs a private PulseAudio daemon on a temporary socket, with a null sink
+ * and source named after the droid primary devices. PULSE_SERVER is pointed
+ * at it, so PulseAudio clients created afterwards in the test connect to it */
+class PulseAudioServer
+{
+public:
+    ~PulseAudioServer();
+
+    /* true if pulseaudio and pactl are installed */
+    static bool isSupported();
+
+    bool start();
+    void stop();
+    bool pactl(const QStringList &arguments, QString *output = 0);
+
+private:
+    QTemporaryDir mRuntimeDir;
+    QProcess mDaemon;
+};
+
+#endif // PULSEAUDIOSERVER_H
@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore/QObject>
+#include <QtTest/QtTest>
+#include <QElapsedTimer>
+
+#include "audioroutemanager.h"
+#include "pulseaudioserver.h"
+#include "qpulseaudioenginetestaccess.h"
+
+// number of times each call sequence is repeated
+#define ITERATIONS 50
+// default p95 budget for a single route transition, can be overridden with
+// the AUDIO_ROUTE_BUDGET_MS environment variable
+#define DEFAULT_BUDGET_MS 250
+// how long to wait for a route change to be reported
+#define ROUTE_TIMEOUT 5000
+
+// indexes far from the ones the server uses for its own objects
+#define DROID_SINK_INDEX 1000
+#define DROID_SOURCE_INDEX 1001
+#define BT_CARD_INDEX 1002
+
+/* Drives the engine through a whole call against a private PulseAudio daemon
+ * and reports the latency of each transition. The call state changes use the
+ * modes AudioRouteManager picks for a ringing, answered and ended call and
+ * are timed until the engine applied them. The output changes go through
+ * AudioRouteManager and are timed until the new output is reported back.
+ * The daemon only has null devices, so the droid sink and source, with their
+ * earpiece/speaker/bluetooth ports, and the bluetooth headset card are loaded
+ * into the engine model directly. The engine makes its decisions on them and
+ * sends its requests to the daemon as it would on a device. */
+class AudioRouteBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void benchmarkCallSequences();
+
+private:
+    void setCallStatus(const QString &transition, CallStatus status, AudioMode mode);
+    void selectOutput(const QString &transition, const QString &output);
+    void plugHeadset(bool plugged);
+    void report();
+
+    PulseAudioServer mServer;
+    QElapsedTimer mTimer;
+    QMap<QString, QList<qint64> > mSamples;
+};
+
+void AudioRouteBenchmark::initTestCase()
+{
+    if (!PulseAudioServer::isSupported()) {
+        QSKIP("pulseaudio and pactl are needed to run this benchmark");
+    }
+    QVERIFY(mServer.start());
+
+    // the test environment disables PulseAudio in the handler code, this
+    // test brings its own server. The application name keeps the library
+    // code behaving like it does in the handler.
+    qunsetenv("PA_DISABLED");
+    QCoreApplication::setApplicationName("telephony-service-handler");
+    AudioRouteManager::instance();
+
+    pa_sink_port_info sinkPorts[] = {
+        { "output-earpiece", "Earpiece", 0, PA_PORT_AVAILABLE_UNKNOWN },
+        { "output-speaker", "Speaker", 0, PA_PORT_AVAILABLE_UNKNOWN },
+        { "output-bluetooth_sco", "Bluetooth", 0, PA_PORT_AVAILABLE_UNKNOWN }
+    };
+    pa_sink_port_info *sinkPortList[] = { &sinkPorts[0], &sinkPorts[1], &sinkPorts[2] };
+    pa_sink_info sink = pa_sink_info();
+    sink.name = "sink.primary";
+    sink.index = DROID_SINK_INDEX;
+    sink.n_ports = 3;
+    sink.ports = sinkPortList;
+    sink.active_port = &sinkPorts[1];
+    QPulseAudioEngineTestAccess::injectSink(&sink);
+
+    pa_source_port_info sourcePorts[] = {
+        { "input-builtin_mic", "Microphone", 0, PA_PORT_AVAILABLE_UNKNOWN },
+        { "input-bluetooth_sco_headset", "Bluetooth", 0, PA_PORT_AVAILABLE_UNKNOWN }
+    };
+    pa_source_port_info *sourcePortList[] = { &sourcePorts[0], &sourcePorts[1] };
+    pa_source_info source = pa_source_info();
+    source.name = "source.primary";
+    source.index = DROID_SOURCE_INDEX;
+    source.monitor_of_sink = PA_INVALID_INDEX;
+    source.n_ports = 2;
+    source.ports = sourcePortList;
+    source.active_port = &sourcePorts[0];
+    QPulseAudioEngineTestAccess::injectSource(&source);
+}
+
+void AudioRouteBenchmark::cleanupTestCase()
+{
+    mServer.stop();
+}
+
+void AudioRouteBenchmark::benchmarkCallSequences()
+{
+    for (int i = 0; i < ITERATIONS; i++) {
+        // the call rings and is answered
+        setCallStatus("call-start", CallRinging, AudioModeBtOrWiredOrSpeaker);
+        setCallStatus("active", CallActive, AudioModeBtOrWiredOrEarpiece);
+
+        // speaker on and off during the call
+        selectOutput("speaker", "speaker");
+        selectOutput("earpiece", "earpiece");
+
+        // a bluetooth headset connects, the user moves the call off it and
+        // back, and the headset goes away
+        plugHeadset(true);
+        selectOutput("earpiece", "earpiece");
+        selectOutput("bluetooth", "bluetooth");
+        plugHeadset(false);
+
+        setCallStatus("call-end", CallEnded, AudioModeWiredOrSpeaker);
+        if (QTest::currentTestFailed()) {
+            return;
+        }
+    }
+
+    report();
+}
+
+void AudioRouteBenchmark::setCallStatus(const QString &transition, CallStatus status, AudioMode mode)
+{
+    mTimer.start();
+    QPulseAudioEngineTestAccess::setCallModeAndWait(status, mode);
+    mSamples[transition] << mTimer.nsecsElapsed() / 1000;
+
+    // let AudioRouteManager see the resulting output before the next step
+    // starts waiting for its own
+    QCoreApplication::processEvents();
+
+    // a ringing call is already on the speaker the engine starts with, but
+    // answering it has to move it to the earpiece
+    if (status == CallActive) {
+        QCOMPARE(AudioRouteManager::instance()->activeAudioOutput(), QString("earpiece"));
+    }
+}
+
+void AudioRouteBenchmark::selectOutput(const QString &transition, const QString &output)
+{
+    QSignalSpy outputSpy(AudioRouteManager::instance(), SIGNAL(activeAudioOutputChanged(QString)));
+    mTimer.start();
+    AudioRouteManager::instance()->setActiveAudioOutput(output);
+    QVERIFY(outputSpy.wait(ROUTE_TIMEOUT));
+    mSamples[transition] << mTimer.nsecsElapsed() / 1000;
+    QCOMPARE(outputSpy.last()[0].toString(), output);
+}
+
+void AudioRouteBenchmark::plugHeadset(bool plugged)
+{
+    QSignalSpy outputSpy(AudioRouteManager::instance(), SIGNAL(activeAudioOutputChanged(QString)));
+    mTimer.start();
+    if (plugged) {
+        // a headset that only does HSP, so the engine does not need to
+        // switch its profile
+        pa_card_profile_info2 hsp = pa_card_profile_info2();
+        hsp.name = "headset_head_unit";
+        hsp.priority = 20;
+        hsp.available = 1;
+        pa_card_profile_info2 *profiles[] = { &hsp };
+        pa_card_info card = pa_card_info();
+        card.name = "bluez_card.benchmark";
+        card.index = BT_CARD_INDEX;
+        card.n_profiles = 1;
+        card.profiles2 = profiles;
+        QPulseAudioEngineTestAccess::injectCard(&card);
+    } else {
+        QPulseAudioEngineTestAccess::removeCard(BT_CARD_INDEX);
+    }
+
+    // the engine moves the call to the headset when it shows up, and back to
+    // the earpiece when it goes away
+    QString output = plugged ? "bluetooth" : "earpiece";
+    QVERIFY(outputSpy.wait(ROUTE_TIMEOUT));
+    mSamples[plugged ? "bt-plug" : "bt-unplug"] << mTimer.nsecsElapsed() / 1000;
+    QCOMPARE(outputSpy.last()[0].toString(), output);
+}
+
+void AudioRouteBenchmark::report()
+{
+    bool ok;
+    int budget = qgetenv("AUDIO_ROUTE_BUDGET_MS").toInt(&ok);
+    if (!ok || budget <= 0) {
+        budget = DEFAULT_BUDGET_MS;
+    }
+
+    QStringList overBudget;
+    Q_FOREACH(const QString &transition, mSamples.keys()) {
+        QList<qint64> samples = mSamples[transition];
+        qSort(samples);
+        qint64 p50 = samples[samples.count() * 50 / 100];
+        qint64 p95 = samples[samples.count() * 95 / 100];
+        qint64 p99 = samples[samples.count() * 99 / 100];
+        qDebug("%-12s p50 %8lld us  p95 %8lld us  p99 %8lld us  max %8lld us",
+               qPrintable(transition), p50, p95, p99, samples.last());
+        if (p95 > budget * 1000) {
+            overBudget << transition;
+        }
+    }
+
+    if (!overBudget.isEmpty()) {
+        QFAIL(qPrintable(QString("Transitions over the %1 ms p95 budget: %2").arg(budget).arg(overBudget.join(", "))));
+    }
+}
+
+QTEST_GUILESS_MAIN(AudioRouteBenchmark)
+#include "AudioRouteBenchmark.moc"
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore/QObject>
+#include <QtTest/QtTest>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QElapsedTimer>
+#include "telepathytest.h"
+
+#define HANDLER_SERVICE "com.canonical.TelephonyServiceHandler"
+#define HANDLER_OBJECT "/com/canonical/TelephonyServiceHandler"
+#define HANDLER_IFACE "com.canonical.TelephonyServiceHandler"
+
+// number of times each startup sequence is repeated
+#define ITERATIONS 200
+
+/* Compares what a client pays to get the handler state when it starts: one
+ * call per piece of state (what the clients used to do) against a single
+ * GetSnapshot call. Both sequences are run against the same handler, one
+ * blocking call at a time, so the difference is the cost of the extra round
+ * trips (and of the dbus activation waits they imply on a real session). */
+class HandlerStartupBenchmark : public TelepathyTest
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void benchmarkStartup();
+
+private:
+    qint64 measure(const QList<QDBusMessage> &calls);
+    void report(const QString &sequence, int roundTrips, QList<qint64> samples);
+};
+
+void HandlerStartupBenchmark::initTestCase()
+{
+    initialize();
+
+    QDBusMessage isReady = QDBusMessage::createMethodCall(HANDLER_SERVICE, HANDLER_OBJECT, HANDLER_IFACE, "IsReady");
+    TRY_VERIFY(QDBusConnection::sessionBus().call(isReady).arguments().value(0).toBool());
+}
+
+void HandlerStartupBenchmark::benchmarkStartup()
+{
+    QList<QDBusMessage> separateCalls;
+    QStringList methods;
+    methods << "IsReady" << "AccountIds" << "GetProtocols" << "GetAllAccountsProperties" << "HasCalls" << "AudioOutputs";
+    Q_FOREACH(const QString &method, methods) {
+        separateCalls << QDBusMessage::createMethodCall(HANDLER_SERVICE, HANDLER_OBJECT, HANDLER_IFACE, method);
+    }
+    QDBusMessage getAll = QDBusMessage::createMethodCall(HANDLER_SERVICE, HANDLER_OBJECT,
+                                                         "org.freedesktop.DBus.Properties", "GetAll");
+    getAll << HANDLER_IFACE;
+    separateCalls << getAll;
+
+    QList<QDBusMessage> snapshotCall;
+    snapshotCall << QDBusMessage::createMethodCall(HANDLER_SERVICE, HANDLER_OBJECT, HANDLER_IFACE, "GetSnapshot");
+
+    QList<qint64> separateSamples;
+    QList<qint64> snapshotSamples;
+    for (int i = 0; i < ITERATIONS; i++) {
+        separateSamples << measure(separateCalls);
+        snapshotSamples << measure(snapshotCall);
+    }
+
+    report("separate", separateCalls.count(), separateSamples);
+    report("snapshot", snapshotCall.count(), snapshotSamples);
+
+    qSort(separateSamples);
+    qSort(snapshotSamples);
+    QVERIFY(snapshotSamples[ITERATIONS / 2] < separateSamples[ITERATIONS / 2]);
+}
+
+qint64 HandlerStartupBenchmark::measure(const QList<QDBusMessage> &calls)
+{
+    QElapsedTimer timer;
+    timer.start();
+    Q_FOREACH(const QDBusMessage &call, calls) {
+        QDBusMessage reply = QDBusConnection::sessionBus().call(call);
+        if (reply.type() != QDBusMessage::ReplyMessage) {
+            qWarning() << "Call to" << call.member() << "failed:" << reply.errorMessage();
+        }
+    }
+    return timer.nsecsElapsed() / 1000;
+}
+
+void HandlerStartupBenchmark::report(const QString &sequence, int roundTrips, QList<qint64> samples)
+{
+    qSort(samples);
+    qint64 p50 = samples[samples.count() * 50 / 100];
+    qint64 p95 = samples[samples.count() * 95 / 100];
+    qint64 p99 = samples[samples.count() * 99 / 100];
+    qDebug("%-10s %d round trips  p50 %8lld us  p95 %8lld us  p99 %8lld us  max %8lld us",
+           qPrintable(sequence), roundTrips, p50, p95, p99, samples.last());
+}
+
+QTEST_MAIN(HandlerStartupBenchmark)
+#include "HandlerStartupBenchmark.moc"
@@ -42,6 +42,9 @@ private Q_SLOTS:
     void cleanup();
     void testGetProtocols();
     void testGetProtocolsChangesThroughDBus();
+    void testGetSnapshot();
+    void testAccountProperties();
+    void testStats();
     void testMakingCalls();
     void testHangUpCall();
     void testCallHold();
@@ -118,7 +121,7 @@ void HandlerTest::testGetProtocols()
 
 void HandlerTest::testGetProtocolsChangesThroughDBus()
 {
-    QSignalSpy protocolsChangedSpy(HandlerController::instance(), SIGNAL(protocolsChanged(ProtocolList)));
+    QSignalSpy protocolsChangedSpy(HandlerController::instance(), SIGNAL(protocolsChanged(ProtocolList,qulonglong)));
 
     QTemporaryFile f;
     f.setFileTemplate(protocolsDir() + "/");
@@ -129,6 +132,117 @@ void HandlerTest::testGetProtocolsChangesThroughDBus()
     QTRY_COMPARE(protocolsChangedSpy.count(), 1);
 }
 
+void HandlerTest::testGetSnapshot()
+{
+    // the handler might still be setting up the accounts created in init()
+    TRY_VERIFY(HandlerController::instance()->getSnapshot()["accountIds"].toStringList().contains(mOfonoTpAccount->uniqueIdentifier()));
+
+    QVariantMap snapshot = HandlerController::instance()->getSnapshot();
+    QCOMPARE(snapshot["version"].toInt(), 1);
+    QVERIFY(snapshot["ready"].toBool());
+    QVERIFY(!snapshot["hasCalls"].toBool());
+    QVERIFY(qdbus_cast<QVariantMap>(snapshot["calls"]).isEmpty());
+
+    QStringList accountIds = snapshot["accountIds"].toStringList();
+    QVERIFY(accountIds.contains(mTpAccount->uniqueIdentifier()));
+    QVERIFY(accountIds.contains(mOfonoTpAccount->uniqueIdentifier()));
+
+    ProtocolList protocols = qdbus_cast<ProtocolList>(snapshot["protocols"]);
+    ProtocolList expectedProtocols = HandlerController::instance()->getProtocols();
+    QCOMPARE(protocols.count(), expectedProtocols.count());
+    for (int i = 0; i < protocols.count(); ++i) {
+        QCOMPARE(protocols[i].name, expectedProtocols[i].name);
+    }
+
+    QVariantMap properties = qdbus_cast<QVariantMap>(snapshot["properties"]);
+    QCOMPARE(properties["CallIndicatorVisible"].toBool(), HandlerController::instance()->callIndicatorVisible());
+    QVERIFY(snapshot.contains("sequence"));
+    qulonglong sequence = snapshot["sequence"].toULongLong();
+
+    // and a new snapshot reflects the changes, which carry a later sequence
+    QSignalSpy spy(HandlerController::instance(), SIGNAL(callIndicatorVisibleChanged(bool,qulonglong)));
+    HandlerController::instance()->setCallIndicatorVisible(!properties["CallIndicatorVisible"].toBool());
+    TRY_COMPARE(spy.count(), 1);
+    qulonglong changeSequence = spy.first()[1].toULongLong();
+    QVERIFY(changeSequence > sequence);
+    QVariantMap newSnapshot = HandlerController::instance()->getSnapshot();
+    properties = qdbus_cast<QVariantMap>(newSnapshot["properties"]);
+    QCOMPARE(properties["CallIndicatorVisible"].toBool(), spy.first().first().toBool());
+    QVERIFY(newSnapshot["sequence"].toULongLong() >= changeSequence);
+
+    HandlerController::instance()->setCallIndicatorVisible(false);
+}
+
+void HandlerTest::testAccountProperties()
+{
+    QString accountId = mTpAccount->uniqueIdentifier();
+    QSignalSpy spy(HandlerController::instance(), SIGNAL(accountPropertiesChanged(QString,QVariantMap,qulonglong)));
+
+    QVariantMap properties;
+    properties["firstProperty"] = "firstValue";
+    properties["secondProperty"] = 2;
+    HandlerController::instance()->setAccountProperties(accountId, properties);
+    TRY_COMPARE(spy.count(), 1);
+    QCOMPARE(spy.first()[0].toString(), accountId);
+    QCOMPARE(spy.first()[1].value<QVariantMap>(), properties);
+    QCOMPARE(HandlerController::instance()->getAccountProperties(accountId), properties);
+
+    // setting the same values again is not a change
+    spy.clear();
+    HandlerController::instance()->setAccountProperties(accountId, properties);
+    QTest::qWait(500);
+    QCOMPARE(spy.count(), 0);
+
+    // and only what changed gets notified
+    QVariantMap changed;
+    changed["secondProperty"] = 3;
+    properties["secondProperty"] = 3;
+    HandlerController::instance()->setAccountProperties(accountId, properties);
+    TRY_COMPARE(spy.count(), 1);
+    QCOMPARE(spy.first()[1].value<QVariantMap>(), changed);
+    QCOMPARE(HandlerController::instance()->getAccountProperties(accountId), properties);
+}
+
+void HandlerTest::testStats()
+{
+    QDBusInterface statsInterface("com.canonical.TelephonyServiceHandler",
+                                  "/com/canonical/TelephonyServiceHandler",
+                                  "com.canonical.TelephonyServiceHandler.Stats");
+    QVERIFY(statsInterface.isValid());
+    QVERIFY(statsInterface.setProperty("StatsEnabled", true));
+    QVERIFY(statsInterface.call("ResetStats").type() == QDBusMessage::ReplyMessage);
+
+    for (int i = 0; i < 3; i++) {
+        HandlerController::instance()->getCallProperties("/some/call");
+    }
+    HandlerController::instance()->setCallIndicatorVisible(true);
+    HandlerController::instance()->setCallIndicatorVisible(false);
+
+    QDBusReply<QVariantMap> reply = statsInterface.call("GetStats");
+    QVERIFY(reply.isValid());
+    QVariantMap stats = reply.value();
+    QVERIFY(stats["enabled"].toBool());
+
+    QVariantMap methods = qdbus_cast<QVariantMap>(stats["methods"]);
+    QVariantMap method = qdbus_cast<QVariantMap>(methods["GetCallProperties"]);
+    QCOMPARE(method["calls"].toUInt(), (uint)3);
+    QVariantMap latency = qdbus_cast<QVariantMap>(method["latency"]);
+    QCOMPARE(latency["count"].toUInt(), (uint)3);
+    QVERIFY(latency.contains("p95"));
+    QVariantMap payload = qdbus_cast<QVariantMap>(method["payload"]);
+    QVERIFY(payload["max"].toLongLong() >= QString("/some/call").size());
+
+    QVariantMap signalStats = qdbus_cast<QVariantMap>(stats["signals"]);
+    QVariantMap signal = qdbus_cast<QVariantMap>(signalStats["CallIndicatorVisibleChanged"]);
+    QCOMPARE(signal["emitted"].toUInt(), (uint)2);
+
+    // and reset clears everything
+    QVERIFY(statsInterface.call("ResetStats").type() == QDBusMessage::ReplyMessage);
+    reply = statsInterface.call("GetStats");
+    QVERIFY(qdbus_cast<QVariantMap>(reply.value()["methods"]).isEmpty());
+    QVERIFY(statsInterface.setProperty("StatsEnabled", false));
+}
+
 void HandlerTest::testMakingCalls()
 {
     QString callerId("1234567");
@@ -210,7 +324,7 @@ void HandlerTest::testCallProperties()
     properties["State"] = "incoming";
 
     QSignalSpy approverCallSpy(mApprover, SIGNAL(newCall()));
-    QSignalSpy handlerCallPropertiesSpy(HandlerController::instance(), SIGNAL(callPropertiesChanged(QString,QVariantMap)));
+    QSignalSpy handlerCallPropertiesSpy(HandlerController::instance(), SIGNAL(callPropertiesChanged(QString,QVariantMap,qulonglong)));
     mMockController->placeCall(properties);
 
     // wait for the channel to hit the approver
@@ -224,14 +338,18 @@ void HandlerTest::testCallProperties()
     // wait until the call properties are changed
     TRY_VERIFY(handlerCallPropertiesSpy.count() > 0);
     QString objectPath = handlerCallPropertiesSpy.last()[0].toString();
+    // the first signal carries everything known about the call, and the
+    // following ones only what changed
+    QVariantMap propsFromFirstSignal = handlerCallPropertiesSpy.first()[1].toMap();
+    QDateTime timestampFromSignal;
+    propsFromFirstSignal["timestamp"].value<QDBusArgument>() >> timestampFromSignal;
+    QVERIFY(timestampFromSignal.isValid());
+
     QVariantMap propsFromSignal = handlerCallPropertiesSpy.last()[1].toMap();
     QVERIFY(!propsFromSignal.isEmpty());
     QDateTime activeTimestampFromSignal;
-    QDateTime timestampFromSignal;
     propsFromSignal["activeTimestamp"].value<QDBusArgument>() >> activeTimestampFromSignal;
-    propsFromSignal["timestamp"].value<QDBusArgument>() >> timestampFromSignal;
     QVERIFY(activeTimestampFromSignal.isValid());
-    QVERIFY(timestampFromSignal.isValid());
 
     // and try to get the properties using the method
     QVariantMap propsFromMethod = HandlerController::instance()->getCallProperties(objectPath);
@@ -256,6 +374,7 @@ void HandlerTest::testCallProperties()
     QString dtmfStringFromMethod = propsFromMethod["dtmfString"].toString();
     QCOMPARE(dtmfStringFromSignal, dtmfString);
     QCOMPARE(dtmfStringFromMethod, dtmfString);
+    QCOMPARE(propsFromSignal.keys(), QStringList() << "dtmfString");
 
     HandlerController::instance()->hangUpCall(objectPath);
     QTest::qWait(500);
@@ -485,7 +604,7 @@ void HandlerTest::testActiveCallIndicator()
 {
     // start by making sure the property is false by default
     QVERIFY(!HandlerController::instance()->callIndicatorVisible());
-    QSignalSpy spy(HandlerController::instance(), SIGNAL(callIndicatorVisibleChanged(bool)));
+    QSignalSpy spy(HandlerController::instance(), SIGNAL(callIndicatorVisibleChanged(bool,qulonglong)));
 
     // set the property to true
     HandlerController::instance()->setCallIndicatorVisible(true);
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore/QObject>
+#include <QtTest/QtTest>
+#include "telepathytest.h"
+#include "handler.h"
+#include "messagejob.h"
+#include "messagesendingjob.h"
+#include "telepathyhelper.h"
+#include "texthandler.h"
+
+class MessageJobTest : public TelepathyTest
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void testWhenFinished();
+    void testWhenFinishedAlreadyFinished();
+    void testWhenFinishedContextDestroyed();
+    void testSendThroughChatStartingJob();
+
+private:
+    Tp::AccountPtr mTpAccount;
+};
+
+void MessageJobTest::initTestCase()
+{
+    initialize();
+
+    // act as the handler: the text channels requested by the jobs are
+    // handed to this process
+    QCoreApplication::setApplicationName("telephony-service-handler");
+    Handler *handler = new Handler(this);
+    connect(handler, SIGNAL(textChannelAvailable(Tp::TextChannelPtr)),
+            TextHandler::instance(), SLOT(onTextChannelAvailable(Tp::TextChannelPtr)));
+
+    QSignalSpy setupReadySpy(TelepathyHelper::instance(), SIGNAL(setupReady()));
+    TRY_COMPARE(setupReadySpy.count(), 1);
+    QVERIFY(TelepathyHelper::instance()->registerClient(handler, "TelephonyServiceHandler"));
+}
+
+void MessageJobTest::init()
+{
+    mTpAccount = addAccount("mock", "mock", "the account");
+    TRY_VERIFY(TelepathyHelper::instance()->accountForId(mTpAccount->uniqueIdentifier()) &&
+               TelepathyHelper::instance()->accountForId(mTpAccount->uniqueIdentifier())->connected());
+}
+
+void MessageJobTest::cleanup()
+{
+    doCleanup();
+}
+
+void MessageJobTest::testWhenFinished()
+{
+    MessageJob job;
+    int calls = 0;
+    job.whenFinished(this, [&]() {
+        QVERIFY(job.isFinished());
+        calls++;
+    });
+    QCOMPARE(calls, 0);
+
+    job.startJob();
+    QCOMPARE(calls, 1);
+
+    // the continuation runs only once
+    job.startJob();
+    QCOMPARE(calls, 1);
+}
+
+void MessageJobTest::testWhenFinishedAlreadyFinished()
+{
+    MessageJob job;
+    job.startJob();
+    QVERIFY(job.isFinished());
+
+    // never called from within whenFinished() itself
+    int calls = 0;
+    job.whenFinished(this, [&]() {
+        calls++;
+    });
+    QCOMPARE(calls, 0);
+    TRY_COMPARE(calls, 1);
+}
+
+void MessageJobTest::testWhenFinishedContextDestroyed()
+{
+    MessageJob job;
+    QObject *context = new QObject();
+    int calls = 0;
+    job.whenFinished(context, [&]() {
+        calls++;
+    });
+    delete context;
+
+    job.startJob();
+    QCOMPARE(calls, 0);
+}
+
+void MessageJobTest::testSendThroughChatStartingJob()
+{
+    // there is no channel for this recipient yet, so the message only goes
+    // out once the ChatStartingJob hands the new channel over
+    QVariantMap properties;
+    properties["participantIds"] = QStringList() << "54321";
+    PendingMessage message = {mTpAccount->uniqueIdentifier(), "Hello", AttachmentList(), properties};
+
+    MessageSendingJob *job = new MessageSendingJob(TextHandler::instance(), message);
+    QSignalSpy finishedSpy(job, SIGNAL(finished()));
+    job->startJob();
+
+    TRY_COMPARE(finishedSpy.count(), 1);
+    QCOMPARE(job->status(), MessageJob::Finished);
+    QVERIFY(!job->channelObjectPath().isEmpty());
+}
+
+QTEST_MAIN(MessageJobTest)
+#include "MessageJobTest.moc"
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore/QObject>
+#include <QtTest/QtTest>
+#include <QElapsedTimer>
+
+#include "numberrewriter.h"
+#include "phoneutils.h"
+
+// size of the rule list and of the set of numbers used in the benchmark
+#define BENCHMARK_RULES 100
+#define BENCHMARK_NUMBERS 1000
+// the numbers dialed again, few enough for the rewriter to keep them all
+#define REDIAL_NUMBERS 20
+#define REDIAL_ROUNDS 50
+
+class NumberRewriterTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testDisabled();
+    void testLegacyRule_data();
+    void testLegacyRule();
+    void testRuleList_data();
+    void testRuleList();
+    void testInvalidRule();
+    void benchmarkRewrite();
+
+private:
+    QVariantMap rule(const QString &match, const QString &replace = QString(), const QString &prefix = QString());
+    QVariantMap ruleList(const QVariantList &rules);
+};
+
+void NumberRewriterTest::testDisabled()
+{
+    QVariantMap properties;
+    properties["prefix"] = "0";
+    QVERIFY(NumberRewriter(properties).isEmpty());
+    QCOMPARE(NumberRewriter(properties).rewrite("12345678"), QString("12345678"));
+
+    properties["numberRewrite"] = true;
+    QVERIFY(!NumberRewriter(properties).isEmpty());
+}
+
+void NumberRewriterTest::testLegacyRule_data()
+{
+    QTest::addColumn<QString>("number");
+    QTest::addColumn<QString>("countryCode");
+    QTest::addColumn<QString>("removeCharacters");
+    QTest::addColumn<QString>("prefix");
+
+    QTest::newRow("short number") << "190" << "55" << "" << "";
+    QTest::newRow("country code") << "1234567890" << "55" << "" << "";
+    QTest::newRow("country code with plus") << "1234567890" << "+55" << "" << "";
+    QTest::newRow("remove characters") << "1234567890" << "1" << " " << "";
+    QTest::newRow("prefix") << "1234567890" << "1" << "" << "00";
+    QTest::newRow("international number") << "+44 20 7946 0018" << "1" << " " << "9";
+}
+
+void NumberRewriterTest::testLegacyRule()
+{
+    QFETCH(QString, number);
+    QFETCH(QString, countryCode);
+    QFETCH(QString, removeCharacters);
+    QFETCH(QString, prefix);
+
+    QVariantMap properties;
+    properties["numberRewrite"] = true;
+    properties["defaultCountryCode"] = countryCode;
+    properties["removeCharacters"] = removeCharacters;
+    properties["prefix"] = prefix;
+
+    // this is what the handler used to do on every call
+    QString expected = number;
+    if (number.length() > 6) {
+        if (!countryCode.startsWith("+")) {
+            countryCode.prepend("+");
+        }
+        expected = PhoneUtils::getFullNumber(number, countryCode, QString());
+        expected.remove(removeCharacters);
+        expected.prepend(prefix);
+    }
+
+    NumberRewriter rewriter(properties);
+    QCOMPARE(rewriter.rewrite(number), expected);
+    // and from the cached result
+    QCOMPARE(rewriter.rewrite(number), expected);
+}
+
+void NumberRewriterTest::testRuleList_data()
+{
+    QTest::addColumn<QVariantList>("rules");
+    QTest::addColumn<QString>("number");
+    QTest::addColumn<QString>("expected");
+
+    QVariantList rules;
+    rules << rule("^00", "+") << rule("^0", "+4930");
+    QTest::newRow("first match wins") << rules << "0049301234567" << "+49301234567";
+    QTest::newRow("second rule") << rules << "01234567" << "+49301234567";
+    QTest::newRow("no match") << rules << "+49301234567" << "+49301234567";
+
+    rules.clear();
+    QVariantMap cleanup = rule("[^0-9+]", "");
+    cleanup["continue"] = true;
+    rules << cleanup << rule("^\\+49", "0");
+    QTest::newRow("continue") << rules << "+49 (30) 123-4567" << "0301234567";
+
+    rules.clear();
+    rules << rule("^(\\d{3})(\\d+)$", "\\2-\\1", "8");
+    QTest::newRow("captures and prefix") << rules << "1234567" << "84567-123";
+
+    rules.clear();
+    QVariantMap longNumbers = rule(QString(), QString(), "9");
+    longNumbers["minLength"] = 7;
+    rules << longNumbers;
+    QTest::newRow("min length") << rules << "123456" << "123456";
+    QTest::newRow("min length reached") << rules << "1234567" << "91234567";
+
+    rules.clear();
+    QVariantMap characters = rule("-");
+    characters["removeCharacters"] = "-";
+    rules << characters;
+    QTest::newRow("remove characters") << rules << "123-456-789" << "123456789";
+}
+
+void NumberRewriterTest::testRuleList()
+{
+    QFETCH(QVariantList, rules);
+    QFETCH(QString, number);
+    QFETCH(QString, expected);
+
+    NumberRewriter rewriter(ruleList(rules));
+    QCOMPARE(rewriter.rewrite(number), expected);
+}
+
+void NumberRewriterTest::testInvalidRule()
+{
+    QVariantList rules;
+    rules << rule("(unbalanced", "x") << rule("^1", "2");
+
+    NumberRewriter rewriter(ruleList(rules));
+    QCOMPARE(rewriter.rewrite("1234"), QString("2234"));
+}
+
+void NumberRewriterTest::benchmarkRewrite()
+{
+    // many rules that do not match the numbers, then the one that does
+    QVariantList rules;
+    for (int i = 0; i < BENCHMARK_RULES - 1; i++) {
+        rules << rule(QString("^%1#").arg(i), "");
+    }
+    QVariantMap international = rule("^0(\\d+)$", "\\1");
+    international["defaultCountryCode"] = "49";
+    international["removeCharacters"] = " ";
+    rules << international;
+
+    QStringList numbers;
+    for (int i = 0; i < BENCHMARK_NUMBERS; i++) {
+        numbers << QString("030%1").arg(1000000 + i * 7919 % 9000000);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    NumberRewriter rewriter(ruleList(rules));
+    qint64 compileTime = timer.nsecsElapsed() / 1000;
+
+    // every number is new the first time
+    timer.restart();
+    Q_FOREACH(const QString &number, numbers) {
+        QVERIFY(rewriter.rewrite(number).startsWith("+49"));
+    }
+    qint64 elapsed = timer.nsecsElapsed();
+    qDebug("first dial: %d numbers, %d rules, compiled in %lld us, %lld ns per number",
+           BENCHMARK_NUMBERS, BENCHMARK_RULES, compileTime, elapsed / BENCHMARK_NUMBERS);
+
+    // and then the last few of them are dialed again and again, which is
+    // what redialing costs
+    QStringList recent = numbers.mid(BENCHMARK_NUMBERS - REDIAL_NUMBERS);
+    timer.restart();
+    for (int round = 0; round < REDIAL_ROUNDS; round++) {
+        Q_FOREACH(const QString &number, recent) {
+            QVERIFY(rewriter.rewrite(number).startsWith("+49"));
+        }
+    }
+    elapsed = timer.nsecsElapsed();
+    qDebug("redial: %d numbers, %d rounds, %lld ns per number",
+           REDIAL_NUMBERS, REDIAL_ROUNDS, elapsed / (REDIAL_NUMBERS * REDIAL_ROUNDS));
+}
+
+QVariantMap NumberRewriterTest::rule(const QString &match, const QString &replace, const QString &prefix)
+{
+    QVariantMap rule;
+    if (!match.isEmpty()) {
+        rule["match"] = match;
+    }
+    if (!replace.isNull()) {
+        rule["replace"] = replace;
+    }
+    if (!prefix.isEmpty()) {
+        rule["prefix"] = prefix;
+    }
+    return rule;
+}
+
+QVariantMap NumberRewriterTest::ruleList(const QVariantList &rules)
+{
+    QVariantMap properties;
+    properties["numberRewrite"] = true;
+    properties["numberRewriteRules"] = rules;
+    return properties;
+}
+
+QTEST_MAIN(NumberRewriterTest)
+#include "NumberRewriterTest.moc"
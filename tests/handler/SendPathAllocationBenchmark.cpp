@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore/QObject>
+#include <QtTest/QtTest>
+#include <errno.h>
+#include "telepathytest.h"
+#include "handler.h"
+#include "messagesendingjob.h"
+#include "telepathyhelper.h"
+#include "texthandler.h"
+
+// number of messages sent in each round
+#define MESSAGES 100
+
+/* Every heap allocation of the process goes through the malloc family,
+ * including the ones made by operator new and by the Qt containers, so
+ * counting those calls is enough to see what the send path costs. This
+ * relies on glibc letting the executable interpose its allocator. The
+ * aligned variants are counted too, as some of them do not go through
+ * malloc. Allocations made by mmap() directly, or by code with its own pool
+ * (like the GLib slice allocator), are not seen. */
+static QBasicAtomicInt allocations = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nmemb, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void *__libc_valloc(size_t size);
+
+void *malloc(size_t size)
+{
+    allocations.fetchAndAddRelaxed(1);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    allocations.fetchAndAddRelaxed(1);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    allocations.fetchAndAddRelaxed(1);
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    allocations.fetchAndAddRelaxed(1);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    allocations.fetchAndAddRelaxed(1);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    // same checks as glibc, which are not done by __libc_memalign()
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0 || alignment == 0) {
+        return EINVAL;
+    }
+    allocations.fetchAndAddRelaxed(1);
+    void *ptr = __libc_memalign(alignment, size);
+    if (!ptr) {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+
+void *valloc(size_t size)
+{
+    allocations.fetchAndAddRelaxed(1);
+    return __libc_valloc(size);
+}
+}
+
+/* Counts the heap allocations made for each message that goes through
+ * MessageSendingJob, from the creation of the job until it finishes, both
+ * when the channel already exists and when a ChatStartingJob has to request
+ * it first. The handler code runs in the test process, so the counts include
+ * what the event loop and the D-Bus thread do on behalf of the job, but not
+ * the mock connection.
+ * Only the public API of the jobs is used, which has not changed since they
+ * were rewritten as state machines, so the numbers before the rewrite can be
+ * taken by building the benchmark with the previous messagejob,
+ * messagesendingjob and chatstartingjob sources. */
+class SendPathAllocationBenchmark : public TelepathyTest
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void benchmarkAllocations_data();
+    void benchmarkAllocations();
+
+private:
+    void sendMessage(const QString &recipient, const QString &text, int *allocationCount);
+
+    Tp::AccountPtr mTpAccount;
+};
+
+void SendPathAllocationBenchmark::initTestCase()
+{
+    initialize();
+
+    // act as the handler: the text channels requested by the jobs are
+    // handed to this process
+    QCoreApplication::setApplicationName("telephony-service-handler");
+    Handler *handler = new Handler(this);
+    connect(handler, SIGNAL(textChannelAvailable(Tp::TextChannelPtr)),
+            TextHandler::instance(), SLOT(onTextChannelAvailable(Tp::TextChannelPtr)));
+
+    QSignalSpy setupReadySpy(TelepathyHelper::instance(), SIGNAL(setupReady()));
+    TRY_COMPARE(setupReadySpy.count(), 1);
+    QVERIFY(TelepathyHelper::instance()->registerClient(handler, "TelephonyServiceHandler"));
+}
+
+void SendPathAllocationBenchmark::init()
+{
+    mTpAccount = addAccount("mock", "mock", "the account");
+
+    // wait for the account entry the jobs look up to be connected
+    TRY_VERIFY(TelepathyHelper::instance()->accountForId(mTpAccount->uniqueIdentifier()) &&
+               TelepathyHelper::instance()->accountForId(mTpAccount->uniqueIdentifier())->connected());
+}
+
+void SendPathAllocationBenchmark::cleanup()
+{
+    doCleanup();
+}
+
+void SendPathAllocationBenchmark::benchmarkAllocations_data()
+{
+    QTest::addColumn<bool>("existingChannel");
+
+    QTest::newRow("existing channel") << true;
+    QTest::newRow("new channel") << false;
+}
+
+void SendPathAllocationBenchmark::benchmarkAllocations()
+{
+    QFETCH(bool, existingChannel);
+
+    // the first message also loads what is only loaded once per process,
+    // keep it out of the numbers
+    int count = 0;
+    sendMessage("12345", "warm up", &count);
+    if (QTest::currentTestFailed()) {
+        return;
+    }
+
+    QList<int> samples;
+    for (int i = 0; i < MESSAGES; i++) {
+        QString recipient = existingChannel ? QString("12345") : QString("2%1").arg(i, 4, 10, QChar('0'));
+        sendMessage(recipient, QString("Message number %1").arg(i), &count);
+        if (QTest::currentTestFailed()) {
+            return;
+        }
+        samples << count;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    qint64 total = 0;
+    Q_FOREACH(int sample, samples) {
+        total += sample;
+    }
+    qDebug("%-16s %d messages: min %d, median %d, max %d, mean %.1f allocations per message",
+           QTest::currentDataTag(), MESSAGES, samples.first(), samples[samples.size() / 2],
+           samples.last(), double(total) / samples.size());
+}
+
+void SendPathAllocationBenchmark::sendMessage(const QString &recipient, const QString &text, int *allocationCount)
+{
+    QVariantMap properties;
+    properties["participantIds"] = QStringList() << recipient;
+    PendingMessage message = {mTpAccount->uniqueIdentifier(), text, AttachmentList(), properties};
+
+    bool finished = false;
+    int before = allocations.load();
+    MessageSendingJob *job = new MessageSendingJob(TextHandler::instance(), message);
+    connect(job, &MessageJob::finished, [&]() {
+        *allocationCount = allocations.load() - before;
+        finished = true;
+    });
+    job->startJob();
+
+    // QTRY_VERIFY instead of WAIT_FOR, which logs while it waits
+    TRY_VERIFY(finished);
+    QCOMPARE(job->status(), MessageJob::Finished);
+}
+
+QTEST_MAIN(SendPathAllocationBenchmark)
+#include "SendPathAllocationBenchmark.moc"
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore/QObject>
+#include <QtTest/QtTest>
+#include <QElapsedTimer>
+#include "telepathytest.h"
+#include "handlercontroller.h"
+#include "mockcontroller.h"
+#include "telepathyhelper.h"
+
+// number of messages sent in each round
+#define MESSAGES 200
+
+/* Measures how many messages per second go through the send path of the
+ * handler (SendMessage, the sending job and the mock connection) with the
+ * debug messages of the handler enabled, as they always were before the
+ * logging categories, and disabled, which is the default now. Building with
+ * DISABLE_DEBUG_LOGGING gives the numbers for debug messages compiled out. */
+class SendPathBenchmark : public TelepathyTest
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void benchmarkSendPath_data();
+    void benchmarkSendPath();
+
+private:
+    MockController *mMockController;
+    Tp::AccountPtr mTpAccount;
+};
+
+void SendPathBenchmark::initTestCase()
+{
+    initialize();
+
+    QSignalSpy setupReadySpy(TelepathyHelper::instance(), SIGNAL(setupReady()));
+    TRY_COMPARE(setupReadySpy.count(), 1);
+}
+
+void SendPathBenchmark::init()
+{
+    mTpAccount = addAccount("mock", "mock", "the account");
+    mMockController = new MockController("mock", this);
+}
+
+void SendPathBenchmark::cleanup()
+{
+    HandlerController::instance()->setLoggingRules(QString());
+    doCleanup();
+    mMockController->deleteLater();
+}
+
+void SendPathBenchmark::benchmarkSendPath_data()
+{
+    QTest::addColumn<QString>("rules");
+
+    QTest::newRow("debug enabled") << "telephony.*.debug=true";
+    QTest::newRow("debug disabled") << "";
+}
+
+void SendPathBenchmark::benchmarkSendPath()
+{
+    QFETCH(QString, rules);
+    HandlerController::instance()->setLoggingRules(rules);
+
+    QSignalSpy messageSentSpy(mMockController, SIGNAL(MessageSent(QString,QVariantList,QVariantMap)));
+
+    // the first message also creates the channel, keep it out of the numbers
+    HandlerController::instance()->sendMessage(mTpAccount->uniqueIdentifier(), QStringList() << "12345", "warm up");
+    TRY_COMPARE(messageSentSpy.count(), 1);
+    messageSentSpy.clear();
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < MESSAGES; i++) {
+        HandlerController::instance()->sendMessage(mTpAccount->uniqueIdentifier(), QStringList() << "12345",
+                                                   QString("Message number %1").arg(i));
+    }
+    TRY_COMPARE(messageSentSpy.count(), MESSAGES);
+    qint64 elapsed = timer.nsecsElapsed() / 1000;
+
+    qDebug("%-16s %d messages in %lld ms, %.1f messages/s",
+           QTest::currentDataTag(), MESSAGES, elapsed / 1000, MESSAGES * 1000000.0 / elapsed);
+}
+
+QTEST_MAIN(SendPathBenchmark)
+#include "SendPathBenchmark.moc"
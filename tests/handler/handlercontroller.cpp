@@ -41,14 +41,17 @@ HandlerController::HandlerController(QObject *parent) :
     qDBusRegisterMetaType<AttachmentList>();
 
     connect(&mHandlerInterface,
-            SIGNAL(CallPropertiesChanged(QString, QVariantMap)),
-            SIGNAL(callPropertiesChanged(QString, QVariantMap)));
+            SIGNAL(CallPropertiesChanged(QString, QVariantMap, qulonglong)),
+            SIGNAL(callPropertiesChanged(QString, QVariantMap, qulonglong)));
     connect(&mHandlerInterface,
-            SIGNAL(CallIndicatorVisibleChanged(bool)),
-            SIGNAL(callIndicatorVisibleChanged(bool)));
+            SIGNAL(CallIndicatorVisibleChanged(bool, qulonglong)),
+            SIGNAL(callIndicatorVisibleChanged(bool, qulonglong)));
     connect(&mHandlerInterface,
-            SIGNAL(ProtocolsChanged(ProtocolList)),
-            SIGNAL(protocolsChanged(ProtocolList)));
+            SIGNAL(ProtocolsChanged(ProtocolList, qulonglong)),
+            SIGNAL(protocolsChanged(ProtocolList, qulonglong)));
+    connect(&mHandlerInterface,
+            SIGNAL(AccountPropertiesChanged(QString, QVariantMap, qulonglong)),
+            SIGNAL(accountPropertiesChanged(QString, QVariantMap, qulonglong)));
 }
 
 QVariantMap HandlerController::getCallProperties(const QString &objectPath)
@@ -62,6 +65,17 @@ QVariantMap HandlerController::getCallProperties(const QString &objectPath)
     return properties;
 }
 
+QVariantMap HandlerController::getSnapshot()
+{
+    QVariantMap snapshot;
+    QDBusReply<QVariantMap> reply = mHandlerInterface.call("GetSnapshot");
+    if (reply.isValid()) {
+        snapshot = reply.value();
+    }
+
+    return snapshot;
+}
+
 bool HandlerController::callIndicatorVisible()
 {
     QDBusInterface handlerPropertiesInterface("com.canonical.TelephonyServiceHandler",
@@ -171,3 +185,22 @@ ProtocolList HandlerController::getProtocols()
     }
     return ProtocolList();
 }
+
+QVariantMap HandlerController::getAccountProperties(const QString &accountId)
+{
+    QDBusReply<QVariantMap> reply = mHandlerInterface.call("GetAccountProperties", accountId);
+    if (reply.isValid()) {
+        return reply.value();
+    }
+    return QVariantMap();
+}
+
+void HandlerController::setAccountProperties(const QString &accountId, const QVariantMap &properties)
+{
+    mHandlerInterface.call("SetAccountProperties", accountId, properties);
+}
+
+void HandlerController::setLoggingRules(const QString &rules)
+{
+    mHandlerInterface.call("SetLoggingRules", rules);
+}
@@ -32,6 +32,7 @@ public:
     static HandlerController *instance();
 
     QVariantMap getCallProperties(const QString &objectPath);
+    QVariantMap getSnapshot();
     bool callIndicatorVisible();
 
 public Q_SLOTS:
@@ -60,10 +61,18 @@ public Q_SLOTS:
     // protocols
     ProtocolList getProtocols();
 
+    // account properties
+    QVariantMap getAccountProperties(const QString &accountId);
+    void setAccountProperties(const QString &accountId, const QVariantMap &properties);
+
+    // logging related
+    void setLoggingRules(const QString &rules);
+
 Q_SIGNALS:
-    void callPropertiesChanged(const QString &objectPath, const QVariantMap &properties);
-    void callIndicatorVisibleChanged(bool visible);
-    void protocolsChanged(ProtocolList);
+    void callPropertiesChanged(const QString &objectPath, const QVariantMap &properties, qulonglong sequence);
+    void callIndicatorVisibleChanged(bool visible, qulonglong sequence);
+    void protocolsChanged(ProtocolList, qulonglong sequence);
+    void accountPropertiesChanged(const QString &accountId, const QVariantMap &properties, qulonglong sequence);
 
 private:
     explicit HandlerController(QObject *parent = 0);
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QPULSEAUDIOENGINETESTACCESS_H
+#define QPULSEAUDIOENGINETESTACCESS_H
+
+#include "qpulseaudioengine.h"
+
+QT_BEGIN_NAMESPACE
+
+/* Lets tests load objects the server does not have into the engine model as
+ * if the server had reported them, so routing can be exercised against droid
+ * devices on a daemon without them. Cards are announced like a hotplug.
+ * The model is changed with the mainloop locked, as the server callbacks do. */
+class QPulseAudioEngineTestAccess
+{
+public:
+    static QPulseAudioEngineWorker *worker()
+    {
+        return QPulseAudioEngine::instance()->mWorker;
+    }
+
+    static void injectCard(const pa_card_info *card)
+    {
+        pa_threaded_mainloop_lock(worker()->mainloop());
+        worker()->updateCardCache(card);
+        worker()->postCardEvent(PA_SUBSCRIPTION_EVENT_NEW, card->index);
+        pa_threaded_mainloop_unlock(worker()->mainloop());
+    }
+
+    static void injectSink(const pa_sink_info *sink)
+    {
+        pa_threaded_mainloop_lock(worker()->mainloop());
+        worker()->updateSinkCache(sink);
+        pa_threaded_mainloop_unlock(worker()->mainloop());
+    }
+
+    static void injectSource(const pa_source_info *source)
+    {
+        pa_threaded_mainloop_lock(worker()->mainloop());
+        worker()->updateSourceCache(source);
+        pa_threaded_mainloop_unlock(worker()->mainloop());
+    }
+
+    static void removeCard(uint32_t idx)
+    {
+        pa_threaded_mainloop_lock(worker()->mainloop());
+        worker()->removeFromCache(PA_SUBSCRIPTION_EVENT_CARD, idx);
+        worker()->postCardEvent(PA_SUBSCRIPTION_EVENT_REMOVE, idx);
+        pa_threaded_mainloop_unlock(worker()->mainloop());
+    }
+
+    // runs the same worker slot QPulseAudioEngine::setCallMode() queues, and
+    // returns once the route was applied
+    static void setCallModeAndWait(CallStatus callstatus, AudioMode audiomode)
+    {
+        QMetaObject::invokeMethod(worker(), "setCallMode", Qt::BlockingQueuedConnection,
+                                  Q_ARG(CallStatus, callstatus), Q_ARG(AudioMode, audiomode));
+    }
+};
+
+QT_END_NAMESPACE
+
+#endif // QPULSEAUDIOENGINETESTACCESS_H
@@ -0,0 +1,415 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore/QObject>
+#include <QtTest/QtTest>
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QDBusInterface>
+#include <QDBusMetaType>
+#include <QDBusPendingCallWatcher>
+#include <QElapsedTimer>
+#include <QTemporaryFile>
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/Types>
+#include <unistd.h>
+#include "telepathytest.h"
+#include "dbustypes.h"
+#include "mockcontroller.h"
+#include "telepathyhelper.h"
+
+// how many messages each scenario pushes, and the size of the MMS attachment,
+// all of them can be changed through the environment
+#define DEFAULT_OUTGOING 100
+#define DEFAULT_INCOMING 100
+#define DEFAULT_ATTACHMENT_SIZE 50000
+
+// the indicator waits 1.5s before notifying, on top of the processing time
+#define NOTIFICATION_TIMEOUT 30000
+
+#define SENDER "12345"
+#define OTHER_PARTICIPANT "54321"
+
+// the attachment format of mmsd, which the mock connection takes for incoming MMS
+struct MmsdAttachment {
+    QString id;
+    QString contentType;
+    QString filePath;
+    quint64 offset;
+    quint64 length;
+};
+Q_DECLARE_METATYPE(MmsdAttachment)
+Q_DECLARE_METATYPE(QList<MmsdAttachment>)
+
+QDBusArgument &operator<<(QDBusArgument &argument, const MmsdAttachment &attachment)
+{
+    argument.beginStructure();
+    argument << attachment.id << attachment.contentType << attachment.filePath << attachment.offset << attachment.length;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, MmsdAttachment &attachment)
+{
+    argument.beginStructure();
+    argument >> attachment.id >> attachment.contentType >> attachment.filePath >> attachment.offset >> attachment.length;
+    argument.endStructure();
+    return argument;
+}
+
+/* Pushes messages through the whole stack: the mock connection manager, the
+ * handler and the indicator, all running on the private bus of the test.
+ * Every scenario reports the throughput, the latency percentiles of each
+ * stage a message goes through and the peak RSS and CPU usage of each
+ * process. The volumes are set with TELEPHONY_BENCHMARK_OUTGOING,
+ * TELEPHONY_BENCHMARK_INCOMING and TELEPHONY_BENCHMARK_ATTACHMENT_SIZE.
+ *
+ * The stages of outgoing messages are "handler" (SendMessage returned the
+ * sending job) and "connection" (the mock connection got the message). The
+ * ones of incoming messages are "connection" (the channel signalled the
+ * message) and "notification" (the indicator notified about it). */
+class MessagingThroughputBenchmark : public TelepathyTest
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void benchmarkOutgoing_data();
+    void benchmarkOutgoing();
+    void benchmarkIncoming_data();
+    void benchmarkIncoming();
+
+protected Q_SLOTS:
+    void onSendMessageFinished(QDBusPendingCallWatcher *watcher);
+    void onMessageSent(const QString &message);
+    void onMessageReceived(const QDBusMessage &message);
+    void onNotificationReceived(const QString &appName, uint replacesId, const QString &appIcon,
+                                const QString &summary, const QString &body, const QStringList &actions,
+                                const QVariantMap &hints, int expireTimeout);
+
+private:
+    struct ProcessSample {
+        qint64 cpuTicks;
+        qint64 peakRss;
+    };
+
+    void sendMessage(const QString &text, const QStringList &participants, bool mms);
+    void placeIncomingMessage(const QString &text, const QStringList &participants, bool mms);
+    void record(const QString &stage, const QString &text);
+    void reset();
+    void report(const QString &scenario, int count, const QString &lastStage);
+
+    static ProcessSample sampleProcess(uint pid);
+    static int environmentValue(const char *name, int defaultValue);
+
+    MockController *mMockController;
+    Tp::AccountPtr mTpAccount;
+    QTemporaryFile mAttachmentFile;
+    QElapsedTimer mClock;
+    // when each message was pushed and when it reached each stage, by text
+    QHash<QString, qint64> mStartTimes;
+    QMap<QString, QList<qint64> > mStageLatencies;
+    QMap<QString, qint64> mLastStageTimes;
+    QMap<QString, uint> mPids;
+    QMap<QString, ProcessSample> mStartSamples;
+    qint64 mStartTime;
+};
+
+void MessagingThroughputBenchmark::initTestCase()
+{
+    qDBusRegisterMetaType<MmsdAttachment>();
+    qDBusRegisterMetaType<QList<MmsdAttachment> >();
+    qDBusRegisterMetaType<AttachmentStruct>();
+    qDBusRegisterMetaType<AttachmentList>();
+
+    initialize();
+
+    QSignalSpy setupReadySpy(TelepathyHelper::instance(), SIGNAL(setupReady()));
+    TRY_COMPARE(setupReadySpy.count(), 1);
+
+    // the processes under test, by the name they own on the bus
+    QMap<QString, QString> services;
+    services["telepathy-mock"] = "org.freedesktop.Telepathy.ConnectionManager.mock";
+    services["handler"] = "com.canonical.TelephonyServiceHandler";
+    services["indicator"] = "com.canonical.TelephonyServiceIndicator";
+    services["mission-control"] = "org.freedesktop.Telepathy.MissionControl5";
+    QMap<QString, QString>::const_iterator it = services.constBegin();
+    for (; it != services.constEnd(); ++it) {
+        TRY_VERIFY(QDBusConnection::sessionBus().interface()->isServiceRegistered(it.value()));
+        mPids[it.key()] = QDBusConnection::sessionBus().interface()->servicePid(it.value());
+    }
+    mPids["benchmark"] = QCoreApplication::applicationPid();
+
+    QVERIFY(mAttachmentFile.open());
+    mAttachmentFile.write(QByteArray(environmentValue("TELEPHONY_BENCHMARK_ATTACHMENT_SIZE", DEFAULT_ATTACHMENT_SIZE), 'x'));
+    mAttachmentFile.flush();
+
+    QDBusConnection::sessionBus().connect(QString(), QString(), TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES, "MessageReceived",
+                                          this, SLOT(onMessageReceived(QDBusMessage)));
+    QDBusConnection::sessionBus().connect("org.freedesktop.Notifications", "/org/freedesktop/Notifications",
+                                          "org.freedesktop.Notifications", "MockNotificationReceived",
+                                          this, SLOT(onNotificationReceived(QString,uint,QString,QString,QString,QStringList,QVariantMap,int)));
+    mClock.start();
+}
+
+void MessagingThroughputBenchmark::init()
+{
+    mTpAccount = addAccount("mock", "ofono", "the account");
+    mMockController = new MockController("ofono", this);
+    connect(mMockController, SIGNAL(MessageSent(QString,QVariantList,QVariantMap)), SLOT(onMessageSent(QString)));
+    reset();
+}
+
+void MessagingThroughputBenchmark::cleanup()
+{
+    doCleanup();
+    mMockController->deleteLater();
+}
+
+void MessagingThroughputBenchmark::benchmarkOutgoing_data()
+{
+    QTest::addColumn<QStringList>("participants");
+    QTest::addColumn<bool>("mms");
+
+    QTest::newRow("1:1") << (QStringList() << SENDER) << false;
+    QTest::newRow("group") << (QStringList() << SENDER << OTHER_PARTICIPANT) << false;
+    QTest::newRow("mms") << (QStringList() << SENDER) << true;
+}
+
+void MessagingThroughputBenchmark::benchmarkOutgoing()
+{
+    QFETCH(QStringList, participants);
+    QFETCH(bool, mms);
+    int count = environmentValue("TELEPHONY_BENCHMARK_OUTGOING", DEFAULT_OUTGOING);
+
+    // the first message creates the channel, keep it out of the numbers
+    sendMessage("warm up", participants, mms);
+    TRY_VERIFY(mStageLatencies["connection"].count() == 1);
+    reset();
+
+    for (int i = 0; i < count; i++) {
+        sendMessage(QString("outgoing %1").arg(i), participants, mms);
+    }
+    TRY_COMPARE(mStageLatencies["connection"].count(), count);
+    TRY_COMPARE(mStageLatencies["handler"].count(), count);
+
+    report(QString("outgoing %1").arg(QTest::currentDataTag()), count, "connection");
+}
+
+void MessagingThroughputBenchmark::benchmarkIncoming_data()
+{
+    QTest::addColumn<QStringList>("participants");
+    QTest::addColumn<bool>("mms");
+
+    QTest::newRow("1:1") << (QStringList() << SENDER) << false;
+    QTest::newRow("group") << (QStringList() << SENDER << OTHER_PARTICIPANT) << false;
+    QTest::newRow("mms") << (QStringList() << SENDER) << true;
+}
+
+void MessagingThroughputBenchmark::benchmarkIncoming()
+{
+    QFETCH(QStringList, participants);
+    QFETCH(bool, mms);
+    int count = environmentValue("TELEPHONY_BENCHMARK_INCOMING", DEFAULT_INCOMING);
+
+    // the mock connection only creates 1:1 channels for incoming messages,
+    // so group chats need to be started from this side first
+    if (participants.count() > 1) {
+        sendMessage("warm up", participants, false);
+        TRY_VERIFY(mStageLatencies["connection"].count() == 1);
+    } else {
+        placeIncomingMessage("warm up", participants, false);
+        TRY_VERIFY(mStageLatencies["connection"].count() == 1);
+    }
+    reset();
+
+    for (int i = 0; i < count; i++) {
+        placeIncomingMessage(QString("incoming %1").arg(i), participants, mms);
+    }
+    TRY_COMPARE(mStageLatencies["connection"].count(), count);
+
+    // a missing notification is not an error of the messaging path itself,
+    // so only report how many of them made it
+    QElapsedTimer timer;
+    timer.start();
+    while (mStageLatencies["notification"].count() < count && timer.elapsed() < NOTIFICATION_TIMEOUT) {
+        QTest::qWait(100);
+    }
+    if (mStageLatencies["notification"].count() < count) {
+        qWarning() << "Only" << mStageLatencies["notification"].count() << "of" << count << "messages were notified";
+    }
+
+    report(QString("incoming %1").arg(QTest::currentDataTag()), count, "connection");
+}
+
+void MessagingThroughputBenchmark::onSendMessageFinished(QDBusPendingCallWatcher *watcher)
+{
+    QDBusPendingReply<QString> reply = *watcher;
+    if (reply.isError()) {
+        qWarning() << "Failed to send message:" << reply.error().message();
+    } else {
+        record("handler", watcher->property("text").toString());
+    }
+    watcher->deleteLater();
+}
+
+void MessagingThroughputBenchmark::onMessageSent(const QString &message)
+{
+    record("connection", message);
+}
+
+void MessagingThroughputBenchmark::onMessageReceived(const QDBusMessage &message)
+{
+    Tp::MessagePartList parts = qdbus_cast<Tp::MessagePartList>(message.arguments().value(0));
+    Q_FOREACH(const Tp::MessagePart &part, parts) {
+        if (part["content-type"].variant().toString() == "text/plain") {
+            record("connection", part["content"].variant().toString());
+            return;
+        }
+    }
+}
+
+void MessagingThroughputBenchmark::onNotificationReceived(const QString &, uint, const QString &,
+                                                          const QString &, const QString &body, const QStringList &,
+                                                          const QVariantMap &, int)
+{
+    record("notification", body);
+}
+
+void MessagingThroughputBenchmark::sendMessage(const QString &text, const QStringList &participants, bool mms)
+{
+    AttachmentList attachments;
+    if (mms) {
+        AttachmentStruct attachment{"attachment", "image/png", mAttachmentFile.fileName()};
+        attachments << attachment;
+    }
+
+    QVariantMap properties;
+    properties["participantIds"] = participants;
+
+    mStartTimes[text] = mClock.nsecsElapsed() / 1000;
+    QDBusPendingCall call = TelepathyHelper::instance()->handlerInterface()->asyncCall("SendMessage", mTpAccount->uniqueIdentifier(),
+                                                                                     text, QVariant::fromValue(attachments), properties);
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    watcher->setProperty("text", text);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), SLOT(onSendMessageFinished(QDBusPendingCallWatcher*)));
+}
+
+void MessagingThroughputBenchmark::placeIncomingMessage(const QString &text, const QStringList &participants, bool mms)
+{
+    QVariantMap properties;
+    properties["Sender"] = SENDER;
+    properties["Recipients"] = participants;
+    if (mms) {
+        MmsdAttachment attachment{"attachment", "image/png", mAttachmentFile.fileName(), 0, quint64(mAttachmentFile.size())};
+        properties["Attachments"] = QVariant::fromValue(QList<MmsdAttachment>() << attachment);
+    }
+
+    mStartTimes[text] = mClock.nsecsElapsed() / 1000;
+    mMockController->PlaceIncomingMessage(text, properties);
+}
+
+void MessagingThroughputBenchmark::record(const QString &stage, const QString &text)
+{
+    // messages that are not part of the current round are ignored
+    if (!mStartTimes.contains(text)) {
+        return;
+    }
+    qint64 now = mClock.nsecsElapsed() / 1000;
+    mStageLatencies[stage] << now - mStartTimes[text];
+    mLastStageTimes[stage] = now;
+}
+
+void MessagingThroughputBenchmark::reset()
+{
+    mStartTimes.clear();
+    mStageLatencies.clear();
+    mLastStageTimes.clear();
+    mStartTime = mClock.nsecsElapsed() / 1000;
+    mStartSamples.clear();
+    QMap<QString, uint>::const_iterator it = mPids.constBegin();
+    for (; it != mPids.constEnd(); ++it) {
+        mStartSamples[it.key()] = sampleProcess(it.value());
+    }
+}
+
+void MessagingThroughputBenchmark::report(const QString &scenario, int count, const QString &lastStage)
+{
+    qint64 elapsed = qMax(mLastStageTimes[lastStage] - mStartTime, qint64(1));
+    qDebug("%s: %d messages in %lld ms, %.1f messages/s",
+           qPrintable(scenario), count, elapsed / 1000, count * 1000000.0 / elapsed);
+
+    QMap<QString, QList<qint64> >::iterator it = mStageLatencies.begin();
+    for (; it != mStageLatencies.end(); ++it) {
+        QList<qint64> &samples = it.value();
+        if (samples.isEmpty()) {
+            continue;
+        }
+        qSort(samples);
+        qDebug("  %-14s p50 %8lld us  p95 %8lld us  p99 %8lld us  max %8lld us",
+               qPrintable(it.key()), samples[samples.count() * 50 / 100], samples[samples.count() * 95 / 100],
+               samples[samples.count() * 99 / 100], samples.last());
+    }
+
+    // CPU is the share of one core used during the round
+    long ticksPerSecond = sysconf(_SC_CLK_TCK);
+    qint64 wallTime = mClock.nsecsElapsed() / 1000 - mStartTime;
+    QMap<QString, uint>::const_iterator pid = mPids.constBegin();
+    for (; pid != mPids.constEnd(); ++pid) {
+        ProcessSample sample = sampleProcess(pid.value());
+        qint64 cpuTime = (sample.cpuTicks - mStartSamples[pid.key()].cpuTicks) * 1000000 / ticksPerSecond;
+        qDebug("  %-16s peak RSS %8lld kB  CPU %5.1f%%",
+               qPrintable(pid.key()), sample.peakRss, cpuTime * 100.0 / wallTime);
+    }
+}
+
+MessagingThroughputBenchmark::ProcessSample MessagingThroughputBenchmark::sampleProcess(uint pid)
+{
+    ProcessSample sample = {0, 0};
+
+    // utime and stime are the 12th and 13th fields after the command name,
+    // which might contain spaces itself
+    QFile stat(QString("/proc/%1/stat").arg(pid));
+    if (stat.open(QIODevice::ReadOnly)) {
+        QByteArray data = stat.readAll();
+        QList<QByteArray> fields = data.mid(data.lastIndexOf(')') + 2).split(' ');
+        sample.cpuTicks = fields.value(11).toLongLong() + fields.value(12).toLongLong();
+    }
+
+    QFile status(QString("/proc/%1/status").arg(pid));
+    if (status.open(QIODevice::ReadOnly)) {
+        Q_FOREACH(const QByteArray &line, status.readAll().split('\n')) {
+            if (line.startsWith("VmHWM:")) {
+                sample.peakRss = line.mid(6).trimmed().split(' ').first().toLongLong();
+            }
+        }
+    }
+    return sample;
+}
+
+int MessagingThroughputBenchmark::environmentValue(const char *name, int defaultValue)
+{
+    bool ok = false;
+    int value = qgetenv(name).toInt(&ok);
+    return ok && value > 0 ? value : defaultValue;
+}
+
+QTEST_MAIN(MessagingThroughputBenchmark)
+#include "MessagingThroughputBenchmark.moc"
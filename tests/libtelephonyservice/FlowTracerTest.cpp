@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore/QObject>
+#include <QtTest/QtTest>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+
+#include "flowtracer.h"
+
+class FlowTracerTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void testTraceIds();
+    void testEvents();
+
+private:
+    QJsonArray readEvents();
+
+    QTemporaryDir mDir;
+    QString mFileName;
+};
+
+void FlowTracerTest::initTestCase()
+{
+    // the tracer reads the variable only once, when first used
+    QVERIFY(mDir.isValid());
+    mFileName = mDir.path() + "/trace.json";
+    qputenv("TELEPHONY_SERVICE_TRACE_FILE", mFileName.toLocal8Bit());
+    QVERIFY(FlowTracer::instance()->isEnabled());
+}
+
+void FlowTracerTest::testTraceIds()
+{
+    QString first = FlowTracer::instance()->newTraceId();
+    QString second = FlowTracer::instance()->newTraceId();
+    QVERIFY(!first.isEmpty());
+    QVERIFY(first != second);
+    QVERIFY(first.startsWith(QString::number(QCoreApplication::applicationPid()) + "."));
+}
+
+void FlowTracerTest::testEvents()
+{
+    QString traceId = FlowTracer::instance()->newTraceId();
+    QVariantMap args;
+    args["parts"] = 2;
+    FlowTracer::instance()->begin(traceId, "send-message");
+    {
+        FlowTracer::Scope scope("sending", traceId);
+    }
+    FlowTracer::instance()->instant(traceId, "part-sent", args);
+    FlowTracer::instance()->end(traceId, "send-message");
+    // events without a flow are dropped
+    FlowTracer::instance()->instant(QString(), "no-flow");
+
+    QStringList phases;
+    Q_FOREACH(const QJsonValue &value, readEvents()) {
+        QJsonObject event = value.toObject();
+        QCOMPARE(event["pid"].toInt(), int(QCoreApplication::applicationPid()));
+        QVERIFY(event["name"].toString() != "no-flow");
+        if (event["ph"].toString() == "M") {
+            continue;
+        }
+        QCOMPARE(event["args"].toObject()["traceId"].toString(), traceId);
+        if (event["ph"].toString() != "X") {
+            QCOMPARE(event["id2"].toObject()["global"].toString(), traceId);
+        }
+        if (event["name"].toString() == "part-sent") {
+            QCOMPARE(event["args"].toObject()["parts"].toInt(), 2);
+        }
+        phases << event["ph"].toString();
+    }
+    QCOMPARE(phases, QStringList() << "b" << "X" << "n" << "e");
+}
+
+QJsonArray FlowTracerTest::readEvents()
+{
+    QFile file(mFileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QJsonArray();
+    }
+
+    // the file is left open ended so that processes can keep appending
+    QByteArray data = file.readAll().trimmed();
+    if (data.endsWith(',')) {
+        data.chop(1);
+    }
+    data.append(']');
+    return QJsonDocument::fromJson(data).array();
+}
+
+QTEST_MAIN(FlowTracerTest)
+#include "FlowTracerTest.moc"
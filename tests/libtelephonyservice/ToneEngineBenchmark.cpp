@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2017 Canonical, Ltd.
+ *
+ * This file is part of telephony-service.
+ *
+ * telephony-service is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * telephony-service is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore/QObject>
+#include <QtTest/QtTest>
+
+#include "pulseaudioserver.h"
+#include "toneengine.h"
+#include "tonegenerator.h"
+
+// number of key presses measured
+#define ITERATIONS 100
+// default p95 key-to-audio budget, can be overridden with the
+// TONE_LATENCY_BUDGET_MS environment variable
+#define DEFAULT_BUDGET_MS 50
+
+/* Measures the key-to-audio latency of the in-process tone engine against a
+ * private PulseAudio daemon: the time between a key press and the first tone
+ * samples being queued, plus the stream latency they still have to go through */
+class ToneEngineBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void benchmarkKeyToAudio();
+
+private:
+    PulseAudioServer mServer;
+    ToneEngine *mEngine = 0;
+};
+
+void ToneEngineBenchmark::initTestCase()
+{
+    if (!PulseAudioServer::isSupported()) {
+        QSKIP("pulseaudio and pactl are needed to run this benchmark");
+    }
+    QVERIFY(mServer.start());
+
+    mEngine = new ToneEngine();
+    QTRY_VERIFY(mEngine->isAvailable());
+}
+
+void ToneEngineBenchmark::cleanupTestCase()
+{
+    delete mEngine;
+    mEngine = 0;
+    mServer.stop();
+}
+
+void ToneEngineBenchmark::benchmarkKeyToAudio()
+{
+    QList<qint64> samples;
+    for (int i = 0; i < ITERATIONS; i++) {
+        // alternate between starting from silence and interrupting a tone
+        if (i % 2 == 0) {
+            mEngine->stopTone();
+            QTest::qWait(50);
+        }
+        QVERIFY(mEngine->startEventTone(i % 12, DTMF_LOCAL_PLAYBACK_DURATION));
+        // the latency of the previous tone is reset by startEventTone()
+        QTRY_VERIFY(mEngine->lastStartLatency() >= 0);
+        samples << mEngine->lastStartLatency();
+        QTest::qWait(20);
+    }
+    mEngine->stopTone();
+
+    qSort(samples);
+    qint64 p50 = samples[samples.count() * 50 / 100];
+    qint64 p95 = samples[samples.count() * 95 / 100];
+    qint64 p99 = samples[samples.count() * 99 / 100];
+    qDebug("key-to-audio p50 %lld us  p95 %lld us  p99 %lld us  max %lld us",
+           p50, p95, p99, samples.last());
+
+    bool ok;
+    int budget = qgetenv("TONE_LATENCY_BUDGET_MS").toInt(&ok);
+    if (!ok || budget <= 0) {
+        budget = DEFAULT_BUDGET_MS;
+    }
+    QVERIFY2(p95 <= budget * 1000, qPrintable(QString("p95 key-to-audio latency over the %1 ms budget").arg(budget)));
+}
+
+QTEST_GUILESS_MAIN(ToneEngineBenchmark)
+#include "ToneEngineBenchmark.moc"